@@ -0,0 +1,322 @@
+// Throughput and memory benchmark over a generated corpus - not a test, so nothing is asserted.
+// Build with optimisations from the root of the project, e.g.
+//     g++ -std=c++17 -O2 bench/benchmark.cpp src/*.cpp -o benchmark -pthread
+// and run as
+//     ./benchmark [--size MB] [corpus...]
+// Each corpus (all by default) is generated only once selected, then parsed from a string and
+// from a stream, with and without validation, reporting the best throughput over several runs,
+// the heap allocations made by a single parse, the most resident memory grew by during a single
+// parse (Linux only - the peak is reset before each parse) and the peak of the process so far.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+// Counts every heap allocation made by the program.
+static std::size_t allocations = 0;
+
+// Allocates and frees through malloc/free, counting each allocation. Kept out of line,
+// so that the compiler never sees memory from operator new released with free.
+[[gnu::noinline]] static void* allocate(std::size_t size, std::size_t align = 0) {
+    allocations++;
+    void* p = align ? std::aligned_alloc(align, (size + align - 1) / align * align) : std::malloc(size != 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+[[gnu::noinline]] static void deallocate(void* p) noexcept {
+    std::free(p);
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+// Used by the default memory resource (polymorphic allocators).
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    deallocate(p);
+}
+
+
+// Minimum number of runs of each case, and minimum total time spent on each case.
+constexpr int MIN_RUNS = 3;
+constexpr double MIN_SECONDS = 1;
+// Folder the files of the external subset corpus are written to.
+const std::filesystem::path EXTERNAL_FOLDER = std::filesystem::temp_directory_path() / "xml_benchmark";
+
+
+// Returns the peak resident memory of the process in MiB (0 if unknown).
+double peak_memory() {
+    #ifdef _WIN32
+        return 0;
+    #else
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        #ifdef __APPLE__
+            return usage.ru_maxrss / 1048576.0;
+        #else
+            return usage.ru_maxrss / 1024.0;
+        #endif
+    #endif
+}
+
+// Returns the resident memory of the process in MiB (0 if unknown) - either now,
+// or the peak since it was last reset (Linux only).
+double resident_memory(bool peak) {
+    std::ifstream status("/proc/self/status");
+    std::string field = peak ? "VmHWM:" : "VmRSS:";
+    for (std::string line; std::getline(status, line);) {
+        if (line.compare(0, field.size(), field) == 0) {
+            return std::stod(line.substr(field.size())) / 1024;
+        }
+    }
+    return 0;
+}
+
+// Resets the peak resident memory to the current resident memory (Linux only), first returning
+// freed heap memory to the system where possible, so memory still resident from earlier
+// parses does not hide the growth of the next.
+void reset_peak_memory() {
+    #ifdef __GLIBC__
+        malloc_trim(0);
+    #endif
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+// Repeats a record (given its number) until the document body reaches the given size.
+std::string repeat(
+    const std::string& start, std::function<std::string(std::size_t)> record,
+    const std::string& end, std::size_t size
+) {
+    std::string document = start;
+    for (std::size_t i = 0; document.size() < size; ++i) {
+        document += record(i);
+    }
+    return document + end;
+}
+
+// Many small sibling records under the root element - the most common shape of large documents.
+std::string flat_records(std::size_t i) {
+    std::string n = std::to_string(i);
+    return "<record id=\"r" + n + "\"><name>Record number " + n + "</name>"
+        "<value>" + std::to_string(i * 7919 % 100000) + ".25</value><tags>alpha beta gamma</tags></record>\n";
+}
+
+const std::string FLAT_DTD = R"(<!DOCTYPE records [
+    <!ELEMENT records (record*)><!ELEMENT record (name, value, tags)><!ATTLIST record id ID #REQUIRED>
+    <!ELEMENT name (#PCDATA)><!ELEMENT value (#PCDATA)><!ELEMENT tags (#PCDATA)>
+]>)";
+
+// Chains of nested elements.
+std::string deep_records(std::size_t) {
+    std::string record;
+    for (int i = 0; i < 100; ++i) {
+        record += "<level>";
+    }
+    record += "<leaf/>";
+    for (int i = 0; i < 100; ++i) {
+        record += "</level>";
+    }
+    return record + "\n";
+}
+
+const std::string DEEP_DTD = R"(<!DOCTYPE deep [
+    <!ELEMENT deep (level*)><!ELEMENT level (level|leaf)*><!ELEMENT leaf EMPTY>
+]>)";
+
+// Empty elements with many attributes, several of them defaulted or normalised.
+std::string attribute_records(std::size_t i) {
+    std::string record = "<item id=\"i" + std::to_string(i) + "\"";
+    for (int j = 0; j < 12; ++j) {
+        record += " a" + std::to_string(j) + "='value " + std::to_string(i + j) + "'";
+    }
+    return record + " kind=\"large\" tokens=\"  one two  three \"/>\n";
+}
+
+std::string attribute_dtd() {
+    std::string dtd = "<!DOCTYPE items [<!ELEMENT items (item*)><!ELEMENT item EMPTY>"
+        "<!ATTLIST item id ID #REQUIRED kind (small|medium|large) 'medium' tokens NMTOKENS #IMPLIED"
+        " fixed CDATA #FIXED 'yes' extra CDATA 'default'";
+    for (int j = 0; j < 12; ++j) {
+        dtd += " a" + std::to_string(j) + " CDATA #IMPLIED";
+    }
+    return dtd + ">]>";
+}
+
+// Long paragraphs of character data, with references, CDATA sections and line breaks.
+std::string text_records(std::size_t) {
+    return "<p>Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+        "incididunt ut labore et dolore magna aliqua &amp; ut enim ad minim veniam.\r\n"
+        "Caf\xC3\xA9 na\xC3\xAFve \xE2\x82\xAC 100 &#x263A; &#169; quis nostrud exercitation ullamco laboris "
+        "<![CDATA[if (a < b && c > d) { return \"<raw>\"; }]]> nisi ut aliquip ex ea commodo.</p>\n";
+}
+
+const std::string TEXT_DTD = "<!DOCTYPE doc [<!ELEMENT doc (p*)><!ELEMENT p (#PCDATA)>]>";
+
+// Internal entities of every kind referenced throughout content and attribute values.
+std::string entity_records(std::size_t) {
+    return "<entry by=\"&company;\">From &signature;: &warning; &lt;ok&gt; &#65;&year;</entry>\n";
+}
+
+const std::string ENTITY_DTD = R"dtd(<!DOCTYPE doc [
+    <!ELEMENT doc (entry*)><!ELEMENT entry (#PCDATA|b)*><!ATTLIST entry by CDATA #IMPLIED>
+    <!ELEMENT b (#PCDATA)>
+    <!ENTITY year "2024"><!ENTITY company "Example &amp; Co.">
+    <!ENTITY signature "&company; (&year;)"><!ENTITY warning "<b>careful &year;</b>">
+]>)dtd";
+
+// Records using declarations and an entity from external files.
+std::string external_records(std::size_t i) {
+    return "<record id=\"r" + std::to_string(i) + "\"><name>&name;</name><value>"
+        + std::to_string(i) + "</value><tags>&tags;</tags></record>\n";
+}
+
+// Writes the external subset and entity, returning the DOCTYPE declaration referencing them.
+std::string external_dtd() {
+    std::filesystem::create_directories(EXTERNAL_FOLDER);
+    std::ofstream(EXTERNAL_FOLDER / "tags.xml") << "<?xml encoding='utf-8'?>alpha beta gamma";
+    std::ofstream(EXTERNAL_FOLDER / "subset.dtd") << R"(
+        <!ELEMENT records (record*)><!ELEMENT record (name, value, tags)><!ATTLIST record id ID #REQUIRED>
+        <!ELEMENT name (#PCDATA)><!ELEMENT value (#PCDATA)><!ELEMENT tags (#PCDATA)>
+        <!ENTITY name "External record"><!ENTITY tags SYSTEM "tags.xml">)";
+    return "<!DOCTYPE records SYSTEM \"" + (EXTERNAL_FOLDER / "subset.dtd").generic_string() + "\">";
+}
+
+// Named document generator.
+struct Corpus {
+    std::string name; // Name to select the corpus by.
+    std::function<std::string(std::size_t)> generate; // Generates the document of roughly the given size.
+};
+
+// Every corpus, each only generated when benchmarked (so unselected corpora take no memory).
+const std::vector<Corpus> CORPORA {
+    {"flat", [](std::size_t size) { return repeat("<records>\n", flat_records, "</records>", size); }},
+    {"flat_dtd", [](std::size_t size) { return repeat(FLAT_DTD + "<records>\n", flat_records, "</records>", size); }},
+    {"deep", [](std::size_t size) { return repeat(DEEP_DTD + "<deep>\n", deep_records, "</deep>", size); }},
+    {"attributes", [](std::size_t size) {
+        return repeat(attribute_dtd() + "<items>\n", attribute_records, "</items>", size);
+    }},
+    {"text", [](std::size_t size) { return repeat(TEXT_DTD + "<doc>\n", text_records, "</doc>", size); }},
+    {"entities", [](std::size_t size) { return repeat(ENTITY_DTD + "<doc>\n", entity_records, "</doc>", size); }},
+    {"external", [](std::size_t size) {
+        return repeat(external_dtd() + "<records>\n", external_records, "</records>", size);
+    }}
+};
+
+// Parses a document once (destroying it too), returning the seconds taken and setting
+// the number of heap allocations made and the MiB resident memory grew by at its peak.
+double parse_once(
+    const std::string& data, bool stream, bool validate, std::size_t& allocation_count, double& memory_growth
+) {
+    // Stream set up in advance, so copying the data is not counted.
+    std::istringstream istream;
+    if (stream) {
+        istream.str(data);
+    }
+    reset_peak_memory();
+    double memory_before = resident_memory(false);
+    std::size_t allocations_before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    {
+        Document document = stream ? parse(istream, validate, validate) : parse(data, validate, validate);
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    allocation_count = allocations - allocations_before;
+    memory_growth = std::max(resident_memory(true) - memory_before, 0.0);
+    return seconds.count();
+}
+
+// Benchmarks a document in every combination of input and validation.
+void benchmark(const std::string& name, const std::string& data) {
+    for (bool stream : {false, true}) {
+        for (bool validate : {false, true}) {
+            double best = 0;
+            double total = 0;
+            double most_growth = 0;
+            std::size_t allocation_count = 0;
+            for (int run = 0; run < MIN_RUNS || total < MIN_SECONDS; ++run) {
+                double memory_growth = 0;
+                double seconds = parse_once(data, stream, validate, allocation_count, memory_growth);
+                best = run ? std::min(best, seconds) : seconds;
+                total += seconds;
+                most_growth = std::max(most_growth, memory_growth);
+            }
+            std::string mode = std::string(stream ? "stream" : "string") + (validate ? "+validate" : "");
+            std::cout << std::left << std::setw(12) << name << std::setw(17) << mode
+                << std::right << std::fixed << std::setprecision(1)
+                << std::setw(10) << data.size() / 1048576.0 / best
+                << std::setw(14) << allocation_count
+                << std::setw(13) << most_growth
+                << std::setw(11) << peak_memory() << std::endl;
+        }
+    }
+}
+
+
+int main(int argc, char** argv) {
+    std::size_t size = 4 << 20;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--size" && i + 1 < argc) {
+            size = std::stod(argv[++i]) * 1048576;
+        } else {
+            names.push_back(argument);
+        }
+    }
+    for (const std::string& name : names) {
+        if (std::none_of(CORPORA.begin(), CORPORA.end(), [&](const Corpus& corpus) {
+            return corpus.name == name;
+        })) {
+            std::cerr << "Unknown corpus: " << name << "\n";
+            return 1;
+        }
+    }
+    std::cout << std::left << std::setw(12) << "corpus" << std::setw(17) << "mode" << std::right
+        << std::setw(10) << "MB/s" << std::setw(14) << "allocations" << std::setw(13) << "growth MiB"
+        << std::setw(11) << "peak MiB\n";
+    for (const Corpus& corpus : CORPORA) {
+        if (names.empty() || std::find(names.begin(), names.end(), corpus.name) != names.end()) {
+            // Generated now and freed once benchmarked, so only one corpus is in memory at a time.
+            benchmark(corpus.name, corpus.generate(size));
+        }
+    }
+    std::filesystem::remove_all(EXTERNAL_FOLDER);
+}
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "batch.h"
+#include <algorithm>
+#include <exception>
+#include "dtd.h"
+#include "resource.h"
+
+
+namespace xml {
+
+// Pool the current thread is a worker of (null if none), and its index in the pool.
+static thread_local const ThreadPool* worker_pool = nullptr;
+static thread_local int worker_index = -1;
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        this->queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        this->threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->task_queued.notify_all();
+    for (std::thread& thread : this->threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(std::size_t index) {
+    worker_pool = this;
+    worker_index = index;
+    std::function<void()> task;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->task_queued.wait(lock, [this] { return this->queued > 0 || this->stopping; });
+            if (this->queued == 0) {
+                // Stopping with all tasks done.
+                return;
+            }
+            // Claims a task - there is always at least one queued task per claim.
+            --this->queued;
+        }
+        while (!this->take(index, task));
+        task();
+        task = nullptr;
+    }
+}
+
+bool ThreadPool::take(std::size_t index, std::function<void()>& task) {
+    {
+        // Own queue - most recently submitted first.
+        TaskQueue& queue = *this->queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < this->queues.size(); ++i) {
+        // Steals the oldest task of another worker.
+        TaskQueue& queue = *this->queues[(index + i) % this->queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Only a worker of this pool submits to its own queue.
+    std::size_t index = worker_pool == this ? worker_index : this->next_queue++ % this->queues.size();
+    {
+        TaskQueue& queue = *this->queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        ++this->queued;
+    }
+    this->task_queued.notify_one();
+}
+
+std::size_t ThreadPool::size() const {
+    return this->threads.size();
+}
+
+int ThreadPool::current_worker() {
+    return worker_index;
+}
+
+bool ThreadPool::is_worker() const {
+    return worker_pool == this;
+}
+
+bool ThreadPool::run_queued() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->queued == 0) {
+            return false;
+        }
+        --this->queued;
+    }
+    std::function<void()> task;
+    while (!this->take(worker_index, task));
+    task();
+    return true;
+}
+
+BatchInput::BatchInput(std::string_view buffer) : buffer(buffer) {}
+
+BatchInput::BatchInput(const std::string& string) : buffer(string) {}
+
+BatchInput::BatchInput(const char* string) : buffer(string) {}
+
+BatchInput::BatchInput(const std::filesystem::path& file_path) : file_path(file_path), is_file(true) {}
+
+std::vector<BatchResult> parse_batch(const std::vector<BatchInput>& inputs, const BatchOptions& options) {
+    std::vector<BatchResult> results(inputs.size());
+    if (inputs.empty()) {
+        return results;
+    }
+    std::unique_ptr<ThreadPool> batch_pool = nullptr;
+    ThreadPool* pool = options.pool;
+    if (pool == nullptr) {
+        batch_pool = std::make_unique<ThreadPool>(options.threads);
+        pool = batch_pool.get();
+    }
+    // Caches shared by all documents (both thread-safe).
+    ParseOptions parse_options = options.parse_options;
+    if (parse_options.dtd_cache == nullptr) {
+        parse_options.dtd_cache = std::make_shared<DtdCache>();
+    }
+    if (parse_options.resource_cache == nullptr) {
+        parse_options.resource_cache = std::make_shared<ResourceCache>();
+    }
+    // Arena of each worker, only ever accessed by that worker.
+    std::vector<std::shared_ptr<std::pmr::memory_resource>> arenas(pool->size());
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t remaining = inputs.size();
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        pool->submit([&, i] {
+            const BatchInput& input = inputs[i];
+            BatchResult& result = results[i];
+            try {
+                ParseOptions document_options = parse_options;
+                if (options.worker_arenas && document_options.arena == nullptr) {
+                    std::shared_ptr<std::pmr::memory_resource>& arena = arenas[ThreadPool::current_worker()];
+                    if (arena == nullptr) {
+                        arena = std::make_shared<std::pmr::monotonic_buffer_resource>();
+                    }
+                    document_options.arena = arena;
+                }
+                // Rejected documents mostly reported without throwing (see try_parse_document).
+                if (input.is_file) {
+                    MappedFile file(input.file_path);
+                    result = Parser(file.view()).try_parse_document(document_options);
+                } else {
+                    result = Parser(input.buffer).try_parse_document(document_options);
+                }
+            } catch (const std::exception& e) {
+                // Tasks must not throw - anything else (e.g. a missing file) fails this document only.
+                result.document = Document();
+                result.error = e.what();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0) {
+                finished.notify_all();
+            }
+        });
+    }
+    if (pool->is_worker()) {
+        // Called from a task - the worker helps with queued tasks, as there may be no other worker to run them.
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (remaining == 0) {
+                    return results;
+                }
+            }
+            if (!pool->run_queued()) {
+                // Every remaining task is already being run by another worker.
+                break;
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&remaining] { return remaining == 0; });
+    return results;
+}
+
+std::vector<BatchResult> parse_batch(const std::vector<std::string>& strings, const BatchOptions& options) {
+    return parse_batch(std::vector<BatchInput>(strings.begin(), strings.end()), options);
+}
+
+std::vector<BatchResult> parse_batch(
+    const std::vector<std::filesystem::path>& file_paths, const BatchOptions& options
+) {
+    return parse_batch(std::vector<BatchInput>(file_paths.begin(), file_paths.end()), options);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+// Parsing of many documents at once, sharing a pool of worker threads.
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "parser.h"
+#include "utils.h"
+
+
+namespace xml {
+
+// Fixed set of worker threads running submitted tasks. Each worker has its own queue of tasks,
+// and once its queue is empty, takes tasks from the other queues (work stealing),
+// so uneven tasks (e.g. documents of very different sizes) still keep every worker busy.
+// The pool may be shared by any number of batches, including at the same time.
+class ThreadPool {
+    // Tasks of a worker - taken from the back by the worker and from the front by others.
+    struct TaskQueue {
+        std::mutex mutex; // Guards the tasks.
+        std::deque<std::function<void()>> tasks; // Tasks not yet taken.
+    };
+    std::vector<std::unique_ptr<TaskQueue>> queues; // Task queue of each worker.
+    std::vector<std::thread> threads; // Worker threads.
+    std::mutex mutex; // Guards the count of queued tasks and stopping.
+    std::condition_variable task_queued; // Notified when a task is queued or stopping.
+    std::size_t queued = 0; // Number of tasks queued but not yet claimed by a worker.
+    bool stopping = false; // Indicates the pool is being destroyed.
+    std::atomic<std::size_t> next_queue {0}; // Queue of the next task submitted from outside.
+
+    // Runs tasks in a worker thread until the pool is destroyed.
+    void run(std::size_t);
+    // Takes a task for the worker, from its own queue if possible, otherwise from another.
+    // Returns false if all queues are empty.
+    bool take(std::size_t, std::function<void()>&);
+    public:
+        // Starts the given number of worker threads (0 for all hardware threads).
+        explicit ThreadPool(unsigned = 0);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        // Runs all remaining tasks and then stops the worker threads.
+        ~ThreadPool();
+        // Queues a task to be run by a worker (must not throw).
+        // Tasks submitted by a worker go to its own queue, otherwise round robin.
+        void submit(std::function<void()>);
+        // Returns the number of worker threads.
+        std::size_t size() const;
+        // Returns the index of the worker thread calling (-1 if not a worker of any pool).
+        static int current_worker();
+        // Returns true if called from a worker thread of this pool.
+        bool is_worker() const;
+        // Runs a queued task in the calling worker thread of this pool, if any.
+        // Returns false if no task is queued (all tasks are taken by other workers).
+        bool run_queued();
+};
+
+// Document to parse as part of a batch - a contiguous buffer or the path of a file.
+struct BatchInput {
+    std::string_view buffer; // XML data (must outlive the batch), unless a file.
+    std::filesystem::path file_path; // Path of the file to parse (memory mapped), if a file.
+    bool is_file = false; // Indicates the input is a file rather than a buffer.
+    // Buffer input.
+    BatchInput(std::string_view);
+    // String input (the string must outlive the batch).
+    BatchInput(const std::string&);
+    // Null-terminated string input (the string must outlive the batch).
+    BatchInput(const char*);
+    // File input.
+    BatchInput(const std::filesystem::path&);
+};
+
+// Outcome of parsing a document in a batch - the document, or the error if parsing failed.
+typedef ParseResult BatchResult;
+
+// Options for parsing a batch of documents.
+struct BatchOptions {
+    // Options for every document. Unless set, a DTD cache and resource cache are created
+    // for the batch, so external DTD subsets and entities are loaded only once for the batch.
+    ParseOptions parse_options;
+    ThreadPool* pool = nullptr; // Existing pool to parse with (otherwise one is made for the batch).
+    unsigned threads = 0; // Worker threads if no pool is given (0 for all hardware threads).
+    // Each worker allocates all its documents from its own arena (unless an arena is
+    // already set). The arena is freed once all documents allocated from it are destroyed,
+    // and documents sharing an arena must not be modified from different threads at once.
+    bool worker_arenas = false;
+};
+
+// Parses each input in parallel, returning the results in the same order as the inputs.
+// An error in one document does not affect any other document.
+// If called from a task running in the same pool, the calling worker runs queued tasks
+// while waiting rather than blocking, so nested batches cannot deadlock the pool.
+std::vector<BatchResult> parse_batch(const std::vector<BatchInput>&, const BatchOptions& = {});
+// Parses each string in parallel, returning the results in order.
+std::vector<BatchResult> parse_batch(const std::vector<std::string>&, const BatchOptions& = {});
+// Parses each file (memory mapped) in parallel, returning the results in order.
+std::vector<BatchResult> parse_batch(const std::vector<std::filesystem::path>&, const BatchOptions& = {});
+
+}
\ No newline at end of file
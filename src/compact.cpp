@@ -0,0 +1,273 @@
+#include "compact.h"
+#include <algorithm>
+#include <stdexcept>
+#include "handler.h"
+#include "parser.h"
+
+
+namespace xml {
+
+// Builds a compact document from parse events.
+class CompactDocumentBuilder : public Handler {
+    CompactDocument& document; // Document being built.
+    std::vector<NodeIndex> open_elements; // Elements currently open, from root to innermost.
+    std::vector<NodeIndex> last_children; // Last child so far of each open element.
+    bool lazy; // Character data and attribute values passed on raw (lazy parsing with no DTD)?
+    // Parser whose input is viewed rather than copied whilst parsing lazily (views only).
+    const Parser* parser;
+
+    // Adds a string to the pool, returning the corresponding slice.
+    StringSlice add_string(std::string_view string, RawSlice raw = RawSlice::none) {
+        StringSlice slice {this->document.pool.size(), string.size(), raw};
+        this->document.pool.append(string);
+        return slice;
+    }
+    // Returns the slice of the input corresponding to a view into it (nothing copied).
+    StringSlice view_string(std::string_view string, RawSlice raw = RawSlice::none) {
+        return {static_cast<std::size_t>(string.data() - this->document.source.data()), string.size(), raw, true};
+    }
+    // Returns true if values are to be viewed in the input rather than copied.
+    bool views() const {
+        return this->lazy && this->parser != nullptr;
+    }
+    // Adds a node as the next child of the innermost open element, returning its index.
+    NodeIndex add_node(CompactNodeType type) {
+        NodeIndex index = this->document.nodes.size();
+        CompactNode node;
+        node.type = type;
+        if (!this->open_elements.empty()) {
+            node.parent = this->open_elements.back();
+            NodeIndex& last_child = this->last_children.back();
+            if (last_child == NO_NODE) {
+                this->document.nodes[node.parent].first_child = index;
+            } else {
+                this->document.nodes[last_child].next_sibling = index;
+            }
+            last_child = index;
+        }
+        this->document.nodes.push_back(node);
+        return index;
+    }
+    public:
+        CompactDocumentBuilder(CompactDocument& document, bool lazy = false, const Parser* parser = nullptr)
+            : document(document), lazy(lazy), parser(parser) {
+            if (parser != nullptr) {
+                this->document.source = std::string_view(
+                    parser->buffer_begin, parser->buffer_end - parser->buffer_begin);
+            }
+        }
+        void xml_declaration(const String& version, const String& encoding, bool standalone) override {
+            this->document.version = version;
+            this->document.encoding = encoding;
+            this->document.standalone = standalone;
+        }
+        void doctype_declaration(const DoctypeDeclaration& doctype_declaration) override {
+            this->document.doctype_declaration = doctype_declaration;
+            // Entities and declarations apply, so everything is decoded whilst parsing.
+            this->lazy = false;
+        }
+        void start_element(const String& name, const Attributes& attributes) override {
+            NodeIndex index = this->add_node(CompactNodeType::element);
+            CompactNode& node = this->document.nodes[index];
+            node.first_attribute = this->document.attributes.size();
+            if (this->views()) {
+                // Exactly as in the input, already in name order (as in the attributes map).
+                // The name and attributes passed are empty - nothing is built whilst parsing.
+                node.name = this->view_string(this->parser->raw_tag_name);
+                node.attribute_count = this->parser->raw_attributes.size();
+                for (const auto& [attribute_name, attribute_value] : this->parser->raw_attributes) {
+                    this->document.attributes.push_back({
+                        this->view_string(attribute_name), this->view_string(attribute_value, RawSlice::attribute_value)});
+                }
+                this->open_elements.push_back(index);
+                this->last_children.push_back(NO_NODE);
+                return;
+            }
+            node.attribute_count = attributes.size();
+            node.name = this->add_string(name);
+            for (const auto& [attribute_name, attribute_value] : attributes) {
+                this->document.attributes.push_back({this->add_string(attribute_name), this->add_string(
+                    attribute_value, this->lazy ? RawSlice::attribute_value : RawSlice::none)});
+            }
+            this->open_elements.push_back(index);
+            this->last_children.push_back(NO_NODE);
+        }
+        void end_element(const String&) override {
+            this->open_elements.pop_back();
+            this->last_children.pop_back();
+        }
+        void characters(const String& text) override {
+            NodeIndex last_child = this->last_children.back();
+            if (this->lazy) {
+                // Raw text is only decoded as a whole, so is never merged.
+                NodeIndex index = this->add_node(CompactNodeType::text);
+                this->document.nodes[index].value = this->views()
+                    ? this->view_string(this->parser->raw_text, RawSlice::text) : this->add_string(text, RawSlice::text);
+                return;
+            }
+            if (last_child != NO_NODE && last_child == this->document.nodes.size() - 1
+                && this->document.nodes[last_child].type == CompactNodeType::text
+            ) {
+                // Continues the previous text node - always at the end of the pool.
+                this->document.pool.append(text);
+                this->document.nodes[last_child].value.size += text.size();
+                return;
+            }
+            NodeIndex index = this->add_node(CompactNodeType::text);
+            this->document.nodes[index].value = this->add_string(text);
+        }
+        void processing_instruction(const ProcessingInstruction& pi) override {
+            if (this->open_elements.empty()) {
+                this->document.processing_instructions.push_back(pi);
+                return;
+            }
+            NodeIndex index = this->add_node(CompactNodeType::processing_instruction);
+            this->document.nodes[index].name = this->add_string(pi.target);
+            this->document.nodes[index].value = this->add_string(pi.instruction);
+        }
+        void end_document() override {
+            this->document.nodes.shrink_to_fit();
+            this->document.attributes.shrink_to_fit();
+            this->document.pool.shrink_to_fit();
+        }
+};
+
+std::string_view CompactDocument::get(const StringSlice& slice) const {
+    std::string_view data = slice.in_source
+        ? this->source.substr(slice.offset, slice.size) : std::string_view(this->pool).substr(slice.offset, slice.size);
+    if (slice.raw == RawSlice::none) {
+        return data;
+    }
+    // Raw input with nothing to decode is the value itself (without the quotes, for attributes).
+    if (slice.raw == RawSlice::attribute_value) {
+        std::string_view value = data.substr(1, data.size() - 2);
+        if (value.find_first_of("&\t\n\r") == std::string_view::npos) {
+            return value;
+        }
+    } else if (data.find_first_of("&<\r") == std::string_view::npos) {
+        return data;
+    }
+    std::unordered_map<std::size_t, String>& decoded = slice.in_source ? this->decoded_source : this->decoded;
+    auto decoded_it = decoded.find(slice.offset);
+    if (decoded_it == decoded.end()) {
+        // Already known to be well-formed, so decoding cannot fail.
+        Parser parser(data);
+        String value;
+        if (slice.raw == RawSlice::attribute_value) {
+            value = parser.parse_attribute_value<PlainBufferPolicy>(this->doctype_declaration);
+        } else {
+            Element element;
+            parser.parse_content_fragment<PlainBufferPolicy>(this->doctype_declaration, element);
+            value = std::move(element.text);
+        }
+        decoded_it = decoded.emplace(slice.offset, std::move(value)).first;
+    }
+    return decoded_it->second;
+}
+
+std::size_t CompactDocument::size() const {
+    return this->nodes.size();
+}
+
+NodeIndex CompactDocument::root() const {
+    return 0;
+}
+
+CompactNodeType CompactDocument::type(NodeIndex index) const {
+    return this->nodes.at(index).type;
+}
+
+NodeIndex CompactDocument::parent(NodeIndex index) const {
+    return this->nodes.at(index).parent;
+}
+
+NodeIndex CompactDocument::first_child(NodeIndex index) const {
+    return this->nodes.at(index).first_child;
+}
+
+NodeIndex CompactDocument::next_sibling(NodeIndex index) const {
+    return this->nodes.at(index).next_sibling;
+}
+
+std::string_view CompactDocument::name(NodeIndex index) const {
+    return this->get(this->nodes.at(index).name);
+}
+
+std::string_view CompactDocument::value(NodeIndex index) const {
+    return this->get(this->nodes.at(index).value);
+}
+
+String CompactDocument::text(NodeIndex index) const {
+    String text;
+    for (NodeIndex child = this->first_child(index); child != NO_NODE; child = this->next_sibling(child)) {
+        if (this->nodes[child].type == CompactNodeType::text) {
+            text.append(this->value(child));
+        }
+    }
+    return text;
+}
+
+std::size_t CompactDocument::attribute_count(NodeIndex index) const {
+    return this->nodes.at(index).attribute_count;
+}
+
+std::string_view CompactDocument::attribute_name(NodeIndex index, std::size_t i) const {
+    if (i >= this->attribute_count(index)) {
+        throw std::out_of_range("Attribute index out of range");
+    }
+    return this->get(this->attributes[this->nodes[index].first_attribute + i].name);
+}
+
+std::string_view CompactDocument::attribute_value(NodeIndex index, std::size_t i) const {
+    if (i >= this->attribute_count(index)) {
+        throw std::out_of_range("Attribute index out of range");
+    }
+    return this->get(this->attributes[this->nodes[index].first_attribute + i].value);
+}
+
+bool CompactDocument::has_attribute(NodeIndex index, std::string_view name) const {
+    for (std::size_t i = 0; i < this->attribute_count(index); ++i) {
+        if (this->attribute_name(index, i) == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view CompactDocument::attribute(NodeIndex index, std::string_view name) const {
+    for (std::size_t i = 0; i < this->attribute_count(index); ++i) {
+        if (this->attribute_name(index, i) == name) {
+            return this->attribute_value(index, i);
+        }
+    }
+    throw std::out_of_range("No such attribute: " + std::string(name));
+}
+
+CompactDocument parse_compact(std::string_view buffer, bool lazy, bool views) {
+    CompactDocument document;
+    Parser parser(buffer);
+    CompactDocumentBuilder builder(document, lazy || views, views ? &parser : nullptr);
+    parser.lazy = lazy || views;
+    parser.views = views;
+    parser.parse_document(builder);
+    return document;
+}
+
+CompactDocument parse_compact(std::istream& istream) {
+    CompactDocument document;
+    CompactDocumentBuilder builder(document);
+    Parser(istream).parse_document(builder);
+    return document;
+}
+
+CompactDocument parse_compact_file(const std::filesystem::path& file_path, bool lazy, bool views) {
+    std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(file_path);
+    CompactDocument document = parse_compact(file->view(), lazy, views);
+    if (views) {
+        // Views refer to the mapping, so it lives as long as the document.
+        document.source_file = std::move(file);
+    }
+    return document;
+}
+
+}
\ No newline at end of file
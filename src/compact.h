@@ -0,0 +1,127 @@
+// Compact document representation - a flat table of nodes rather than a tree of elements.
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+
+
+namespace xml {
+
+// Index of a node in a compact document.
+typedef std::size_t NodeIndex;
+// Indicates the absence of a node (e.g. no parent, no further siblings).
+constexpr NodeIndex NO_NODE = std::numeric_limits<NodeIndex>::max();
+
+// Kinds of nodes in a compact document.
+enum class CompactNodeType {element, text, processing_instruction};
+
+// Raw input held by a slice of a lazily parsed compact document, still to be decoded.
+enum class RawSlice {none, attribute_value, text};
+
+// Slice of the string pool of a compact document (or of its input, if parsed with views).
+struct StringSlice {
+    std::size_t offset = 0; // Start of the slice in the pool (or input).
+    std::size_t size = 0; // Number of bytes in the slice.
+    RawSlice raw = RawSlice::none; // Kind of raw input in the slice (none if already decoded).
+    bool in_source = false; // Slice of the input rather than the pool (views only).
+};
+
+// Attribute of an element in a compact document.
+struct CompactAttribute {
+    StringSlice name; // Attribute name.
+    StringSlice value; // Attribute value.
+};
+
+// Node in a compact document, linked to others by index.
+struct CompactNode {
+    CompactNodeType type; // Node type.
+    NodeIndex parent = NO_NODE; // Parent element (none for the root element).
+    NodeIndex first_child = NO_NODE; // First child node (elements only).
+    NodeIndex next_sibling = NO_NODE; // Next node with the same parent.
+    // Element name or PI target (empty for text).
+    StringSlice name;
+    // Character data or PI instruction (empty for elements).
+    StringSlice value;
+    std::size_t first_attribute = 0; // Index of the first attribute of the element.
+    std::size_t attribute_count = 0; // Number of attributes of the element.
+};
+
+// Document stored as a single contiguous array of nodes in document order
+// (a node always comes before its children and following siblings), with all strings
+// in a single shared pool. Much cheaper to build, traverse and destroy than nested elements.
+// Character data is stored as text nodes, with contiguous character data as a single node.
+// Note that a compact document is only checked for well-formedness (no validation).
+// If parsed lazily, the first access to a value decodes it, so is not thread-safe.
+// If parsed with views, values needing no decoding are views into the input instead.
+class CompactDocument {
+    friend class CompactDocumentBuilder;
+    friend CompactDocument parse_compact_file(const std::filesystem::path&, bool, bool);
+    std::vector<CompactNode> nodes; // All nodes in document order (root element first).
+    std::vector<CompactAttribute> attributes; // Attributes of all elements, grouped by element.
+    std::string pool; // All names, values and text (except views into the input).
+    // Decoded values of raw slices by offset, filled in on first access (lazy parsing only).
+    mutable std::unordered_map<std::size_t, String> decoded;
+    mutable std::unordered_map<std::size_t, String> decoded_source; // As above, for the input.
+    std::string_view source; // Input the views refer to (views only, not owned).
+    std::shared_ptr<const MappedFile> source_file = nullptr; // File mapping of the input, kept alive.
+
+    // Returns the string corresponding to a slice of the pool (decoding raw input if need be).
+    std::string_view get(const StringSlice&) const;
+    public:
+        String version = "1.0"; // Document version as per XML declaration (1.0 otherwise).
+        String encoding = "utf-8"; // Encoding as per XML declaration, in lower-case.
+        bool standalone = false; // Indicates whether document is 'standalone' (false by default).
+        DoctypeDeclaration doctype_declaration; // Corresponding doctype declaration of document.
+        std::vector<ProcessingInstruction> processing_instructions; // PIs in toplevel scope.
+
+        // Returns the number of nodes in the document.
+        std::size_t size() const;
+        // Returns the root element (always index 0).
+        NodeIndex root() const;
+        // Returns the type of a node.
+        CompactNodeType type(NodeIndex) const;
+        // Returns the parent element of a node (NO_NODE for the root element).
+        NodeIndex parent(NodeIndex) const;
+        // Returns the first child of a node (NO_NODE if none).
+        NodeIndex first_child(NodeIndex) const;
+        // Returns the next sibling of a node (NO_NODE if none).
+        NodeIndex next_sibling(NodeIndex) const;
+        // Returns the name of an element or the target of a PI.
+        std::string_view name(NodeIndex) const;
+        // Returns the character data of a text node or the instruction of a PI.
+        std::string_view value(NodeIndex) const;
+        // Returns all character data directly in an element (excluding text in child elements).
+        String text(NodeIndex) const;
+        // Returns the number of attributes of an element.
+        std::size_t attribute_count(NodeIndex) const;
+        // Returns the name of the ith attribute of an element (in name order).
+        std::string_view attribute_name(NodeIndex, std::size_t) const;
+        // Returns the value of the ith attribute of an element (in name order).
+        std::string_view attribute_value(NodeIndex, std::size_t) const;
+        // Returns true if an element has an attribute with the given name.
+        bool has_attribute(NodeIndex, std::string_view) const;
+        // Returns the value of the attribute with the given name (std::out_of_range if none).
+        std::string_view attribute(NodeIndex, std::string_view) const;
+};
+
+// Accepts a contiguous buffer of XML data to parse, and returns the compact document.
+// If lazy, character data and attribute values are only checked for well-formedness
+// whilst parsing, and decoded on first access (documents without a DTD only).
+// If views (implying lazy), names, attribute values and character data are not copied at all,
+// but viewed in the buffer, which must then outlive the document. Values needing decoding
+// (references, line breaks, CDATA sections, attribute whitespace) are decoded on first access.
+CompactDocument parse_compact(std::string_view, bool lazy = false, bool views = false);
+// Accepts an input stream to parse, and returns the compact document.
+CompactDocument parse_compact(std::istream&);
+// Accepts the path of a file to parse (memory mapped), and returns the compact document
+// (optionally decoding values lazily, or with views into the mapping kept alive, as above).
+CompactDocument parse_compact_file(const std::filesystem::path&, bool lazy = false, bool views = false);
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "dtd.h"
+#include <utility>
+#include "parser.h"
+
+
+namespace xml {
+
+std::filesystem::path normalise_system_id(const std::filesystem::path& system_id) {
+    return is_url_resource(system_id.string()) ? system_id : system_id.lexically_normal();
+}
+
+CompiledDtd::CompiledDtd(const std::filesystem::path& system_id) {
+    this->system_id = normalise_system_id(system_id);
+    this->declarations = Parser(std::string_view()).parse_external_subset(this->system_id);
+}
+
+const std::filesystem::path& CompiledDtd::get_system_id() const {
+    return this->system_id;
+}
+
+const DoctypeDeclaration& CompiledDtd::get_declarations() const {
+    return this->declarations;
+}
+
+std::shared_ptr<const CompiledDtd> DtdCache::get(const std::filesystem::path& system_id) {
+    std::filesystem::path key = normalise_system_id(system_id);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto dtd_it = this->dtds.find(key);
+        if (dtd_it != this->dtds.end()) {
+            return dtd_it->second;
+        }
+    }
+    // Compiled without holding the lock, so other DTDs can be looked up meanwhile.
+    // If compiled by another thread at the same time, the first one cached is kept.
+    auto dtd = std::make_shared<const CompiledDtd>(key);
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->dtds.emplace(key, std::move(dtd)).first->second;
+}
+
+void DtdCache::add(std::shared_ptr<const CompiledDtd> dtd) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->dtds[dtd->get_system_id()] = std::move(dtd);
+}
+
+std::size_t DtdCache::size() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->dtds.size();
+}
+
+void DtdCache::clear() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->dtds.clear();
+}
+
+}
\ No newline at end of file
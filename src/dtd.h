@@ -0,0 +1,49 @@
+// External DTD subsets compiled once and shared by any number of documents.
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "utils.h"
+
+
+namespace xml {
+
+// External DTD subset which has been parsed, validated and compiled (content models) once.
+// Documents referencing it copy its declarations rather than parsing it again.
+// Immutable once built, so can be shared freely between threads.
+// Note that it is only used by documents whose internal subset (if any) declares no
+// parameter entities, since these may change the meaning of the external subset.
+class CompiledDtd {
+    std::filesystem::path system_id; // Path of the external subset.
+    DoctypeDeclaration declarations; // All declarations of the external subset.
+    public:
+        // Parses the external subset at the given path (XmlError if invalid).
+        explicit CompiledDtd(const std::filesystem::path&);
+        // Returns the path of the external subset (normalised as in document system IDs).
+        const std::filesystem::path& get_system_id() const;
+        // Returns the declarations of the external subset (no root name).
+        const DoctypeDeclaration& get_declarations() const;
+};
+
+// Compiled external DTD subsets by system ID, each compiled on first use.
+// Thread-safe - many documents may be parsed at once using the same cache.
+class DtdCache {
+    mutable std::mutex mutex; // Guards the compiled DTDs.
+    std::map<std::filesystem::path, std::shared_ptr<const CompiledDtd>> dtds; // DTDs by system ID.
+    public:
+        // Returns the compiled DTD with the given system ID, compiling (and caching) it if needed.
+        std::shared_ptr<const CompiledDtd> get(const std::filesystem::path&);
+        // Adds an already compiled DTD under its system ID (replacing any existing one).
+        void add(std::shared_ptr<const CompiledDtd>);
+        // Returns the number of cached DTDs.
+        std::size_t size() const;
+        // Removes all cached DTDs.
+        void clear();
+};
+
+// Normalises a system ID (not a URL) as in document system IDs, so that paths match.
+std::filesystem::path normalise_system_id(const std::filesystem::path&);
+
+}
\ No newline at end of file
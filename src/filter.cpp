@@ -0,0 +1,71 @@
+#include "filter.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+
+namespace xml {
+
+PathFilter::PathFilter(const std::vector<std::string>& paths) {
+    for (const std::string& path : paths) {
+        if (path.size() < 2 || path.front() != '/') {
+            throw std::invalid_argument("Path must be absolute (start with '/'): " + path);
+        }
+        std::size_t step = 0;
+        std::size_t start = 1;
+        while (start <= path.size()) {
+            std::size_t end = std::min(path.find('/', start), path.size());
+            if (end == start) {
+                throw std::invalid_argument("Path must not have empty steps: " + path);
+            }
+            std::string_view name(path.data() + start, end - start);
+            std::size_t next;
+            if (name == "*") {
+                if (!this->steps[step].wildcard) {
+                    this->steps[step].wildcard = this->steps.size();
+                    this->steps.emplace_back();
+                }
+                next = this->steps[step].wildcard;
+            } else {
+                auto child = this->steps[step].children.find(name);
+                if (child == this->steps[step].children.end()) {
+                    // Read before adding the step, which may move the map the iterator points into.
+                    next = this->steps.size();
+                    this->steps[step].children.emplace(String(name), next);
+                    this->steps.emplace_back();
+                } else {
+                    next = child->second;
+                }
+            }
+            step = next;
+            start = end + 1;
+        }
+        this->steps[step].is_end = true;
+    }
+}
+
+PathFilter::States PathFilter::start() const {
+    return {0};
+}
+
+PathMatch PathFilter::match(const States& parent_states, const String& name, States& states) const {
+    states.clear();
+    for (std::size_t parent_state : parent_states) {
+        const Step& step = this->steps[parent_state];
+        auto child = step.children.find(name);
+        if (child != step.children.end()) {
+            states.push_back(child->second);
+        }
+        if (step.wildcard) {
+            states.push_back(step.wildcard);
+        }
+    }
+    for (std::size_t state : states) {
+        if (this->steps[state].is_end) {
+            return PathMatch::full;
+        }
+    }
+    return states.empty() ? PathMatch::none : PathMatch::partial;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+// Selective parsing - only keeping the parts of a document matching a set of element paths.
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+
+namespace xml {
+
+// How much of an element is kept when filtering by path.
+enum class PathMatch {
+    none, // Nothing kept (no path leads through the element).
+    partial, // Only the tag and the child elements leading to matches (ancestor of a match).
+    full // Kept in full, including everything in it (matched by a path).
+};
+
+// Set of absolute element paths such as /feed/entry/id, each step being an element name
+// or * (any element). The paths are compiled into a trie, so that an element is matched
+// against all the paths at once, given the steps matched by its parent.
+class PathFilter {
+    // Step of one or more paths, following on from the steps before it.
+    struct Step {
+        std::map<String, std::size_t, std::less<>> children; // Next steps by element name.
+        std::size_t wildcard = 0; // Next step matching any element (0 if none).
+        bool is_end = false; // Last step of a path (element matched).
+    };
+    std::vector<Step> steps {Step()}; // All steps, the first being before the root element.
+    public:
+        // Steps matched by an element (partial matches only).
+        typedef std::vector<std::size_t> States;
+        // Compiles the given paths (std::invalid_argument if a path is malformed).
+        PathFilter(const std::vector<std::string>&);
+        // Returns the states before the root element (as if matched by its parent).
+        States start() const;
+        // Matches an element by name given the states of its parent, returning how much
+        // of the element is kept. The states of the element are filled in if partial.
+        PathMatch match(const States&, const String&, States&) const;
+};
+
+}
\ No newline at end of file
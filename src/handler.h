@@ -0,0 +1,44 @@
+// SAX-style event interface - an alternative to building an entire document.
+#pragma once
+#include "utils.h"
+
+
+namespace xml {
+
+// Receives events in document order as the document is parsed, so that documents
+// can be consumed in constant memory without building Element objects.
+// Every method does nothing by default - only override the events of interest.
+// Note that no validation is performed when parsing with a handler (well-formedness only).
+class Handler {
+    public:
+        virtual ~Handler() = default;
+        // XML declaration parsed: version, encoding (lower-case), standalone.
+        // Only called if the document actually has an XML declaration.
+        virtual void xml_declaration(const String&, const String&, bool) {}
+        // Element declaration registered in the DTD.
+        virtual void element_declaration(const ElementDeclaration&) {}
+        // Attribute declaration registered in the DTD: element name, declaration.
+        virtual void attribute_declaration(const String&, const AttributeDeclaration&) {}
+        // General entity declaration registered in the DTD.
+        virtual void general_entity_declaration(const GeneralEntity&) {}
+        // Parameter entity declaration registered in the DTD.
+        virtual void parameter_entity_declaration(const ParameterEntity&) {}
+        // Notation declaration registered in the DTD.
+        virtual void notation_declaration(const NotationDeclaration&) {}
+        // Entire DOCTYPE declaration parsed (internal and external subsets).
+        virtual void doctype_declaration(const DoctypeDeclaration&) {}
+        // Start tag or empty tag: element name, attributes (including ATTLIST defaults).
+        virtual void start_element(const String&, const Attributes&) {}
+        // End tag: element name. Also called straight after start_element for empty tags.
+        virtual void end_element(const String&) {}
+        // Character data of the current element. Contiguous character data
+        // may be split across multiple calls.
+        virtual void characters(const String&) {}
+        // Processing instruction within an element or at the toplevel of the document.
+        // PIs in the DTD are included in the DOCTYPE declaration instead.
+        virtual void processing_instruction(const ProcessingInstruction&) {}
+        // End of the document reached, with no errors.
+        virtual void end_document() {}
+};
+
+}
\ No newline at end of file
@@ -1,58 +1,120 @@
 #include "parser.h"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <memory_resource>
+#include <thread>
+#include <tuple>
 #include "validate.h"
-#include <fstream>
 
 namespace xml {
 
+// Adds the time from construction to destruction to a total (if statistics are collected).
+class StatsTimer {
+    double* total; // Total added to (none if not collecting statistics).
+    std::chrono::steady_clock::time_point start; // Time of construction.
+    public:
+        StatsTimer(double* total) : total(total) {
+            if (this->total != nullptr) {
+                this->start = std::chrono::steady_clock::now();
+            }
+        }
+        ~StatsTimer() {
+            if (this->total != nullptr) {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->start;
+                *this->total += elapsed.count();
+            }
+        }
+};
+
+// Memory resource passing everything on to another, counting the allocations (statistics).
+class CountingResource : public std::pmr::memory_resource {
+    std::shared_ptr<std::pmr::memory_resource> arena; // Arena passed on to (kept alive), if any.
+    std::pmr::memory_resource* upstream; // Resource passed on to.
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        this->allocations.fetch_add(1, std::memory_order_relaxed);
+        return this->upstream->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        this->upstream->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+    public:
+        std::atomic<std::size_t> allocations = 0; // Number of allocations so far (from any thread).
+        CountingResource(std::shared_ptr<std::pmr::memory_resource> arena)
+            : arena(arena), upstream(arena != nullptr ? arena.get() : std::pmr::get_default_resource()) {}
+};
+
+// Returns the number of bytes of the UTF-8 encoding of a character.
+static std::size_t utf8_size(Char c) {
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
 EntityStream::EntityStream(const String& text, const String& name) {
-    this->text = text;
+    this->text = &text;
     this->name = name;
     this->pos = 0;
     this->is_external = false;
 }
 
-EntityStream::EntityStream(const std::filesystem::path& file_path, const String& name) {
+EntityStream::EntityStream(
+    const std::filesystem::path& file_path, std::shared_ptr<const ExternalResource> resource,
+    const String& name
+) {
     this->file_path = file_path;
-    std::ifstream* stream_ptr = new std::ifstream(this->file_path);
-    if (!stream_ptr->is_open()) {
-        throw XmlError("Could not open file: " + file_path.string());
-    }
-    this->stream = unique_istream_ptr(stream_ptr);
+    this->resource = std::move(resource);
     this->name = name;
-    Parser* parser_ptr = new Parser(*this->stream);
-    this->parser = std::unique_ptr<Parser>(parser_ptr);
+    this->parser = std::make_unique<Parser>(this->resource->file->view());
     this->is_external = true;
+    // Start straight after the text declaration (already parsed).
+    this->parser->buffer_pos += this->resource->text_start;
+    this->parser->position_start = this->parser->buffer_pos;
+    this->parser->buffer_validated_end = this->parser->buffer_begin + this->resource->validated_size;
+    this->parser->line_number = this->resource->line_number;
+    this->parser->line_pos = this->resource->line_pos;
+    this->version = this->resource->version;
+    this->encoding = this->resource->encoding;
+}
+
+std::shared_ptr<const ExternalResource> EntityStream::load(const std::filesystem::path& file_path) {
+    auto resource = std::make_shared<ExternalResource>();
+    resource->file = std::make_unique<MappedFile>(file_path);
+    std::string_view data = resource->file->view();
+    resource->validated_size = validate_utf8(data.data(), data.data() + data.size()) - data.data();
+    EntityStream stream(file_path, resource, "");
     // Seek ahead, checking for text declaration.
     bool has_text_declaration = true;
     for (Char c : String("<?xml")) {
-        if (this->eof() || this->get() != c) {
+        if (stream.eof() || stream.get() != c) {
             has_text_declaration = false;
             break;
         }
-        operator++();
+        ++stream;
     }
     if (has_text_declaration) {
         // At least one whitespace after.
-        has_text_declaration = !this->eof() && is_whitespace(this->get());
+        has_text_declaration = !stream.eof() && is_whitespace(stream.get());
     }
     if (!has_text_declaration) {
-        // Reset stream to start if there is no text declaration.
-        this->stream->seekg(0, std::ios::beg);
-        this->parser->previous_char = -1;
-        this->parser->just_parsed_carriage_return = false;
-        this->parser->line_number = 1;
-        this->parser->line_pos = 1;
-        this->leading_parameter_space_done = false;
-        this->trailing_parameter_space_done = false;
-        return;
+        // Text starts at the start of the file if there is no text declaration.
+        return resource;
     }
     try {
-        this->parse_text_declaration();
+        stream.parse_text_declaration();
     } catch (const XmlError& e) {
         std::string error_message = "Text declaration error in ";
-        error_message += this->file_path.string() + ": " + e.what();
+        error_message += file_path.string() + ": " + e.what();
         throw XmlError(error_message);
     }
+    resource->text_start = stream.parser->buffer_pos - stream.parser->buffer_begin;
+    std::tie(resource->line_number, resource->line_pos) = stream.parser->get_position();
+    resource->version = stream.version;
+    resource->encoding = stream.encoding;
+    return resource;
 }
 
 Char EntityStream::get() {
@@ -65,13 +127,21 @@ Char EntityStream::get() {
         if (
             (!this->leading_parameter_space_done)
             || (!this->trailing_parameter_space_done &&
-                (this->is_external ? this->parser->eof() : this->pos >= this->text.size()))
+                (this->is_external ? this->parser->eof() : this->pos >= this->text->size()))
         ) {
             return SPACE;
         }
     }
     try {
-        return this->is_external ? this->parser->get() : this->text.at(this->pos);
+        if (this->is_external) {
+            return this->parser->get();
+        }
+        if (this->pos >= this->text->size()) {
+            throw this->get_eof_error_object();
+        }
+        // Decode the UTF-8 character at the current byte position.
+        const char* pos = this->text->data() + this->pos;
+        return parse_utf8(pos, this->text->data() + this->text->size());
     } catch (...) {
         throw this->get_eof_error_object();
     }
@@ -85,15 +155,19 @@ void EntityStream::operator++() {
         }
         if (
             !this->trailing_parameter_space_done &&
-            (this->is_external ? this->parser->eof() : this->pos >= this->text.size())
+            (this->is_external ? this->parser->eof() : this->pos >= this->text->size())
         ) {
             this->trailing_parameter_space_done = true;
             return;
         };
     }
-    this->pos++;
     if (is_external) {
         this->parser->operator++();
+    } else if (this->pos < this->text->size()) {
+        // Skip over all bytes of the current UTF-8 character.
+        const char* pos = this->text->data() + this->pos;
+        parse_utf8(pos, this->text->data() + this->text->size());
+        this->pos = pos - this->text->data();
     }
 }
 
@@ -101,7 +175,7 @@ bool EntityStream::eof() {
     if (this->is_parameter && !this->in_entity_value) {
         return this->trailing_parameter_space_done;
     }
-    return this->is_external ? this->parser->eof() : this->pos >= this->text.size();
+    return this->is_external ? this->parser->eof() : this->pos >= this->text->size();
 }
 
 void EntityStream::parse_text_declaration() {
@@ -172,63 +246,108 @@ XmlError EntityStream::get_eof_error_object() {
     return XmlError(message);
 }
 
-Parser::Parser(const std::string& string) {
-    this->string_buffer = std::make_unique<StringBuffer>(StringBuffer(string));
-    std::istream* istream_ptr = new std::istream(this->string_buffer.get());
-    this->stream = std::unique_ptr<std::istream>(istream_ptr);
+Parser::Parser(const std::string& string) : Parser::Parser(std::string_view(string)) {}
+
+Parser::Parser(std::string_view buffer) {
+    this->buffer_input = true;
+    this->buffer_begin = buffer.data();
+    this->buffer_pos = this->buffer_begin;
+    this->position_start = this->buffer_begin;
+    this->buffer_end = this->buffer_begin + buffer.size();
+    this->buffer_validated_end = this->buffer_begin;
 }
 
+Parser::Parser(const char* string) : Parser::Parser(std::string_view(string)) {}
+
 Parser::Parser(std::istream& istream) {
     this->stream = &istream;
 }
 
+template <typename Policy>
 Char Parser::get() {
     if (this->previous_char != -1) {
         return this->previous_char;
     }
     this->just_parsed_character_reference = false;
-    bool just_parsed_carriage_return = this->just_parsed_carriage_return;
-    this->just_parsed_carriage_return = false;
-    if (this->general_entity_stack.size()) {
-        return this->general_entity_stack.top().get();
+    if constexpr (Policy::dtd) {
+        if (!this->general_entity_stack.empty()) {
+            return this->general_entity_stack.top().get();
+        }
+        if (!this->parameter_entity_stack.empty()) {
+            return this->parameter_entity_stack.top().get();
+        }
     }
-    if (this->parameter_entity_stack.size()) {
-        return this->parameter_entity_stack.top().get();
+    if (
+        Policy::source != InputSource::stream && this->buffer_pos < this->buffer_validated_end
+        && !(*this->buffer_pos & 0b10000000) && *this->buffer_pos != CARRIAGE_RETURN
+    ) {
+        // Plain ASCII from the main input buffer (already validated) - by far the most common.
+        this->previous_char = *this->buffer_pos++;
+        return this->previous_char;
     }
     if (this->eof()) {
         throw XmlError("End of data reached unexpectedly");
     }
     Char c;
     try {
-        if (std::holds_alternative<unique_istream_ptr>(this->stream)) {
-            c = parse_utf8(*std::get<unique_istream_ptr>(this->stream));
+        // In the buffer, only moving past characters decoded successfully (for the error position).
+        const char* pos = this->buffer_pos;
+        if constexpr (Policy::source == InputSource::any) {
+            c = this->buffer_input ? this->parse_buffer_utf8(pos) : parse_utf8(*this->stream);
+        } else if constexpr (Policy::source == InputSource::buffer) {
+            c = this->parse_buffer_utf8(pos);
         } else {
-            c = parse_utf8(*std::get<std::istream*>(this->stream));
+            c = parse_utf8(*this->stream);
         }
+        this->buffer_pos = pos;
     } catch (const XmlError& e) {
         throw this->get_error_object(e.what());
     }
-    if (c == LINE_FEED && just_parsed_carriage_return) {
-        operator++();
-        return this->get();
+    if (
+        Policy::source == InputSource::stream
+        || (Policy::source == InputSource::any && !this->buffer_input)
+    ) {
+        // Buffer size is checked up front, but a stream can only be counted as it is read.
+        this->usage.bytes += utf8_size(c);
+        if (c == CARRIAGE_RETURN && this->stream->peek() == LINE_FEED) {
+            ++this->usage.bytes;
+        }
+        if (this->usage.bytes > this->limits.max_document_size) {
+            throw this->get_error_object("Document size limit exceeded");
+        }
     }
-    this->just_parsed_carriage_return = c == CARRIAGE_RETURN;
-    if (this->just_parsed_carriage_return) {
-        return LINE_FEED;
+    if (c == CARRIAGE_RETURN) {
+        // Line break normalisation - CR LF and lone CR both become LF (taking the LF now).
+        if (
+            Policy::source == InputSource::buffer
+            || (Policy::source == InputSource::any && this->buffer_input)
+        ) {
+            if (this->buffer_pos != this->buffer_end && *this->buffer_pos == LINE_FEED) {
+                ++this->buffer_pos;
+            }
+        } else if (this->stream->peek() == LINE_FEED) {
+            this->stream->get();
+        }
+        c = LINE_FEED;
     }
     this->previous_char = c;
     return c;
 }
 
+template <typename Policy>
 Char Parser::get(const GeneralEntities& general_entities, bool in_attribute_value) {
-    Char c = this->get();
+    this->expanded_general_entity = nullptr;
+    Char c = this->get<Policy>();
     if (c == AMPERSAND && !this->just_parsed_character_reference) {
-        operator++();
-        if (this->get() == OCTOTHORPE) {
-            operator++();
+        this->advance<Policy>();
+        if (this->get<Policy>() == OCTOTHORPE) {
+            this->advance<Policy>();
             return this->parse_character_reference();
         }
         this->parse_general_entity(general_entities, in_attribute_value);
+        if (this->expanded_general_entity != nullptr) {
+            return AMPERSAND;
+        }
         if (this->general_entity_stack.top().eof()) {
             // Empty entity value - immediately the end.
             if (this->general_entity_eof()) {
@@ -240,7 +359,7 @@ Char Parser::get(const GeneralEntities& general_entities, bool in_attribute_valu
                 }
                 this->general_entity_stack.pop();
             }
-            return this->get(general_entities, in_attribute_value);
+            return this->get<Policy>(general_entities, in_attribute_value);
         }
         return this->general_entity_stack.top().get();
     }
@@ -275,7 +394,12 @@ Char Parser::get(
 }
 
 void Parser::operator++() {
-    if (this->general_entity_active) {
+    this->advance<GenericPolicy>();
+}
+
+template <typename Policy>
+void Parser::advance() {
+    if (Policy::dtd && this->general_entity_active) {
         ++this->general_entity_stack.top();
         if (this->general_entity_stack.top().eof() && this->general_entity_stack.size() > 1) {
             this->general_entity_names.erase(this->general_entity_stack.top().name);
@@ -286,7 +410,7 @@ void Parser::operator++() {
         }
         return;
     }
-    if (this->parameter_entity_active) {
+    if (Policy::dtd && this->parameter_entity_active) {
         ++this->parameter_entity_stack.top();
         if (this->parameter_entity_stack.top().eof() && this->parameter_entity_stack.size() > 1) {
             this->parameter_entity_names.erase(this->parameter_entity_stack.top().name);
@@ -299,24 +423,103 @@ void Parser::operator++() {
     }
     // For a new line, increment the line number and reset line position to 1.
     // Otherwise, increment the line position to indicate progress in the line.
-    if (this->previous_char == LINE_FEED) {
-        this->line_number++;
-        this->line_pos = 1;
-    } else {
-        this->line_pos++;
+    // Only for streams - for buffers, worked out from the offset when needed (see get_position).
+    if (
+        Policy::source == InputSource::stream || (Policy::source == InputSource::any && !this->buffer_input)
+    ) {
+        if (this->previous_char == LINE_FEED) {
+            this->line_number++;
+            this->line_pos = 1;
+        } else {
+            this->line_pos++;
+        }
     }
     if (this->previous_char == -1) {
         // Not already incremented - increment by getting (disregarding returned value).
-        this->get();
+        this->get<Policy>();
     }
     this->previous_char = -1;
 }
 
 bool Parser::eof() {
-    if (std::holds_alternative<unique_istream_ptr>(this->stream)) {
-        return std::get<unique_istream_ptr>(this->stream)->peek() == EOF;
+    if (this->buffer_input) {
+        return this->buffer_pos == this->buffer_end;
+    }
+    return this->stream->peek() == EOF;
+}
+
+Char Parser::parse_buffer_utf8(const char*& pos) {
+    if (pos >= this->buffer_validated_end) {
+        this->buffer_validated_end = validate_utf8(
+            pos, pos + std::min<std::size_t>(UTF8_VALIDATION_CHUNK_SIZE, this->buffer_end - pos));
+    }
+    if (pos < this->buffer_validated_end) {
+        return decode_utf8(pos);
+    }
+    // Invalid (or incomplete) - full checks, reporting the error.
+    return parse_utf8(pos, this->buffer_end);
+}
+
+template <typename Policy>
+bool Parser::plain_run_possible() {
+    if constexpr (Policy::source == InputSource::stream) {
+        return false;
+    }
+    return (Policy::source == InputSource::buffer || this->buffer_input) && this->previous_char == -1
+        && (!Policy::dtd || (this->general_entity_stack.empty() && this->parameter_entity_stack.empty()));
+}
+
+template <typename Policy, typename Predicate>
+std::string_view Parser::parse_plain_run(
+    Predicate is_plain_byte, bool non_ascii_allowed, const ScanDelimiters* delimiters
+) {
+    if (!this->plain_run_possible<Policy>()) {
+        return {};
+    }
+    this->just_parsed_character_reference = false;
+    const char* start = this->buffer_pos;
+    const char* pos = start;
+    while (pos != this->buffer_end) {
+        if (delimiters != nullptr) {
+            pos += scan_plain_ascii(pos, this->buffer_end, *delimiters);
+            if (pos == this->buffer_end) {
+                break;
+            }
+        }
+        char byte = *pos;
+        if (byte & 0b10000000) {
+            if (!non_ascii_allowed) {
+                break;
+            }
+            // Multi-byte character - leave any error to be reported by normal parsing.
+            const char* next = pos;
+            try {
+                if (!valid_character(this->parse_buffer_utf8(next))) {
+                    break;
+                }
+            } catch (const XmlError&) {
+                break;
+            }
+            pos = next;
+            continue;
+        }
+        if (!is_plain_byte(byte)) {
+            break;
+        }
+        pos++;
     }
-    return std::get<std::istream*>(this->stream)->peek() == EOF;
+    this->buffer_pos = pos;
+    return std::string_view(start, pos - start);
+}
+
+std::string_view Parser::skip_plain_ascii(const ScanDelimiters& delimiters) {
+    if (!this->plain_run_possible()) {
+        return {};
+    }
+    const char* start = this->buffer_pos;
+    std::size_t count = scan_plain_ascii(start, this->buffer_end, delimiters);
+    this->buffer_pos += count;
+    return std::string_view(start, count);
 }
 
 bool Parser::general_entity_eof() {
@@ -329,9 +532,10 @@ bool Parser::parameter_entity_eof() {
         && this->parameter_entity_stack.top().eof();
 }
 
+template <typename Policy>
 void Parser::ignore_whitespace() {
-    while (is_whitespace(this->get())) {
-        operator++();
+    while (is_whitespace(this->get<Policy>())) {
+        this->advance<Policy>();
     }
 }
 
@@ -341,13 +545,24 @@ void Parser::ignore_whitespace(const ParameterEntities& parameter_entities) {
     }
 }
 
+template <typename Policy>
 String Parser::parse_name(
     const String& until, bool validate,
     const ParameterEntities* parameter_entities, const std::set<String>* validation_exemptions
 ) {
+    if constexpr (!Policy::decode) {
+        if (this->views) {
+            this->raw_name = this->view_name<Policy>(until, validation_exemptions);
+            return String();
+        }
+    }
     String name;
     while (true) {
-        Char c = parameter_entities != nullptr ? this->get(*parameter_entities) : this->get();
+        if (!name.empty()) {
+            // Name start character checked - take remaining ASCII name characters in bulk.
+            name.append(this->parse_plain_run<Policy>(is_plain_name_byte, false));
+        }
+        Char c = parameter_entities != nullptr ? this->get(*parameter_entities) : this->get<Policy>();
         if (std::find(until.cbegin(), until.cend(), c) != until.cend()) {
             break;
         }
@@ -358,7 +573,7 @@ String Parser::parse_name(
             throw this->get_error_object("Invalid name character");
         }
         name.push_back(c);
-        operator++();
+        this->advance<Policy>();
     }
     if (
         validate && !valid_name(name) &&
@@ -369,9 +584,71 @@ String Parser::parse_name(
     return name;
 }
 
+template <typename Policy>
+std::string_view Parser::view_name(const String& until, const std::set<String>* validation_exemptions) {
+    // First character taken from the input buffer (the rest once checked, as in parse_name).
+    Char c = this->get<Policy>();
+    const char* begin = this->buffer_pos - utf8_size(c);
+    const char* end = begin;
+    while (std::find(until.cbegin(), until.cend(), c) == until.cend()) {
+        if (end == begin && !valid_name_start_character(c)) {
+            throw this->get_error_object("Invalid name start character");
+        }
+        if (end != begin && !valid_name_character(c)) {
+            throw this->get_error_object("Invalid name character");
+        }
+        this->advance<Policy>();
+        this->parse_plain_run<Policy>(is_plain_name_byte, false);
+        end = this->buffer_pos;
+        c = this->get<Policy>();
+    }
+    std::string_view name(begin, end - begin);
+    if (
+        !valid_name(name)
+        && (validation_exemptions == nullptr || !validation_exemptions->count(String(name)))
+    ) {
+        throw this->get_error_object("Invalid name");
+    }
+    return name;
+}
+
+void Parser::sort_raw_attributes() {
+    std::vector<std::pair<std::string_view, std::string_view>>& attributes = this->raw_attributes;
+    std::sort(attributes.begin(), attributes.end());
+    // The first attribute (in input order) repeating the name of an earlier one, if any.
+    const std::pair<std::string_view, std::string_view>* repeat = nullptr;
+    for (auto run = attributes.begin(); run != attributes.end();) {
+        auto run_end = std::find_if(run, attributes.end(), [&](const auto& attribute) {
+            return attribute.first != run->first;
+        });
+        if (run_end - run > 1) {
+            // Repeated name - the second occurrence in the input is the repeat.
+            std::vector<const std::pair<std::string_view, std::string_view>*> occurrences;
+            for (auto it = run; it != run_end; ++it) {
+                occurrences.push_back(&*it);
+            }
+            std::nth_element(occurrences.begin(), occurrences.begin() + 1, occurrences.end(),
+                [](const auto* a, const auto* b) {
+                    return a->first.data() < b->first.data();
+                });
+            if (repeat == nullptr || occurrences[1]->first.data() < repeat->first.data()) {
+                repeat = occurrences[1];
+            }
+        }
+        run = run_end;
+    }
+    if (repeat != nullptr) {
+        // Reported at the end of the repeat, exactly as when the attributes are built.
+        this->buffer_pos = repeat->second.data() + repeat->second.size();
+        this->previous_char = -1;
+        throw this->get_error_object("Duplicate attribute name in the same element");
+    }
+}
+
 String Parser::parse_nmtoken(const String& until, const ParameterEntities& parameter_entities) {
     String nmtoken;
     while (true) {
+        nmtoken.append(this->parse_plain_run(is_plain_name_byte, false));
         Char c = this->get(parameter_entities);
         if (std::find(until.cbegin(), until.cend(), c) != until.cend()) {
             break;
@@ -385,18 +662,36 @@ String Parser::parse_nmtoken(const String& until, const ParameterEntities& param
     return nmtoken;
 }
 
+template <typename Policy>
 String Parser::parse_attribute_value(const DoctypeDeclaration& dtd, bool references_active, bool is_cdata) {
     // Ensure opening quote (double or single accepted).
-    Char quote = this->get();
+    Char quote = this->get<Policy>();
     if (quote != SINGLE_QUOTE && quote != DOUBLE_QUOTE) {
         throw this->get_error_object("Attribute value must start with a quote");
     }
-    operator++();
+    // Raw value including the quotes, if only checking (decoded on access instead).
+    [[maybe_unused]] const char* raw_begin = Policy::decode ? nullptr : this->buffer_pos - 1;
+    this->advance<Policy>();
     String value;
     int general_entity_stack_size_before = this->general_entity_stack.size();
     while (true) {
-        Char c = this->get(dtd.general_entities, true);
-        if (this->general_entity_stack.size() > general_entity_stack_size_before) {
+        // Literal characters without any references or normalisation are taken in bulk.
+        std::string_view run = this->parse_plain_run<Policy>(
+            is_plain_attribute_value_byte, true, &ATTRIBUTE_VALUE_DELIMITERS);
+        if constexpr (Policy::decode) {
+            value.append(run);
+        }
+        Char c = this->get<Policy>(dtd.general_entities, true);
+        if (this->expanded_general_entity != nullptr) {
+            if (!references_active) {
+                throw this->get_error_object("Cannot have entity reference here");
+            }
+            if constexpr (Policy::decode) {
+                value.append(this->expanded_general_entity->attribute_text);
+            }
+            continue;
+        }
+        if (Policy::dtd && this->general_entity_stack.size() > general_entity_stack_size_before) {
             if (!references_active) {
                 this->general_entity_stack.pop();
                 throw this->get_error_object("Cannot have entity reference here");
@@ -412,11 +707,13 @@ String Parser::parse_attribute_value(const DoctypeDeclaration& dtd, bool referen
                 } else {
                     value.push_back(c);
                 }             
+            }, [&value](const String& text) {
+                value.append(text);
             }, general_entity_stack_size_before);
             continue;
         }
         if (!this->just_parsed_character_reference) {
-            operator++();
+            this->advance<Policy>();
             if (c == quote) {
                 break;
             }
@@ -426,6 +723,9 @@ String Parser::parse_attribute_value(const DoctypeDeclaration& dtd, bool referen
         } else if (!references_active) {
             throw this->get_error_object("Cannot have character reference here");;
         }
+        if constexpr (!Policy::decode) {
+            continue;
+        }
         if (is_whitespace(c) && !this->just_parsed_character_reference) {
             // All literal whitespace that is not char reference becomes space.
             value.push_back(SPACE);
@@ -433,6 +733,14 @@ String Parser::parse_attribute_value(const DoctypeDeclaration& dtd, bool referen
             value.push_back(c);
         }
     }
+    if constexpr (!Policy::decode) {
+        std::string_view raw_value(raw_begin, this->buffer_pos - raw_begin);
+        if (this->views) {
+            this->raw_value = raw_value;
+            return String();
+        }
+        return String(raw_value);
+    }
     if (!is_cdata) {
         // If not cdata, further normalisation is required.
         // Discard leading/trailing spaces and ensure no spaces are adjacent.
@@ -480,7 +788,8 @@ String Parser::parse_entity_value(const DoctypeDeclaration& dtd) {
                 // in the value of current entity - not replacement text).
                 value.push_back(AMPERSAND);
                 String name = this->parse_general_entity_name(dtd.general_entities);
-                if (dtd.general_entities.count(name) && dtd.general_entities.at(name).is_unparsed) {
+                auto entity_it = dtd.general_entities.find(name);
+                if (entity_it != dtd.general_entities.end() && entity_it->second.is_unparsed) {
                     // Cannot have ref to unparsed entity here.
                     throw this->get_error_object(
                         "Cannot have refernce to unparsed entity in entity value");
@@ -535,18 +844,33 @@ String Parser::parse_general_entity_name(const GeneralEntities& general_entities
     return name;
 }
 
+void Parser::add_entity_expansion(std::size_t bytes) {
+    this->usage.entity_expansion += bytes;
+    if (this->usage.entity_expansion > this->limits.max_entity_expansion) {
+        throw this->get_error_object("Entity expansion limit exceeded");
+    }
+}
+
+void Parser::count_element(const Tag& tag) {
+    if (this->depth >= this->limits.max_depth) {
+        throw this->get_error_object("Element depth limit exceeded");
+    }
+    ++this->usage.elements;
+    this->usage.attributes += this->views ? this->raw_attributes.size() : tag.attributes.size();
+    this->usage.max_depth = std::max(this->usage.max_depth, this->depth + 1);
+}
+
 void Parser::parse_general_entity(const GeneralEntities& general_entities, bool in_attribute_value) {
     String name = this->parse_general_entity_name(general_entities);
-    if (!general_entities.count(name)) {
+    auto entity_it = general_entities.find(name);
+    if (entity_it == general_entities.end()) {
         throw this->get_error_object("Reference to undeclared entity");
     }
-    if (general_entities.at(name).is_unparsed) {
+    const GeneralEntity& entity = entity_it->second;
+    if (entity.is_unparsed) {
         throw this->get_error_object("Cannot have reference to unparsed entity");
     }
-    if (
-        !BUILT_IN_GENERAL_ENTITIES.count(name)
-        && general_entities.at(name).from_external && this->standalone
-    ) {
+    if (entity.from_external && this->standalone && !BUILT_IN_GENERAL_ENTITIES.count(name)) {
         // Entities DECLARED INSIDE external files prohibited if standalone.
         throw this->get_error_object("Cannot declare entities externally if standalone");
     }
@@ -554,31 +878,46 @@ void Parser::parse_general_entity(const GeneralEntities& general_entities, bool
         // Recursive self-reference - illegal.
         throw this->get_error_object("Entity recursive self-reference detected");
     }
+    ++this->usage.entity_references;
+    const GeneralEntityExpansion& expansion = expand_general_entity(entity, general_entities, this->standalone);
+    if (in_attribute_value ? expansion.in_attribute_value : expansion.in_content) {
+        // Plain text - taken in bulk by the caller.
+        this->add_entity_expansion(
+            in_attribute_value ? expansion.attribute_text.size() : expansion.text.size());
+        this->expanded_general_entity = &expansion;
+        return;
+    }
     general_entity_names.insert(name);
-    if (general_entities.at(name).is_external) {
+    if (entity.is_external) {
         if (in_attribute_value) {
             // Attribute values must not contain entity references to external entities.
             throw this->get_error_object("No external entities in attribute values");
         }
-        this->general_entity_stack.push({general_entities.at(name).external_id.system_id, name});
+        const std::filesystem::path& system_id = entity.external_id.system_id;
+        std::shared_ptr<const ExternalResource> resource = this->get_resource(system_id);
+        this->add_entity_expansion(resource->file->view().size() - resource->text_start);
+        this->general_entity_stack.push({system_id, std::move(resource), name});
         this->resource_paths.push({this->general_entity_stack.top().file_path});
         this->resource_to_stream[this->resource_paths.top()] = &this->general_entity_stack.top();
     } else {
-        this->general_entity_stack.push({general_entities.at(name).value, name});
+        this->add_entity_expansion(entity.value.size());
+        this->general_entity_stack.push({entity.value, name});
     }
     this->general_entity_active = true;
 }
 
 String Parser::parse_general_entity_text(
     const GeneralEntities& general_entities, std::function<void(Char)> func,
-    int original_depth
+    std::function<void(const String&)> expanded_func, int original_depth
 ) {
     String text;
     while (true) {
         // Ampersand means recursive entity reference.
         // Only if not ampersand should character be added to value.
         Char c = this->get(general_entities, true);
-        if (c != AMPERSAND || this->just_parsed_character_reference) {
+        if (this->expanded_general_entity != nullptr) {
+            expanded_func(this->expanded_general_entity->attribute_text);
+        } else if (c != AMPERSAND || this->just_parsed_character_reference) {
             func(c);
             if (!this->just_parsed_character_reference) {
                 operator++();
@@ -628,9 +967,18 @@ void Parser::parse_parameter_entity(const ParameterEntities& parameter_entities,
         throw this->get_error_object("Parameter entity recursive self-reference detected");
     }
     parameter_entity_names.insert(name);
-    EntityStream parameter_entity = parameter_entities.at(name).is_external
-        ? EntityStream(parameter_entities.at(name).external_id.system_id, name)
-        : EntityStream(parameter_entities.at(name).value, name);
+    ++this->usage.entity_references;
+    const ParameterEntity& entity = parameter_entities.at(name);
+    std::shared_ptr<const ExternalResource> resource = nullptr;
+    if (entity.is_external) {
+        resource = this->get_resource(entity.external_id.system_id);
+        this->add_entity_expansion(resource->file->view().size() - resource->text_start);
+    } else {
+        this->add_entity_expansion(entity.value.size());
+    }
+    EntityStream parameter_entity = entity.is_external
+        ? EntityStream(entity.external_id.system_id, std::move(resource), name)
+        : EntityStream(entity.value, name);
     parameter_entity.is_parameter = true;
     parameter_entity.in_entity_value = in_entity_value;
     if (this->parameter_entity_stack.empty()) {
@@ -652,6 +1000,24 @@ std::filesystem::path Parser::get_file_path() {
     return this->resource_paths.empty() ? std::filesystem::path() : this->resource_paths.top();
 }
 
+std::shared_ptr<const ExternalResource> Parser::get_resource(const std::filesystem::path& file_path) {
+    if (++this->usage.external_resources > this->limits.max_external_resources) {
+        throw this->get_error_object("External resource limit exceeded");
+    }
+    if (this->resource_cache == nullptr) {
+        // Only reused within this document.
+        this->resource_cache = std::make_shared<ResourceCache>();
+    }
+    return this->resource_cache->get(file_path);
+}
+
+const DtdIndex& Parser::get_dtd_index(const DoctypeDeclaration& dtd) {
+    if (this->dtd_index == nullptr || &this->dtd_index->get_dtd() != &dtd) {
+        this->dtd_index = std::make_shared<DtdIndex>(dtd);
+    }
+    return *this->dtd_index;
+}
+
 void Parser::end_parameter_entity() {
     if (this->parameter_entity_stack.top().is_external) {
         this->resource_paths.pop();
@@ -662,42 +1028,45 @@ void Parser::end_parameter_entity() {
     this->external_dtd_content_active = false;
 }
 
+template <typename Policy>
 std::pair<String, String> Parser::parse_attribute(
-    const DoctypeDeclaration& dtd, bool references_active, bool is_cdata, const String* tag_name
+    const DoctypeDeclaration& dtd, bool references_active, bool is_cdata,
+    const String* tag_name, const AttributeListDeclaration* attlist
 ) {
-    String name = this->parse_name(ATTRIBUTE_NAME_TERMINATORS, true, nullptr, &SPECIAL_ATTRIBUTE_NAMES);
+    String name = this->parse_name<Policy>(ATTRIBUTE_NAME_TERMINATORS, true, nullptr, &SPECIAL_ATTRIBUTE_NAMES);
     // Ignore whitespace until '=' is reached.
-    this->ignore_whitespace();
-    if (this->get() != EQUAL) {
+    this->ignore_whitespace<Policy>();
+    if (this->get<Policy>() != EQUAL) {
         throw this->get_error_object("Expected '='");
     }
     // Increment the '='
-    operator++();
-    this->ignore_whitespace();
+    this->advance<Policy>();
+    this->ignore_whitespace<Policy>();
     if (!is_cdata) {
         // CDATA not forced - only CDATA if attribute not declared
         // or attribute is declared as CDATA, for the given element.
-        is_cdata = tag_name != nullptr && (
-            !dtd.attribute_list_declarations.count(*tag_name)
-            || (
-                dtd.attribute_list_declarations.at(*tag_name).count(name)
-                && dtd.attribute_list_declarations.at(*tag_name).at(name).type == AttributeType::cdata)
-        );
+        if (tag_name != nullptr && attlist != nullptr) {
+            auto ad_it = attlist->find(name);
+            is_cdata = ad_it == attlist->end() || ad_it->second.type == AttributeType::cdata;
+        } else {
+            is_cdata = tag_name != nullptr;
+        }
     }
-    String value = this->parse_attribute_value(dtd, references_active, is_cdata);
-    return {name, value};
+    String value = this->parse_attribute_value<Policy>(dtd, references_active, is_cdata);
+    return {std::move(name), std::move(value)};
 }
 
+template <typename Policy>
 Tag Parser::parse_tag(const DoctypeDeclaration& dtd) {
-    Tag tag;
-    if (this->get() == SOLIDUS) {
+    Tag tag(Tag::allocator_type(this->memory_resource));
+    if (this->get<Policy>() == SOLIDUS) {
         // End tag.
-        operator++();
-        tag.name = this->parse_name(END_TAG_NAME_TERMINATORS);
+        this->advance<Policy>();
+        tag.name = this->parse_name<Policy>(END_TAG_NAME_TERMINATORS);
         tag.type = TagType::end;
         while (true) {
-            Char c = this->get();
-            operator++();
+            Char c = this->get<Policy>();
+            this->advance<Policy>();
             if (c == RIGHT_ANGLE_BRACKET) {
                 break;
             } if (!is_whitespace(c)) {
@@ -706,28 +1075,47 @@ Tag Parser::parse_tag(const DoctypeDeclaration& dtd) {
         }
     } else {
         // Start/empty tag.
-        tag.name = this->parse_name(START_EMPTY_TAG_NAME_TERMINATORS);
+        tag.name = this->parse_name<Policy>(START_EMPTY_TAG_NAME_TERMINATORS);
+        if constexpr (!Policy::decode) {
+            if (this->views) {
+                this->raw_tag_name = this->raw_name;
+                this->raw_attributes.clear();
+            }
+        }
+        const AttributeListDeclaration* attlist = nullptr;
+        if (!Policy::dtd) {
+            // No declarations at all.
+        } else if (this->well_formed_only) {
+            // Declarations only needed for attribute defaults and normalisation - no index.
+            auto ald_it = dtd.attribute_list_declarations.find(tag.name);
+            if (ald_it != dtd.attribute_list_declarations.end()) {
+                attlist = &ald_it->second;
+            }
+        } else if (!dtd.attribute_list_declarations.empty()) {
+            const DtdIndex& index = this->get_dtd_index(dtd);
+            attlist = index.get_attribute_list_declaration(index.find(tag.name));
+        }
         bool just_had_whitespace = false;
         while (true) {
-            Char c = this->get();
+            Char c = this->get<Policy>();
             if (c == RIGHT_ANGLE_BRACKET) {
-                operator++();
+                this->advance<Policy>();
                 tag.type = TagType::start;
                 break;
             }
             if (c == SOLIDUS) {
                 // Empty tag: must end in /> strictly.
                 tag.type = TagType::empty;
-                operator++();
-                c = this->get();
-                operator++();
+                this->advance<Policy>();
+                c = this->get<Policy>();
+                this->advance<Policy>();
                 if (c != RIGHT_ANGLE_BRACKET) {
                     throw this->get_error_object("Expected '>'");
                 }
                 break;
             }
             if (is_whitespace(c)) {
-                operator++();
+                this->advance<Policy>();
                 just_had_whitespace = true;
                 continue;
             }
@@ -736,22 +1124,47 @@ Tag Parser::parse_tag(const DoctypeDeclaration& dtd) {
             }
             just_had_whitespace = false;
             // Not end or whitespace, so must be an attribute.
-            std::pair<String, String> attribute = this->parse_attribute(dtd, true, false, &tag.name);
-            if (tag.attributes.count(attribute.first)) {
+            std::pair<String, String> attribute = this->parse_attribute<Policy>(dtd, true, false, &tag.name, attlist);
+            if constexpr (!Policy::decode) {
+                if (this->views) {
+                    // Nothing built - checked for duplicates once all are seen.
+                    this->raw_attributes.emplace_back(this->raw_name, this->raw_value);
+                    if (this->raw_attributes.size() > this->limits.max_attributes) {
+                        throw this->get_error_object("Attribute limit exceeded");
+                    }
+                    continue;
+                }
+            }
+            if (!tag.attributes.insert(std::move(attribute)).second) {
                 throw this->get_error_object("Duplicate attribute name in the same element");
             }
-            tag.attributes.insert(attribute);
+            if (tag.attributes.size() > this->limits.max_attributes) {
+                throw this->get_error_object("Attribute limit exceeded");
+            }
+        }
+        if constexpr (!Policy::decode) {
+            if (this->views) {
+                this->sort_raw_attributes();
+            }
         }
-        if (dtd.attribute_list_declarations.count(tag.name)) {
+        if (Policy::dtd && attlist != nullptr) {
             // Add default values if available. No validation here at all. That is for later.
-            for (const auto& [attribute_name, attribute] : dtd.attribute_list_declarations.at(tag.name)) {
-                if (!tag.attributes.count(attribute_name) && attribute.has_default_value) {
+            // Both in name order, so the position of each missing attribute is known.
+            auto attribute_it = tag.attributes.begin();
+            for (const auto& [attribute_name, attribute] : *attlist) {
+                while (attribute_it != tag.attributes.end() && attribute_it->first < attribute_name) {
+                    ++attribute_it;
+                }
+                if (attribute_it != tag.attributes.end() && attribute_it->first == attribute_name) {
+                    continue;
+                }
+                if (attribute.has_default_value) {
                     if (attribute.from_external && this->standalone) {
                         throw this->get_error_object(
                             "Default attribute value declared externally "
                             "cannot be used in standalone document");
                     }
-                    tag.attributes[attribute_name] = attribute.default_value;
+                    tag.attributes.emplace_hint(attribute_it, attribute_name, attribute.default_value);
                 }
             }
         }
@@ -763,6 +1176,9 @@ void Parser::parse_comment() {
     // This implementation will for now ignore comments.
     Char prev_char = -1;
     while (true) {
+        if (!this->skip_plain_ascii(COMMENT_DELIMITERS).empty()) {
+            prev_char = -1;
+        }
         Char c = this->get();
         if (c == HYPHEN && prev_char == HYPHEN) {
             // -- found, needs to be closing part of comment otherwise invalid.
@@ -786,6 +1202,12 @@ String Parser::parse_cdata() {
     Char prev_prev_char = -1;
     Char prev_char = -1;
     while (true) {
+        std::string_view run = this->skip_plain_ascii(CDATA_DELIMITERS);
+        if (!run.empty()) {
+            cdata.append(run);
+            prev_prev_char = -1;
+            prev_char = -1;
+        }
         Char c = this->get();
         // Note, CDATA section must end in ]]>
         if (
@@ -828,6 +1250,11 @@ ProcessingInstruction Parser::parse_processing_instruction(bool detect_xml_decla
     }
     Char prev_char = -1;
     while (true) {
+        std::string_view run = this->skip_plain_ascii(PROCESSING_INSTRUCTION_DELIMITERS);
+        if (!run.empty()) {
+            pi.instruction.append(run);
+            prev_char = -1;
+        }
         Char c = this->get();
         // Closed with ?>
         if (c == RIGHT_ANGLE_BRACKET && prev_char == QUESTION_MARK) {
@@ -846,144 +1273,559 @@ ProcessingInstruction Parser::parse_processing_instruction(bool detect_xml_decla
     return pi;
 }
 
-Element Parser::parse_element(const DoctypeDeclaration& dtd, bool allow_end) {
-    Tag tag = this->parse_tag(dtd);
-    Element element;
-    element.tag = tag;
-    switch (tag.type) {
-        case TagType::start:
-            break;
-        case TagType::end:
-            if (allow_end) {
-                // Only as the end tag of a parent element.
-                return element;
-            }
-            throw this->get_error_object("Not expecting end tag");
-        case TagType::empty:
-            return element;
+template <typename Policy>
+ContentType Parser::parse_content(const DoctypeDeclaration& dtd, Element& element, String& char_data) {
+    if (Policy::dtd && this->general_entity_eof()) {
+        this->end_general_entity();
     }
-    // Process normal element after start tag seen.
-    String char_data;
-    int general_entity_stack_size_before = this->general_entity_stack.size();
-    while (true) {
-        if (this->general_entity_eof()) {
-            this->end_general_entity();
+    // Plain character data (by far the most common) is taken in bulk where possible.
+    std::string_view run = this->parse_plain_run<Policy>(is_plain_character_data_byte, true, &CHARACTER_DATA_DELIMITERS);
+    if (!Policy::decode && !run.empty()) {
+        this->raw_text_seen = true;
+        element.is_empty = false;
+        return ContentType::character_data;
+    }
+    if (!run.empty()) {
+        char_data.append(run);
+        if (element.children_only) {
+            element.children_only = std::all_of(run.begin(), run.end(), [](char c) {
+                return is_whitespace(c);
+            });
+        }
+        element.is_empty = false;
+        return ContentType::character_data;
+    }
+    if constexpr (Policy::source != InputSource::stream) {
+        if (
+            (Policy::source == InputSource::buffer || this->buffer_input)
+            && this->buffer_pos == this->buffer_end && this->previous_char == -1
+            && (!Policy::dtd || (this->general_entity_stack.empty() && this->parameter_entity_stack.empty()))
+        ) {
+            // The data ends inside an element (as get would throw).
+            this->rejection = "End of data reached unexpectedly";
+            return ContentType::rejected;
+        }
+    }
+    Char c = this->get<Policy>(dtd.general_entities);
+    if (Policy::dtd && this->general_entity_active) {
+        while (
+            c == AMPERSAND && !this->just_parsed_character_reference
+            && this->expanded_general_entity == nullptr
+        ) {
+            c = this->get<Policy>(dtd.general_entities);
         }
-        Char c = this->get(dtd.general_entities);
-        if (this->general_entity_active) {
-            while (c == AMPERSAND && !this->just_parsed_character_reference) {
-                c = this->get(dtd.general_entities);
+    }
+    if (
+        !Policy::decode && (this->expanded_general_entity != nullptr || this->just_parsed_character_reference
+        || (c != LEFT_ANGLE_BRACKET && c != RIGHT_ANGLE_BRACKET))
+    ) {
+        // Only checking - the reference or character itself is all that matters.
+        if (this->expanded_general_entity == nullptr && !this->just_parsed_character_reference) {
+            if (!valid_character(c)) {
+                this->rejection = this->get_error_object("Invalid character").what();
+                return ContentType::rejected;
             }
+            this->advance<Policy>();
         }
-        if (this->just_parsed_character_reference) {
-            // Escaped character - part of character data.
+        this->raw_text_seen = true;
+        element.is_empty = false;
+        return ContentType::character_data;
+    }
+    if (this->expanded_general_entity != nullptr) {
+        // Pre-expanded entity text - character data, as if parsed character by character.
+        const GeneralEntityExpansion& expansion = *this->expanded_general_entity;
+        if (expansion.text.empty()) {
+            return ContentType::character_data;
+        }
+        if (expansion.character_references_end) {
+            // Text up to the last character reference flushed, as for any character reference.
+            element.text.reserve(
+                element.text.size() + char_data.size() + expansion.character_references_end);
+            element.text.append(char_data);
+            element.text.append(expansion.text, 0, expansion.character_references_end);
+            char_data.assign(expansion.text, expansion.character_references_end);
+        } else {
+            char_data.append(expansion.text);
+        }
+        element.children_only = element.children_only && expansion.whitespace_only;
+        element.is_empty = false;
+        return ContentType::character_data;
+    }
+    if (this->just_parsed_character_reference) {
+        // Escaped character - part of character data.
+        element.text.reserve(element.text.size() + char_data.size());
+        element.text.insert(element.text.end(), char_data.begin(), char_data.end());
+        element.text.push_back(c);
+        char_data.clear();
+        element.is_empty = false;
+        element.children_only = false;
+        return ContentType::character_data;
+    }
+    switch (c) {
+        case LEFT_ANGLE_BRACKET:
+            if constexpr (!Policy::decode) {
+                this->raw_text_end = this->buffer_pos - 1;
+            }
+            // Flush current character data to overall text.
             element.text.reserve(element.text.size() + char_data.size());
             element.text.insert(element.text.end(), char_data.begin(), char_data.end());
-            element.text.push_back(c);
             char_data.clear();
-            element.is_empty = false;
-            element.children_only = false;
-            continue;
-        }
-        switch (c) {
-            case LEFT_ANGLE_BRACKET: {
-                // Flush current character data to overall text.
-                element.text.reserve(element.text.size() + char_data.size());
-                element.text.insert(element.text.end(), char_data.begin(), char_data.end());
-                char_data.clear();
-                operator++();
-                switch (this->get()) {
-                    case EXCLAMATION_MARK:
-                        // Comment or CDATA section.
-                        operator++();
-                        switch (this->get()) {
-                            case HYPHEN:
-                                // Further narrowed to comment.
-                                operator++();
-                                if (this->get() != HYPHEN) {
-                                    // Not starting with <!--
+            this->advance<Policy>();
+            switch (this->get<Policy>()) {
+                case EXCLAMATION_MARK:
+                    // Comment or CDATA section.
+                    this->advance<Policy>();
+                    switch (this->get<Policy>()) {
+                        case HYPHEN:
+                            // Further narrowed to comment.
+                            this->advance<Policy>();
+                            if (this->get<Policy>() != HYPHEN) {
+                                // Not starting with <!--
+                                throw this->get_error_object("Unexpected character");
+                            }
+                            this->advance<Policy>();
+                            this->parse_comment();
+                            element.is_empty = false;
+                            return ContentType::comment;
+                        case LEFT_SQUARE_BRACKET: {
+                            // Further narrowed to CDATA.
+                            this->advance<Policy>();
+                            String required_chars("CDATA[");
+                            for (Char required : required_chars) {
+                                if (this->get<Policy>() != required) {
                                     throw this->get_error_object("Unexpected character");
                                 }
-                                operator++();
-                                this->parse_comment();
-                                break;
-                            case LEFT_SQUARE_BRACKET: {
-                                // Further narrowed to CDATA.
-                                operator++();
-                                String required_chars("CDATA[");
-                                for (Char required : required_chars) {
-                                    if (this->get() != required) {
-                                        throw this->get_error_object("Unexpected character");
-                                    }
-                                    operator++();
-                                }
-                                String cdata = this->parse_cdata();
-                                element.text.reserve(element.text.size() + cdata.size());
-                                element.text.insert(element.text.end(), cdata.begin(), cdata.end());
-                                element.children_only = false;
-                                break;
+                                this->advance<Policy>();
                             }
-                            default:
-                                throw this->get_error_object("Unexpected character");
-                        }
-                        break;
-                    case QUESTION_MARK:
-                        // Processing instruction.
-                        operator++();
-                        element.processing_instructions.push_back(this->parse_processing_instruction());
-                        element.children_only = false;
-                        break;
-                    default:
-                        // Must be child element or erroneous.
-                        Element child = this->parse_element(dtd, true);
-                        if (child.tag.type == TagType::end) {
-                            if (child.tag.name != tag.name) {
-                                throw this->get_error_object(
-                                    "End tag name must match start tag name");
+                            String cdata = this->parse_cdata();
+                            if constexpr (!Policy::decode) {
+                                this->raw_text_seen = this->raw_text_seen || !cdata.empty();
+                                element.is_empty = false;
+                                return ContentType::cdata;
                             }
-                            goto done;
+                            element.text.reserve(element.text.size() + cdata.size());
+                            element.text.insert(element.text.end(), cdata.begin(), cdata.end());
+                            element.is_empty = false;
+                            element.children_only = false;
+                            return ContentType::cdata;
                         }
-                        element.children.push_back(child);
-                }
-                break;
-            }
-            case RIGHT_ANGLE_BRACKET:
-                // Check ']]>' not formed (strange standard requirement).
+                        default:
+                            throw this->get_error_object("Unexpected character");
+                    }
+                case QUESTION_MARK:
+                    // Processing instruction (to be parsed by the caller).
+                    this->advance<Policy>();
+                    element.is_empty = false;
+                    element.children_only = false;
+                    return ContentType::processing_instruction;
+                default:
+                    // Must be a tag or erroneous (tag to be parsed by the caller).
+                    return ContentType::tag;
+            }
+        case RIGHT_ANGLE_BRACKET:
+            if constexpr (!Policy::decode) {
+                // No character data kept - check the raw input instead (the '>' just taken).
                 if (
-                    char_data.size() >= 2
-                    && *(char_data.end() - 1) == RIGHT_SQUARE_BRACKET
-                    && *(char_data.end() - 2) == RIGHT_SQUARE_BRACKET
+                    this->buffer_pos - this->buffer_begin >= 3
+                    && *(this->buffer_pos - 2) == RIGHT_SQUARE_BRACKET
+                    && *(this->buffer_pos - 3) == RIGHT_SQUARE_BRACKET
                 ) {
                     throw this->get_error_object("']]>' literal disallowed in character data");
                 }
-                char_data.push_back(c);
-                operator++();
+                this->advance<Policy>();
+                this->raw_text_seen = true;
+                element.is_empty = false;
+                return ContentType::character_data;
+            }
+            // Check ']]>' not formed (strange standard requirement).
+            if (
+                char_data.size() >= 2
+                && *(char_data.end() - 1) == RIGHT_SQUARE_BRACKET
+                && *(char_data.end() - 2) == RIGHT_SQUARE_BRACKET
+            ) {
+                throw this->get_error_object("']]>' literal disallowed in character data");
+            }
+            char_data.push_back(c);
+            this->advance<Policy>();
+            element.children_only = false;
+            break;
+        default:
+            // Any other character continues on the character data if valid.
+            if (!valid_character(c)) {
+                this->rejection = this->get_error_object("Invalid character").what();
+                return ContentType::rejected;
+            }
+            this->advance<Policy>();
+            char_data.push_back(c);
+            if (!is_whitespace(c)) {
                 element.children_only = false;
-                break;
-            default:
-                // Any other character continues on the character data if valid.
-                if (!valid_character(c)) {
-                    throw this->get_error_object("Invalid character");
-                }
-                operator++();
-                char_data.push_back(c);
-                if (!is_whitespace(c)) {
-                    element.children_only = false;
-                }
+            }
+    }
+    element.is_empty = false;
+    return ContentType::character_data;
+}
+
+template <typename Policy>
+Element Parser::parse_element(const DoctypeDeclaration& dtd, bool allow_end) {
+    Element element(Element::allocator_type(this->memory_resource));
+    element.tag = this->parse_tag<Policy>(dtd);
+    const Tag& tag = element.tag;
+    PathMatch parent_match = this->path_match;
+    if (tag.type == TagType::end) {
+        this->last_element_match = parent_match;
+        if (allow_end) {
+            // Only as the end tag of a parent element.
+            return element;
+        }
+        throw this->get_error_object("Not expecting end tag");
+    }
+    this->begin_element(tag);
+    if (tag.type == TagType::empty) {
+        return element;
+    }
+    PathMatch match = this->last_element_match;
+    this->path_match = match;
+    ++this->depth;
+    this->parse_element_content<Policy>(dtd, element);
+    --this->depth;
+    this->path_match = parent_match;
+    if (parent_match == PathMatch::partial) {
+        this->path_states.pop_back();
+    }
+    this->last_element_match = match;
+    return element;
+}
+
+template <typename Policy>
+void Parser::parse_element_content(const DoctypeDeclaration& dtd, Element& element) {
+    const Tag& tag = element.tag;
+    // Process normal element after start tag seen.
+    String char_data;
+    int general_entity_stack_size_before = this->general_entity_stack.size();
+    bool text_flushed = false; // Character data already passed on to the handler (or discarded)?
+    // Only the child elements leading to matches are kept if partially matched by a path.
+    bool content_kept = this->path_match == PathMatch::full;
+    // Start of the character data not yet passed on (raw input, if not decoding).
+    [[maybe_unused]] const char* raw_text_begin = this->buffer_pos;
+    // Name of the element as viewed in the input (views only, nothing else built).
+    [[maybe_unused]] std::string_view raw_tag_name = this->raw_tag_name;
+    while (true) {
+        ContentType content_type = this->parse_content<Policy>(dtd, element, char_data);
+        if (content_type != ContentType::processing_instruction && content_type != ContentType::tag) {
+            if (content_type == ContentType::rejected) {
+                return;
+            }
+            continue;
+        }
+        if constexpr (!Policy::decode) {
+            // Raw character data up to the markup (comments and CDATA sections included).
+            if (this->raw_text_seen) {
+                this->raw_text = std::string_view(raw_text_begin, this->raw_text_end - raw_text_begin);
+                this->handler->characters(this->views ? String() : String(this->raw_text));
+                this->raw_text_seen = false;
+            }
+        } else if ((this->handler != nullptr || !content_kept) && !element.text.empty()) {
+            // Streaming - pass on character data so far rather than retaining it.
+            if (this->handler != nullptr) {
+                this->handler->characters(element.text);
+            }
+            element.text.clear();
+            text_flushed = true;
+        }
+        if (content_type == ContentType::processing_instruction) {
+            if (this->handler != nullptr) {
+                this->handler->processing_instruction(this->parse_processing_instruction());
+            } else if (content_kept) {
+                element.processing_instructions.push_back(this->parse_processing_instruction());
+            } else {
+                this->parse_processing_instruction();
+            }
+            raw_text_begin = this->buffer_pos;
+            continue;
+        }
+        // Must be child element or erroneous.
+        Element child = this->parse_element<Policy>(dtd, true);
+        if (!this->rejection.empty()) {
+            return;
+        }
+        if (child.tag.type == TagType::end) {
+            bool name_matches = child.tag.name == tag.name;
+            if constexpr (!Policy::decode) {
+                name_matches = this->views ? this->raw_name == raw_tag_name : name_matches;
+            }
+            if (!name_matches) {
+                this->rejection = this->get_error_object("End tag name must match start tag name").what();
+                return;
+            }
+            break;
+        }
+        raw_text_begin = this->buffer_pos;
+        if (
+            this->handler == nullptr && (this->last_element_match == PathMatch::full
+            || (this->last_element_match == PathMatch::partial && !child.children.empty()))
+        ) {
+            element.children.push_back(std::move(child));
         }
         element.is_empty = false;
     }
-    done:;
     // General entities not properly closed.
-    if (this->general_entity_stack.size() != general_entity_stack_size_before) {
+    if (Policy::dtd && this->general_entity_stack.size() != general_entity_stack_size_before) {
         throw this->get_error_object(
             "Element must start and end in the same entity replacement text");
     }
+    this->end_element(element, text_flushed);
+}
+
+void Parser::begin_element(const Tag& tag) {
+    this->count_element(tag);
+    if (this->validator != nullptr) {
+        try {
+            this->validator->start_element(tag.name, tag.attributes);
+            if (tag.type == TagType::empty) {
+                this->validator->end_element(true, true, false);
+            }
+        } catch (const XmlError& e) {
+            throw this->get_error_object(e.what());
+        }
+    }
+    PathMatch parent_match = this->path_match;
+    if (parent_match == PathMatch::partial) {
+        // Filtering by path - how much of the element is kept depends on its name.
+        this->path_states.emplace_back();
+        this->last_element_match = this->path_filter->match(
+            *(this->path_states.end() - 2), tag.name, this->path_states.back());
+    } else {
+        this->last_element_match = parent_match;
+    }
+    if (this->handler != nullptr) {
+        this->handler->start_element(tag.name, tag.attributes);
+        if (tag.type == TagType::empty) {
+            this->handler->end_element(tag.name);
+        }
+    }
+    if (tag.type == TagType::empty && parent_match == PathMatch::partial) {
+        this->path_states.pop_back();
+    }
+}
+
+void Parser::end_element(const Element& element, bool text_flushed) {
+    if (this->validator != nullptr) {
+        try {
+            this->validator->end_element(
+                element.is_empty, element.children_only, text_flushed || !element.text.empty());
+        } catch (const XmlError& e) {
+            throw this->get_error_object(e.what());
+        }
+    }
+    if (this->handler != nullptr) {
+        this->handler->end_element(element.tag.name);
+    }
+}
+
+template <typename Policy>
+void Parser::parse_content_fragment(const DoctypeDeclaration& dtd, Element& element) {
+    String char_data;
+    while (!this->eof()) {
+        ContentType content_type = this->parse_content<Policy>(dtd, element, char_data);
+        if (content_type == ContentType::processing_instruction) {
+            element.processing_instructions.push_back(this->parse_processing_instruction());
+        } else if (content_type == ContentType::tag) {
+            // Child element - no end tag expected (the fragment is only part of the content).
+            element.children.push_back(this->parse_element<Policy>(dtd, false));
+            element.is_empty = false;
+        }
+        if (!this->rejection.empty()) {
+            throw XmlError(this->rejection);
+        }
+    }
+    element.text.append(char_data);
+}
+
+// Maximum total bytes of entity replacement text expanded up front for parallel parsing.
+constexpr std::size_t MAX_PARALLEL_ENTITY_EXPANSION = 1 << 20;
+
+// Returns true if no general entity can add markup to content, so that content can be
+// split between elements without knowing anything about entities. Found out by expanding
+// every entity up front (the parts parsed in parallel then only read the expansions),
+// giving up once the expansions are too large in total.
+static bool content_markup_independent(const GeneralEntities& general_entities, bool standalone) {
+    std::size_t expanded_size = 0;
+    for (const auto& [name, entity] : general_entities) {
+        if (entity.is_unparsed) {
+            continue;
+        }
+        const GeneralEntityExpansion& expansion = expand_general_entity(entity, general_entities, standalone);
+        expanded_size += expansion.text.size();
+        if (!expansion.in_content || expanded_size > MAX_PARALLEL_ENTITY_EXPANSION) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Element Parser::parse_root_element(const DoctypeDeclaration& dtd, unsigned threads, std::size_t chunk_size) {
+    Element element(Element::allocator_type(this->memory_resource));
+    element.tag = this->parse_tag(dtd);
+    if (element.tag.type == TagType::end) {
+        throw this->get_error_object("Not expecting end tag");
+    }
+    this->count_element(element.tag);
+    if (element.tag.type == TagType::empty) {
+        return element;
+    }
+    this->depth = 1;
+    // Children of the root element found in advance, then split into contiguous chunks
+    // of roughly equal size (several per thread, balancing the work).
+    std::vector<const char*> children;
+    const char* content_begin = this->buffer_pos;
+    const char* content_end = nullptr;
+    if (this->previous_char == -1 && !this->general_entity_active) {
+        content_end = scan_child_elements(content_begin, this->buffer_end, children);
+    }
+    std::vector<const char*> bounds {content_begin};
+    if (content_end != nullptr) {
+        std::size_t content_size = content_end - content_begin;
+        std::size_t chunk_count = std::min<std::size_t>(threads * 4, content_size / chunk_size);
+        auto child = children.begin();
+        for (std::size_t i = 1; i < chunk_count; ++i) {
+            child = std::lower_bound(child, children.end(), content_begin + content_size * i / chunk_count);
+            if (child == children.end()) {
+                break;
+            }
+            if (*child > bounds.back()) {
+                bounds.push_back(*child);
+            }
+        }
+    }
+    if (bounds.size() < 2) {
+        // Nothing to split - parse as normal.
+        if (dtd.exists) {
+            this->parse_element_content(dtd, element);
+        } else {
+            this->parse_element_content<PlainBufferPolicy>(dtd, element);
+        }
+        if (!this->rejection.empty()) {
+            throw XmlError(this->rejection);
+        }
+        return element;
+    }
+    bounds.push_back(content_end);
+    // Each chunk is parsed independently, the chunks taken in turn by the threads
+    // (all sharing the index of the DTD).
+    if (!this->well_formed_only) {
+        this->get_dtd_index(dtd);
+    }
+    // Parts allocated like the root element, so that their children are moved rather than copied.
+    std::vector<Element> parts;
+    parts.reserve(bounds.size() - 1);
+    for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+        parts.emplace_back(Element::allocator_type(this->memory_resource));
+    }
+    std::vector<std::exception_ptr> errors(parts.size());
+    // Resources used by each chunk, only counted against the limits together once all are done.
+    std::vector<ParseStats> part_usage(parts.size());
+    std::atomic<std::size_t> next_part = 0;
+    auto parse_parts = [&]() {
+        for (std::size_t i; (i = next_part++) < parts.size();) {
+            try {
+                Parser parser(std::string_view(bounds[i], bounds[i + 1] - bounds[i]));
+                parser.standalone = this->standalone;
+                parser.well_formed_only = this->well_formed_only;
+                parser.dtd_index = this->dtd_index;
+                parser.memory_resource = this->memory_resource;
+                parser.limits = this->limits;
+                parser.depth = 1;
+                if (dtd.exists) {
+                    parser.parse_content_fragment(dtd, parts[i]);
+                } else {
+                    parser.parse_content_fragment<PlainBufferPolicy>(dtd, parts[i]);
+                }
+                part_usage[i] = parser.usage;
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < std::min<std::size_t>(threads, parts.size()); ++i) {
+        workers.emplace_back(parse_parts);
+    }
+    parse_parts();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+    }
+    for (const ParseStats& usage : part_usage) {
+        this->usage.elements += usage.elements;
+        this->usage.attributes += usage.attributes;
+        this->usage.entity_references += usage.entity_references;
+        this->add_entity_expansion(usage.entity_expansion);
+        this->usage.external_resources += usage.external_resources;
+        this->usage.max_depth = std::max(this->usage.max_depth, usage.max_depth);
+    }
+    if (this->usage.external_resources > this->limits.max_external_resources) {
+        throw this->get_error_object("External resource limit exceeded");
+    }
+    // Chunks joined back together in order.
+    std::size_t child_count = 0;
+    for (const Element& part : parts) {
+        child_count += part.children.size();
+    }
+    element.children.reserve(child_count);
+    for (Element& part : parts) {
+        element.text.append(part.text);
+        element.children.insert(element.children.end(),
+            std::make_move_iterator(part.children.begin()), std::make_move_iterator(part.children.end()));
+        element.processing_instructions.insert(element.processing_instructions.end(),
+            std::make_move_iterator(part.processing_instructions.begin()),
+            std::make_move_iterator(part.processing_instructions.end()));
+        element.is_empty = element.is_empty && part.is_empty;
+        element.children_only = element.children_only && part.children_only;
+    }
+    // Continue from the end tag of the root element (any error from here is reported
+    // by parsing serially instead, see parse_document).
+    this->buffer_pos = content_end;
+    this->buffer_validated_end = content_end;
+    if (this->get() != LEFT_ANGLE_BRACKET) {
+        throw this->get_error_object("Expecting '<'");
+    }
+    operator++();
+    Tag end_tag = this->parse_tag(dtd);
+    if (end_tag.type != TagType::end || end_tag.name != element.tag.name) {
+        throw this->get_error_object("End tag name must match start tag name");
+    }
     return element;
 }
 
+Element Parser::parse_serial_root_element(const DoctypeDeclaration& dtd) {
+    // Without a DTD, the core loop is specialised for the input source (no entities possible).
+    if (dtd.exists) {
+        return this->parse_element(dtd, false);
+    }
+    if (this->buffer_input && this->lazy && this->handler != nullptr) {
+        return this->parse_element<LazyBufferPolicy>(dtd, false);
+    }
+    if (this->buffer_input) {
+        return this->parse_element<PlainBufferPolicy>(dtd, false);
+    }
+    return this->parse_element<PlainStreamPolicy>(dtd, false);
+}
+
 Element Parser::parse_element() {
-    return this->parse_element({});
+    // Standalone element - opening '<' not yet consumed.
+    if (this->eof() || this->get() != LEFT_ANGLE_BRACKET) {
+        throw this->get_error_object("Expecting '<'");
+    }
+    operator++();
+    Element element = this->parse_element({});
+    if (!this->rejection.empty()) {
+        throw XmlError(this->rejection);
+    }
+    return element;
 }
 
 void Parser::parse_xml_declaration(Document& document) {
@@ -1120,7 +1962,7 @@ ExternalID Parser::parse_external_id(const ParameterEntities* parameter_entities
     String type_string = this->parse_name(WHITESPACE, false, parameter_entities);
     try {
         external_id.type = get_external_id_type(type_string);
-    } catch (const XmlError& e) {
+    } catch (const std::out_of_range&) {
         throw this->get_error_object("Expected 'SYSTEM' or 'PUBLIC'");
     }
     if (parameter_entities) {
@@ -1172,6 +2014,9 @@ void Parser::parse_dtd_subsets(DoctypeDeclaration& dtd, bool external_subset_sta
                 !external_subset_started && dtd.external_id.type != ExternalIDType::none 
                 && !in_include
             ) {
+                if (this->merge_compiled_dtd(dtd)) {
+                    return;
+                }
                 initial_parameter_entity_stack_size = this->parameter_entity_stack.size();
                 // Create dummy parameter entity - treat External Subset like one.
                 this->start_external_subset(dtd.external_id.system_id);
@@ -1228,12 +2073,82 @@ void Parser::parse_dtd_subsets(DoctypeDeclaration& dtd, bool external_subset_sta
     }
 }
 
+bool Parser::merge_compiled_dtd(DoctypeDeclaration& dtd) {
+    std::shared_ptr<const CompiledDtd> compiled = this->external_dtd;
+    if (
+        compiled == nullptr && this->dtd_cache != nullptr
+        && !is_url_resource(dtd.external_id.system_id.string())
+    ) {
+        compiled = this->dtd_cache->get(dtd.external_id.system_id);
+    }
+    if (compiled == nullptr || !dtd.parameter_entities.empty()) {
+        // Parameter entities of the internal subset may affect the external subset.
+        return false;
+    }
+    // Declarations merged as if parsed after the internal subset.
+    const DoctypeDeclaration& external = compiled->get_declarations();
+    dtd.processing_instructions.insert(
+        dtd.processing_instructions.end(),
+        external.processing_instructions.begin(), external.processing_instructions.end());
+    for (const auto& [name, ed] : external.element_declarations) {
+        auto [ed_it, inserted] = dtd.element_declarations.emplace(name, ed);
+        if (!inserted) {
+            throw this->get_error_object("Element re-declaration");
+        }
+        if (this->handler != nullptr) {
+            this->handler->element_declaration(ed_it->second);
+        }
+    }
+    for (const auto& [element_name, external_ald] : external.attribute_list_declarations) {
+        AttributeListDeclaration& ald = dtd.attribute_list_declarations[element_name];
+        for (const auto& [attribute_name, ad] : external_ald) {
+            // Only the first declaration of an attribute counts.
+            auto [ad_it, inserted] = ald.emplace(attribute_name, ad);
+            if (inserted && this->handler != nullptr) {
+                this->handler->attribute_declaration(element_name, ad_it->second);
+            }
+        }
+    }
+    for (const auto& [name, ge] : external.general_entities) {
+        auto [ge_it, inserted] = dtd.general_entities.emplace(name, ge);
+        if (inserted && this->handler != nullptr) {
+            this->handler->general_entity_declaration(ge_it->second);
+        }
+    }
+    for (const auto& [name, pe] : external.parameter_entities) {
+        auto [pe_it, inserted] = dtd.parameter_entities.emplace(name, pe);
+        if (inserted && this->handler != nullptr) {
+            this->handler->parameter_entity_declaration(pe_it->second);
+        }
+    }
+    for (const auto& [name, nd] : external.notation_declarations) {
+        auto [nd_it, inserted] = dtd.notation_declarations.emplace(name, nd);
+        if (!inserted) {
+            throw this->get_error_object("Duplicate notation name");
+        }
+        if (this->handler != nullptr) {
+            this->handler->notation_declaration(nd_it->second);
+        }
+    }
+    return true;
+}
+
+DoctypeDeclaration Parser::parse_external_subset(const std::filesystem::path& system_id) {
+    DoctypeDeclaration dtd;
+    dtd.external_id.type = ExternalIDType::system;
+    dtd.external_id.system_id = system_id;
+    this->parse_dtd_subsets(dtd, true);
+    validate_attribute_list_declarations(dtd);
+    compile_element_content_models(dtd, this->limits.max_content_model_size);
+    return dtd;
+}
+
 void Parser::start_external_subset(const std::filesystem::path& system_id) {
     // Treat external subset like a special external parameter entity.
     // External subset and external param entities are actually quite similar,
     // except external subset MUST be full markup (part of DTD after all).
     // DUMMY NAME i.e. empty string (no actual parameter entity can share the name).
-    EntityStream parameter_entity(system_id, "");
+    EntityStream parameter_entity(system_id, this->get_resource(system_id), "");
     parameter_entity.is_parameter = true;
     parameter_entity.in_entity_value = false;
     this->external_dtd_content_active = true;
@@ -1360,7 +2275,11 @@ void Parser::parse_element_declaration(DoctypeDeclaration& dtd) {
         throw this->get_error_object("Expected '>'");
     }
     operator++();
-    dtd.element_declarations[element_declaration.name] = element_declaration;
+    const ElementDeclaration& registered
+        = dtd.element_declarations[element_declaration.name] = std::move(element_declaration);
+    if (this->handler != nullptr) {
+        this->handler->element_declaration(registered);
+    }
 }
 
 ElementContentModel Parser::parse_element_content_model(
@@ -1444,7 +2363,7 @@ ElementContentModel Parser::parse_element_content_model(
                     sub_ecm.count = ELEMENT_CONTENT_COUNT_SYMBOLS.at(this->get(parameter_entities));
                     operator++();
                 }
-                ecm.parts.push_back(sub_ecm);
+                ecm.parts.push_back(std::move(sub_ecm));
             }
             separator_next = true;
         }
@@ -1538,11 +2457,13 @@ void Parser::parse_attribute_list_declaration(DoctypeDeclaration& dtd) {
             operator++();
             return;
         }
-        this->parse_attribute_declaration(dtd, dtd.attribute_list_declarations[element_name]);
+        this->parse_attribute_declaration(dtd, dtd.attribute_list_declarations[element_name], element_name);
     }
 }
 
-void Parser::parse_attribute_declaration(DoctypeDeclaration& dtd, AttributeListDeclaration& attlist) {
+void Parser::parse_attribute_declaration(
+    DoctypeDeclaration& dtd, AttributeListDeclaration& attlist, const String& element_name
+) {
     AttributeDeclaration ad;
     ad.name = this->parse_name(WHITESPACE, true, &dtd.parameter_entities, &SPECIAL_ATTRIBUTE_NAMES);
     this->ignore_whitespace(dtd.parameter_entities);
@@ -1598,7 +2519,10 @@ void Parser::parse_attribute_declaration(DoctypeDeclaration& dtd, AttributeListD
     }
     ad.from_external = this->external_dtd_content_active;
     // Register for now, validate later.
-    attlist[ad.name] = ad;
+    const AttributeDeclaration& registered = attlist[ad.name] = std::move(ad);
+    if (this->handler != nullptr) {
+        this->handler->attribute_declaration(element_name, registered);
+    }
 }
 
 std::set<String> Parser::parse_enumerated_attribute(
@@ -1739,7 +2663,10 @@ void Parser::parse_general_entity_declaration(DoctypeDeclaration& dtd) {
     if (!dtd.general_entities.count(ge.name)) {
         ge.from_external = this->external_dtd_content_active;
         // Only count first instance of general entity declaration.
-        dtd.general_entities[ge.name] = ge;
+        const GeneralEntity& registered = dtd.general_entities[ge.name] = std::move(ge);
+        if (this->handler != nullptr) {
+            this->handler->general_entity_declaration(registered);
+        }
     }
 }
 
@@ -1759,7 +2686,10 @@ void Parser::parse_parameter_entity_declaration(DoctypeDeclaration& dtd) {
     if (!dtd.parameter_entities.count(pe.name)) {
         pe.from_external = this->external_dtd_content_active;
         // Only count first instance of parameter entity declaration.
-        dtd.parameter_entities[pe.name] = pe;
+        const ParameterEntity& registered = dtd.parameter_entities[pe.name] = std::move(pe);
+        if (this->handler != nullptr) {
+            this->handler->parameter_entity_declaration(registered);
+        }
     }
 }
 
@@ -1804,7 +2734,10 @@ void Parser::parse_notation_declaration(DoctypeDeclaration& dtd) {
         throw this->get_error_object("Expected '>'");
     }
     operator++();
-    dtd.notation_declarations[nd.name] = nd;
+    const NotationDeclaration& registered = dtd.notation_declarations[nd.name] = std::move(nd);
+    if (this->handler != nullptr) {
+        this->handler->notation_declaration(registered);
+    }
 }
 
 DoctypeDeclaration Parser::parse_doctype_declaration() {
@@ -1837,20 +2770,27 @@ DoctypeDeclaration Parser::parse_doctype_declaration() {
     }
     if (can_parse_internal_subset && dtd.external_id.type != ExternalIDType::none) {
         // Internal subset not provided but parse external subset anyways.
+        if (this->merge_compiled_dtd(dtd)) {
+            // Nothing but the compiled external subset - already validated.
+            reset_general_entity_expansions(dtd.general_entities);
+            return dtd;
+        }
         this->parse_dtd_subsets(dtd, true);
     }
-    // Validate attribute list declaration after entire DTD parsed.
-    validate_attribute_list_declarations(dtd);
+    if (!this->well_formed_only) {
+        // Validate attribute list declaration after entire DTD parsed.
+        validate_attribute_list_declarations(dtd);
+        compile_element_content_models(dtd, this->limits.max_content_model_size);
+    }
+    // Entities are only expanded once referenced, in the context of the complete DTD.
+    reset_general_entity_expansions(dtd.general_entities);
     return dtd;
 }
 
-Document Parser::parse_document(bool validate_elements, bool validate_attributes) {
-    Document document;
+void Parser::parse_toplevel(Document& document, bool root_seen) {
     // IMPORTANT - XML declaration MUST be the very first thing in the document
     // or else cannot be included. NOT EVEN WHITESPACE BEFORE IT.
-    bool xml_declaration_possible = true;
-    bool doctype_declaration_seen = false;
-    bool root_seen = false;
+    bool xml_declaration_possible = !root_seen;
     while (!this->eof()) {
         Char c = this->get();
         if (is_whitespace(c)) {
@@ -1875,8 +2815,14 @@ Document Parser::parse_document(bool validate_elements, bool validate_attributes
                     if (document.standalone) {
                         this->standalone = true;
                     }
+                    if (this->handler != nullptr) {
+                        this->handler->xml_declaration(
+                            document.version, document.encoding, document.standalone);
+                    }
+                } else if (this->handler != nullptr) {
+                    this->handler->processing_instruction(pi);
                 } else {
-                    document.processing_instructions.push_back(pi);
+                    document.processing_instructions.push_back(std::move(pi));
                 }
                 break;
             }
@@ -1899,15 +2845,19 @@ Document Parser::parse_document(bool validate_elements, bool validate_attributes
                         }
                         operator++();
                     }
-                    if (doctype_declaration_seen) {
+                    if (document.doctype_declaration.exists) {
                         throw this->get_error_object("Only one DOCTYPE declaration allowed");
                     }
                     if (root_seen) {
                         throw this->get_error_object("DOCTYPE declaration must precede root element");
                     }
-                    doctype_declaration_seen = true;
-                    document.doctype_declaration.exists = true;
-                    document.doctype_declaration = this->parse_doctype_declaration();
+                    {
+                        StatsTimer timer(this->stats != nullptr ? &this->usage.dtd_seconds : nullptr);
+                        document.doctype_declaration = this->parse_doctype_declaration();
+                    }
+                    if (this->handler != nullptr) {
+                        this->handler->doctype_declaration(document.doctype_declaration);
+                    }
                     break;
                 }
                 break;
@@ -1916,8 +2866,8 @@ Document Parser::parse_document(bool validate_elements, bool validate_attributes
                 if (root_seen) {
                     throw this->get_error_object("Only one root element allowed");
                 }
-                root_seen = true;
-                document.root = this->parse_element(document.doctype_declaration, false);
+                // Root element to be parsed by the caller.
+                return;
         }
         xml_declaration_possible = false;
     }
@@ -1925,25 +2875,192 @@ Document Parser::parse_document(bool validate_elements, bool validate_attributes
         // No root element seen - invalid doc.
         throw this->get_error_object("Expected a root element");
     }
-    // Only validate document if DTD given - otherwise be lenient.
-    if (document.doctype_declaration.exists) {
-        validate_document(document, validate_elements, validate_attributes);
+}
+
+Document Parser::parse_document(bool validate_elements, bool validate_attributes) {
+    ParseOptions options;
+    options.validate_elements = validate_elements;
+    options.validate_attributes = validate_attributes;
+    return this->parse_document(options);
+}
+
+Document Parser::begin_document(const ParseOptions& options) {
+    if (options.stats != nullptr) {
+        // The document keeps the counting resource alive, just like an arena.
+        this->stats = options.stats;
+        this->counting_resource = std::make_shared<CountingResource>(options.arena);
+    }
+    Document document(this->counting_resource != nullptr ? this->counting_resource : options.arena);
+    this->well_formed_only = options.well_formed_only;
+    this->external_dtd = options.external_dtd;
+    this->dtd_cache = options.dtd_cache;
+    this->resource_cache = options.resource_cache;
+    this->limits = options.limits;
+    if (this->buffer_input) {
+        this->usage.bytes = this->buffer_end - this->buffer_begin;
+        if (this->usage.bytes > this->limits.max_document_size) {
+            throw this->get_error_object("Document size limit exceeded");
+        }
+    }
+    if (document.arena != nullptr) {
+        // All elements are allocated from the arena (anything else uses the default heap).
+        this->memory_resource = document.arena.get();
+    }
+    if (!options.paths.empty() && this->handler == nullptr) {
+        this->owned_path_filter = std::make_unique<PathFilter>(options.paths);
+        this->path_filter = this->owned_path_filter.get();
+        this->path_states.push_back(this->path_filter->start());
+        this->path_match = PathMatch::partial;
     }
     return document;
 }
 
+bool Parser::begin_content(const Document& document, const ParseOptions& options) {
+    // A filtered document is incomplete, so can only be validated as it is parsed.
+    bool streaming_validation = (options.streaming_validation || this->path_filter != nullptr)
+        && document.doctype_declaration.exists && !this->well_formed_only;
+    if (streaming_validation) {
+        this->owned_validator = std::make_shared<Validator>(
+            document.doctype_declaration, options.validate_elements,
+            options.validate_attributes, document.standalone);
+        this->validator = this->owned_validator.get();
+    }
+    return streaming_validation;
+}
+
+void Parser::end_document(Document& document, const ParseOptions& options, bool streaming_validation) {
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    {
+        StatsTimer timer(this->stats != nullptr ? &this->usage.validation_seconds : nullptr);
+        if (streaming_validation) {
+            // Everything but IDREF/IDREFS values already validated.
+            this->owned_validator->end_document();
+        }
+        // Only validate document if DTD given - otherwise be lenient (and nothing to validate if streaming).
+        if (
+            document.doctype_declaration.exists && !streaming_validation
+            && !this->well_formed_only && this->handler == nullptr
+        ) {
+            validate_document(document, options.validate_elements, options.validate_attributes, threads);
+        }
+    }
+    if (this->handler != nullptr) {
+        this->handler->end_document();
+    }
+    if (this->stats != nullptr) {
+        *this->stats = this->usage;
+        this->stats->allocations = static_cast<CountingResource&>(*this->counting_resource).allocations;
+    }
+}
+
+Document Parser::parse_document(const ParseOptions& options) {
+    Document document = this->begin_document(options);
+    this->parse_toplevel(document, false);
+    bool streaming_validation = this->begin_content(document, options);
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    {
+        StatsTimer timer(this->stats != nullptr ? &this->usage.content_seconds : nullptr);
+        if (
+            threads > 1 && this->buffer_input && this->handler == nullptr && options.arena == nullptr
+            && !streaming_validation && this->path_filter == nullptr
+            && content_markup_independent(document.doctype_declaration.general_entities, this->standalone)
+        ) {
+            try {
+                document.root = this->parse_root_element(
+                    document.doctype_declaration, threads, options.parallel_chunk_size);
+                this->parse_toplevel(document, true);
+            } catch (const XmlError&) {
+                // Parse serially from the start instead, reporting the error exactly as usual.
+                ParseOptions serial_options = options;
+                serial_options.threads = 1;
+                Parser serial(std::string_view(this->buffer_begin, this->buffer_end - this->buffer_begin));
+                serial.rejection_returned = this->rejection_returned;
+                Document serial_document = serial.parse_document(serial_options);
+                this->rejection = std::move(serial.rejection);
+                return serial_document;
+            }
+        } else {
+            document.root = this->parse_serial_root_element(document.doctype_declaration);
+            if (!this->rejection.empty()) {
+                if (this->rejection_returned) {
+                    return Document();
+                }
+                throw XmlError(this->rejection);
+            }
+            this->validator = nullptr;
+            this->path_filter = nullptr;
+            this->path_match = PathMatch::full;
+            this->parse_toplevel(document, true);
+        }
+    }
+    this->end_document(document, options, streaming_validation);
+    return document;
+}
+
+ParseResult Parser::try_parse_document(const ParseOptions& options) {
+    ParseResult result;
+    this->rejection_returned = true;
+    try {
+        result.document = this->parse_document(options);
+    } catch (const XmlError& e) {
+        result.error = e.what();
+        return result;
+    }
+    if (!this->rejection.empty()) {
+        result.error = std::move(this->rejection);
+        return result;
+    }
+    result.success = true;
+    return result;
+}
+
+void Parser::parse_document(Handler& handler) {
+    this->handler = &handler;
+    this->parse_document(false, false);
+}
+
+std::pair<std::size_t, std::size_t> Parser::get_position() const {
+    if (!this->buffer_input) {
+        return {this->line_number, this->line_pos};
+    }
+    const char* end = this->buffer_pos;
+    if (this->previous_char != -1 && end > this->position_start) {
+        // Current character already read but not yet passed - step back over it.
+        if (
+            this->previous_char == LINE_FEED && end - this->position_start >= 2
+            && *(end - 1) == LINE_FEED && *(end - 2) == CARRIAGE_RETURN
+        ) {
+            end -= 2;
+        } else {
+            do {
+                --end;
+            } while (end > this->position_start && (*end & 0b11000000) == 0b10000000);
+        }
+    }
+    // Line breaks are LF, CR LF or a lone CR, and positions count characters (not bytes).
+    std::size_t line_number = this->line_number;
+    std::size_t line_pos = this->line_pos;
+    for (const char* pos = this->position_start; pos < end; ++pos) {
+        if (*pos == LINE_FEED || (*pos == CARRIAGE_RETURN && (pos + 1 == end || *(pos + 1) != LINE_FEED))) {
+            line_number++;
+            line_pos = 1;
+        } else if ((*pos & 0b11000000) != 0b10000000) {
+            line_pos++;
+        }
+    }
+    return {line_number, line_pos};
+}
+
 XmlError Parser::get_error_object(const std::string& message) {
     std::string error_message = "";
     std::size_t line_number, line_pos;
     if (this->resource_paths.empty()) {
         error_message += "Error in document at around line ";
-        line_number = this->line_number;
-        line_pos = this->line_pos;
+        std::tie(line_number, line_pos) = this->get_position();
     } else {
         const std::filesystem::path& resource = this->resource_paths.top();
         error_message += "Error in file " + resource.string() + " at around line ";
-        line_number = this->resource_to_stream.at(resource)->parser->line_number;
-        line_pos = this->resource_to_stream.at(resource)->parser->line_pos;
+        std::tie(line_number, line_pos) = this->resource_to_stream.at(resource)->parser->get_position();
     }
     error_message += std::to_string(line_number) + ", char ";
     error_message += std::to_string(line_pos) + ": ";
@@ -1951,4 +3068,13 @@ XmlError Parser::get_error_object(const std::string& message) {
     return XmlError(error_message);
 }
 
+// Generic specialisations also used by the reader.
+template Tag Parser::parse_tag<GenericPolicy>(const DoctypeDeclaration&);
+template ContentType Parser::parse_content<GenericPolicy>(const DoctypeDeclaration&, Element&, String&);
+// Without a DTD, the push parser steps through the content of its buffer.
+template Tag Parser::parse_tag<PlainBufferPolicy>(const DoctypeDeclaration&);
+template ContentType Parser::parse_content<PlainBufferPolicy>(const DoctypeDeclaration&, Element&, String&);
+// Specialisations used for decoding lazily parsed values.
+template String Parser::parse_attribute_value<PlainBufferPolicy>(const DoctypeDeclaration&, bool, bool);
+template void Parser::parse_content_fragment<PlainBufferPolicy>(const DoctypeDeclaration&, Element&);
 }
\ No newline at end of file
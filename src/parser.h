@@ -3,30 +3,154 @@
 #include <filesystem>
 #include <functional>
 #include <istream>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <utility>
-#include <variant>
 #include <vector>
+#include "dtd.h"
+#include "filter.h"
+#include "handler.h"
+#include "resource.h"
+#include "scan.h"
 #include "utils.h"
 
 
 namespace xml {
-// Pointer to a existing input stream.
-typedef std::unique_ptr<std::istream> unique_istream_ptr;
 
 class Parser;
+class CompactDocument;
+class DtdIndex;
+class Reader;
+class Validator;
+
+// Types of items that can occur in the content of an element (or the content rejected,
+// with the error recorded by the parser rather than thrown).
+enum class ContentType {character_data, comment, cdata, processing_instruction, tag, rejected};
+
+// Where the input of a parser comes from, if known at compile time.
+enum class InputSource {any, buffer, stream};
+
+// Features of the input known at compile time, selecting a specialisation of the core
+// parsing loop (element content, tags, names, attribute values) with impossible cases compiled out.
+template <InputSource Source, bool Dtd, bool Decode = true>
+struct ParsePolicy {
+    static constexpr InputSource source = Source; // Input source (any - checked at runtime).
+    // Document may have a DTD (entities, attribute defaults etc.). Otherwise, only character
+    // references and built-in entities are possible, which never enter the entity stacks.
+    static constexpr bool dtd = Dtd;
+    // Character data and attribute values are decoded. Otherwise, they are only checked for
+    // well-formedness and reported to the handler as raw input (buffer input only).
+    static constexpr bool decode = Decode;
+};
+// Anything possible - checked at runtime (outside the root element, and with a DTD).
+typedef ParsePolicy<InputSource::any, true> GenericPolicy;
+// Contiguous buffer with no DTD - by far the most common case.
+typedef ParsePolicy<InputSource::buffer, false> PlainBufferPolicy;
+// Stream with no DTD.
+typedef ParsePolicy<InputSource::stream, false> PlainStreamPolicy;
+// Contiguous buffer with no DTD, with decoding left until values are accessed.
+typedef ParsePolicy<InputSource::buffer, false, false> LazyBufferPolicy;
+
+// Limits on the resources parsing a document may use, so that hostile input (e.g. deeply
+// nested elements, entities expanding exponentially, huge content models) fails quickly rather
+// than exhausting memory, stack or time. Exceeding a limit is an error. Nesting depth, entity
+// expansion and content model size are limited by default, since a small document can otherwise
+// overflow the stack, or take time and memory out of all proportion to its size.
+struct ParseLimits {
+    // Maximum element nesting depth (root element at depth 1). Elements are parsed recursively,
+    // so raising it much further risks overflowing the stack (up to 1 KiB or so per level).
+    std::size_t max_depth = 1 << 12;
+    // Maximum total bytes of entity replacement text expanded, across all references (64 MiB
+    // by default - raise it, or use NO_LIMIT, for trusted documents needing more).
+    std::size_t max_entity_expansion = 1 << 26;
+    std::size_t max_attributes = NO_LIMIT; // Maximum attributes specified in a single tag.
+    std::size_t max_document_size = NO_LIMIT; // Maximum bytes of input (excluding external files).
+    // Maximum references to external resources (external entities and DTD subsets).
+    std::size_t max_external_resources = NO_LIMIT;
+    // Maximum element names in a single element content model (whether or not elements are
+    // validated), each a state of its compiled automaton, which has a transition for every
+    // state and distinct name in the model.
+    std::size_t max_content_model_size = 1024;
+};
+
+// Statistics on parsing a document (collected if requested, see ParseOptions).
+struct ParseStats {
+    std::size_t bytes = 0; // Bytes of input read (excluding external files).
+    std::size_t elements = 0; // Number of elements parsed (whether or not kept in the document).
+    std::size_t attributes = 0; // Number of attributes (including defaults from the DTD).
+    std::size_t entity_references = 0; // Number of general and parameter entity references expanded.
+    std::size_t entity_expansion = 0; // Total bytes of entity replacement text expanded.
+    std::size_t external_resources = 0; // Number of references to external resources.
+    std::size_t max_depth = 0; // Deepest element nesting reached (root element at depth 1).
+    std::size_t allocations = 0; // Allocations for the document (its elements, text, tags and attributes).
+    double dtd_seconds = 0; // Time spent parsing the DOCTYPE declaration (external subset included).
+    // Time spent parsing the root element and anything after it (streaming validation included).
+    double content_seconds = 0;
+    double validation_seconds = 0; // Time spent validating the document once parsed.
+};
+
+// Options controlling how a document is parsed.
+struct ParseOptions {
+    bool validate_elements = true; // Validate elements against the DTD (if any).
+    bool validate_attributes = true; // Validate attributes against the DTD (if any).
+    // Only check well-formedness (for trusted documents), whatever the other validation options.
+    // The DTD (if any) is still parsed for entities and attribute defaults, but never validated.
+    bool well_formed_only = false;
+    // If set, all elements of the document (and their text, tags, attributes, PIs) are
+    // allocated from this memory resource, which the document keeps alive. With a
+    // std::pmr::monotonic_buffer_resource, the whole tree is released in one go.
+    std::shared_ptr<std::pmr::memory_resource> arena = nullptr;
+    // Validate each element as it is parsed (failing at the first invalid element, with its
+    // position) rather than once the whole document is built.
+    bool streaming_validation = false;
+    // If set, used instead of parsing the external DTD subset referenced by the document.
+    std::shared_ptr<const CompiledDtd> external_dtd = nullptr;
+    // If set, external DTD subsets are taken from this cache by system ID instead of parsed
+    // (compiled and cached on first use).
+    std::shared_ptr<DtdCache> dtd_cache = nullptr;
+    // If set, external entities and DTD subsets are loaded through this cache, so can be
+    // reused across documents. Otherwise, they are only reused within the document.
+    std::shared_ptr<ResourceCache> resource_cache = nullptr;
+    // Number of threads parsing the children of the root element in parallel (0 for all
+    // hardware threads, 1 for serial parsing). Only for contiguous input with no arena,
+    // no streaming validation and, if there is a DTD, no markup in entity replacement text.
+    unsigned threads = 1;
+    // Minimum number of bytes of root element content parsed by each thread in parallel parsing.
+    std::size_t parallel_chunk_size = 1 << 20;
+    // If not empty, only the elements matching these absolute paths (e.g. /feed/entry/id,
+    // with * matching any element) are kept in the document, along with the tags of their
+    // ancestors. Everything else is still checked for well-formedness, but then discarded
+    // (each discarded element's tag name and attribute map are still allocated while parsing it).
+    // With a DTD, the whole document is validated as it is parsed (as streaming validation),
+    // unless only checking well-formedness.
+    std::vector<std::string> paths;
+    ParseLimits limits; // Limits on the resources used (see ParseLimits for the defaults).
+    // If set, filled in with statistics once the document is parsed (one document at a time).
+    // Collecting them allocates the document through a counting wrapper (see Document::arena).
+    ParseStats* stats = nullptr;
+};
+
+// Outcome of parsing a document without throwing - the document, or the error if parsing failed.
+struct ParseResult {
+    Document document; // Parsed document (empty if an error occurred).
+    bool success = false; // Indicates the document was parsed successfully.
+    std::string error; // Error message if parsing failed.
+};
 
 // General/parameter entity stream (may be internal or from a file - external).
 struct EntityStream {
-    String text; // Entity text (internal only).
+    const String* text = nullptr; // Entity text (internal only, owned by the DTD - not copied).
     String name; // Entity name
     std::unique_ptr<Parser> parser = nullptr; // Pointer to wrapped parser (external only).
-    unique_istream_ptr stream = nullptr; // Pointer to file stream (external only).
+    std::shared_ptr<const ExternalResource> resource = nullptr; // Loaded file (external only).
     std::filesystem::path file_path; // File path (external only).
-    std::size_t pos; // Position in string (internal only).
+    std::size_t pos; // Byte position in string (internal only).
     String version; // XML Version (external only).
     String encoding; // Encoding (external only).
     bool is_external; // Is external entity?
@@ -37,10 +161,12 @@ struct EntityStream {
     bool leading_parameter_space_done = false; 
      // PE only. All PE text starts with space if not in entity.
     bool trailing_parameter_space_done = false;
-    // Internal entity constructor.
+    // Internal entity constructor (the entity text must outlive the stream).
     EntityStream(const String&, const String&);
-    // External entity constructor.
-    EntityStream(const std::filesystem::path&, const String&);
+    // External entity constructor (from the file loaded from the given path).
+    EntityStream(const std::filesystem::path&, std::shared_ptr<const ExternalResource>, const String&);
+    // Loads an external entity file, parsing its text declaration if present.
+    static std::shared_ptr<const ExternalResource> load(const std::filesystem::path&);
     // Returns current character in entity stream.
     Char get();
     // Increments the entity stream to the next character.
@@ -58,20 +184,37 @@ struct EntityStream {
 class Parser {
     // Don't repeat code - use parser get/++/eof for external entity parsing.
     friend class EntityStream;
-    // Note, unique (dynamic) pointer for strings and normal pointers for input streams. 
-    std::variant<unique_istream_ptr, std::istream*> stream;
-    // Stream that can wrap a string and access it without copying.
-    std::unique_ptr<StringBuffer> string_buffer = nullptr;
+    // Pull parser built on top of the same tokenizer.
+    friend class Reader;
+    // Push parser stepping through the content of the data fed so far.
+    friend class PushParser;
+    // Lazy compact documents are parsed raw, and decoded by the parser on access.
+    friend class CompactDocument;
+    friend class CompactDocumentBuilder;
+    friend CompactDocument parse_compact(std::string_view, bool, bool);
+    // Input stream (only if not parsing a contiguous buffer).
+    std::istream* stream = nullptr;
+    // Contiguous input (strings/buffers) is read directly from memory, avoiding
+    // the per-character overhead of streams. The data is not owned by the parser.
+    bool buffer_input = false; // Input is a contiguous buffer rather than a stream?
+    const char* buffer_begin = nullptr; // Start of the buffer.
+    const char* buffer_pos = nullptr; // Current position in the buffer.
+    const char* buffer_end = nullptr; // End of the buffer (one past the last byte).
+    // End of the part of the buffer validated as UTF-8 so far - characters before it are decoded
+    // without checks. Validated a chunk at a time ahead of parsing.
+    const char* buffer_validated_end = nullptr;
     // Value of previously parsed character.
     Char previous_char = -1;
     // Stack to track general entities.
     // Mainly because recursive general entity references possible.
-    std::stack<EntityStream> general_entity_stack;
+    // The entity stacks are lists, so nothing is allocated until an entity is actually
+    // referenced, and streams stay in place (referenced by resource path).
+    std::stack<EntityStream, std::list<EntityStream>> general_entity_stack;
     // Stack to track parameter entities.
     // Mainly because recursive parameter entity references possible.
-    std::stack<EntityStream> parameter_entity_stack;
+    std::stack<EntityStream, std::list<EntityStream>> parameter_entity_stack;
     // Track file paths of all resources (external files).
-    std::stack<std::filesystem::path> resource_paths;
+    std::stack<std::filesystem::path, std::vector<std::filesystem::path>> resource_paths;
     // Maps each resource path to its corresponding stream object.
     std::map<std::filesystem::path, EntityStream*> resource_to_stream;
     // Track seen general entity names to detect self references (avoid infinite recursion).
@@ -80,22 +223,82 @@ class Parser {
     std::set<String> parameter_entity_names;
     bool general_entity_active = false; // Currently inside general entity?
     bool just_parsed_character_reference = false; // Last returned character was character reference?
+    // Set if the last general entity reference was to a pre-expanded entity, whose text
+    // is then to be taken in bulk by the caller (the reference itself returned as '&').
+    const GeneralEntityExpansion* expanded_general_entity = nullptr;
     bool parameter_entity_active = false; // Currently inside parameter entity?
-    bool just_parsed_carriage_return = false; // Last returned character was carriage return?
     bool external_dtd_content_active = false; // Currently inside external DTD?
     bool standalone = false; // Document is standalone (avoid passing around document object like crazy).
-    std::size_t line_number = 1; // Current line number based on stream position (start from 1).
-    std::size_t line_pos = 1; // Position on current line based on stream position (start from 1).
+    bool well_formed_only = false; // Only checking well-formedness (no validation of DTD or document)?
+    Handler* handler = nullptr; // If set, receives parse events instead of a document being built.
+    // Character data and attribute values passed to the handler raw if there is no DTD (buffer only).
+    bool lazy = false;
+    bool raw_text_seen = false; // Character data seen since the last flush (if not decoding).
+    const char* raw_text_end = nullptr; // Start of the markup ending the character data (if not decoding).
+    // Names, attribute values and character data are only viewed in the input, without building any
+    // strings (lazy only) - the handler is passed empty ones, and uses the views below instead.
+    bool views = false;
+    // Views into the input of the name and attributes (name, raw value, in name order) of the last
+    // start or empty tag, and of the raw character data last passed to the handler (views only).
+    std::string_view raw_tag_name;
+    std::vector<std::pair<std::string_view, std::string_view>> raw_attributes;
+    std::string_view raw_text;
+    // Views into the input of the last name and raw attribute value parsed (views only).
+    std::string_view raw_name;
+    std::string_view raw_value;
+    Validator* validator = nullptr; // If set, validates elements as they are parsed.
+    const PathFilter* path_filter = nullptr; // If set, only elements matching its paths are kept.
+    // Validator and path filter set up for the document being parsed, if any (see parse_document).
+    std::shared_ptr<Validator> owned_validator = nullptr;
+    std::unique_ptr<PathFilter> owned_path_filter = nullptr;
+    // Counts the allocations for the document being parsed (only if collecting statistics).
+    std::shared_ptr<std::pmr::memory_resource> counting_resource = nullptr;
+    std::vector<PathFilter::States> path_states; // States of each open partially matched element.
+    PathMatch path_match = PathMatch::full; // How much of the element being parsed is kept.
+    PathMatch last_element_match = PathMatch::full; // How much of the last element parsed is kept.
+    // Declarations of the DTD by element name, built once the DTD is complete (on first use).
+    std::shared_ptr<const DtdIndex> dtd_index = nullptr;
+    std::shared_ptr<const CompiledDtd> external_dtd = nullptr; // Compiled external subset to use.
+    std::shared_ptr<DtdCache> dtd_cache = nullptr; // Compiled external subsets by system ID.
+    std::shared_ptr<ResourceCache> resource_cache = nullptr; // Loaded external files (on demand).
+    // Memory resource for document elements (the arena if one is in use).
+    std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource();
+    // Current line number and position on the line (start from 1), tracked as a stream is read.
+    // For buffer input, nothing is tracked whilst parsing - these are the line number and position
+    // at the position start instead, from which the current ones are worked out when needed.
+    std::size_t line_number = 1;
+    std::size_t line_pos = 1;
+    ParseLimits limits; // Limits on the resources used.
+    std::size_t depth = 0; // Number of elements currently open.
+    // Resources used so far (checked against the limits), with times only tracked if requested.
+    // For buffer input, bytes are counted up front, and as they are read for stream input.
+    ParseStats usage;
+    ParseStats* stats = nullptr; // Statistics to fill in once the document is parsed (if requested).
+    const char* position_start = nullptr; // Point in the buffer the line number and position are for.
+    // Error (with position) the document was rejected with in element content - the common errors
+    // there (invalid character, end tag mismatch, end of data) are returned up the element
+    // recursion rather than thrown. Empty if none.
+    std::string rejection;
+    // Parsing the document returns once rejected, leaving the error in rejection (otherwise thrown).
+    bool rejection_returned = false;
 
     // Parse a Name, with optional validation (default active), parameter entities
     // and a set of names that are exempt to validation requirements.
+    template <typename Policy = GenericPolicy>
     String parse_name(
         const String&, bool validate = true, const ParameterEntities* parameter_entities = nullptr,
         const std::set<String>* validation_exeptions = nullptr);
+    // Parse a Name straight from the input buffer, returning a view of it rather than building it
+    // (views only), with the same checks as parse_name.
+    template <typename Policy>
+    std::string_view view_name(const String&, const std::set<String>* validation_exeptions = nullptr);
+    // Puts the raw attributes of the tag just parsed in name order, checking for duplicates (views only).
+    void sort_raw_attributes();
     // Parse a Nmtoken.
     String parse_nmtoken(const String&, const ParameterEntities&);
     // Parse an attribute value, where references may or may not be recognised, 
     // including normalisation that varies by attribute type (CDATA or not).
+    template <typename Policy = GenericPolicy>
     String parse_attribute_value(
         const DoctypeDeclaration&, bool references_active = true, bool is_cdata = true);
     // Parse an entity value in an entity declaration.
@@ -104,24 +307,38 @@ class Parser {
     Char parse_character_reference();
     // Parse the name of a general entity.
     String parse_general_entity_name(const GeneralEntities&);
-    // Parse each general entity character, applying a given function on each character.
-    String parse_general_entity_text(const GeneralEntities&, std::function<void(Char)>, int);
+    // Parse each general entity character, applying a given function on each character
+    // (and another on the text of any pre-expanded entities referenced).
+    String parse_general_entity_text(
+        const GeneralEntities&, std::function<void(Char)>, std::function<void(const String&)>, int);
+    // Adds to the total bytes of entity replacement text expanded, checking the limit.
+    void add_entity_expansion(std::size_t);
+    // Counts an element (start or empty tag just parsed), checking the depth limit.
+    void count_element(const Tag&);
     // Parse the occurrence of a general entity.
     void parse_general_entity(const GeneralEntities&, bool);
     // Retrieves the folder of the current entity, blank if in the main document.
     std::filesystem::path get_folder_path();
     // Retrieves the file of the current entity, blank if in the main document.
     std::filesystem::path get_file_path();
+    // Returns the loaded external file at the given path (loading it on first reference),
+    // counting it towards the limit on external resources.
+    std::shared_ptr<const ExternalResource> get_resource(const std::filesystem::path&);
+    // Returns the index of the (complete) DTD, building it if not yet built.
+    const DtdIndex& get_dtd_index(const DoctypeDeclaration&);
     // Confirms the end of a general entity and resets relevant variables.
     void end_general_entity();
     // Parse the occurrence of a parameter entity.
     void parse_parameter_entity(const ParameterEntities&, bool);
     void end_parameter_entity();
-    // Parse an attribute {name, value} pair.
+    // Parse an attribute {name, value} pair. In a tag, the attribute list declaration
+    // of the element (if any) is also given, determining whether the value is CDATA.
+    template <typename Policy = GenericPolicy>
     std::pair<String, String> parse_attribute(
-        const DoctypeDeclaration&, bool references_active = true,
-        bool is_cdata = true, const String* tag_name = nullptr);
+        const DoctypeDeclaration&, bool references_active = true, bool is_cdata = true,
+        const String* tag_name = nullptr, const AttributeListDeclaration* = nullptr);
     // Parse a start, end or empty tag.
+    template <typename Policy = GenericPolicy>
     Tag parse_tag(const DoctypeDeclaration&);
     // Ignores a comment (stripped away).
     void parse_comment();
@@ -143,6 +360,9 @@ class Parser {
     void parse_dtd_subsets(DoctypeDeclaration&, bool = false, bool = false);
     // Set up parsing the external DTD subset.
     void start_external_subset(const std::filesystem::path&);
+    // Adds the declarations of the compiled external subset (if available and usable)
+    // instead of parsing the external subset. Returns true if done.
+    bool merge_compiled_dtd(DoctypeDeclaration&);
     // Detects the markup declaration type and calls the corresponding parse method.
     void parse_markup_declaration(DoctypeDeclaration&);
     // Detect conditional section type and calls the correponding parse method.
@@ -159,8 +379,8 @@ class Parser {
     MixedContentModel parse_mixed_content_model(const ParameterEntities&, int);
     // Parse an attribute list declaration <!ATTLIST ...>
     void parse_attribute_list_declaration(DoctypeDeclaration&);
-    // Parse an attribute declaration: name, type, (presence), (default).
-    void parse_attribute_declaration(DoctypeDeclaration&, AttributeListDeclaration&);
+    // Parse an attribute declaration: name, type, (presence), (default), given the element name.
+    void parse_attribute_declaration(DoctypeDeclaration&, AttributeListDeclaration&, const String&);
     // DRY method for parsing list of notation names / enumeration values within attribute declaration.
     std::set<String> parse_enumerated_attribute(AttributeType, const ParameterEntities&);
     // Parse notation names for NOTATION attribute.
@@ -176,8 +396,10 @@ class Parser {
     // Parse a notation declaration <!NOTATION ...>.
     void parse_notation_declaration(DoctypeDeclaration&);
     // Gets the current character without detecting references of any kind.
+    template <typename Policy = GenericPolicy>
     Char get();
     // Gets the current character whilst possibly detecting character or general entity references.
+    template <typename Policy = GenericPolicy>
     Char get(const GeneralEntities&, bool in_attribute_value = false);
     // Gets the current character whilst possibly detecting parameter entity references.
     Char get(
@@ -185,18 +407,76 @@ class Parser {
         bool ignore_whitespace_after_percent_sign = false);
     // Increments the parser to process the next character.
     void operator++();
+    // Increments the parser to process the next character (specialised for the input).
+    template <typename Policy>
+    void advance();
     // Returns true if the end of the stream of the parser has been reached.
     bool eof();
     // Returns true if exactly one general entity is active and it is at its EOF.
     bool general_entity_eof();
     // Returns true if exactly one parameter entity is active and it is at its EOF.
     bool parameter_entity_eof();
+    // Decodes the next character of the buffer, validating further ahead of parsing as needed.
+    Char parse_buffer_utf8(const char*&);
+    // Returns true if reading straight from the main input buffer with no character pending,
+    // so that plain runs of characters can be consumed in bulk.
+    template <typename Policy = GenericPolicy>
+    bool plain_run_possible();
+    // Consumes the longest run of plain characters from the input buffer, returning it as
+    // a view into the buffer (empty if bulk consumption is not currently possible).
+    // ASCII bytes are plain if the predicate holds, other characters if allowed and valid.
+    // Given delimiters (only if all other printable ASCII is plain), the run is scanned in blocks.
+    template <typename Policy = GenericPolicy, typename Predicate>
+    std::string_view parse_plain_run(
+        Predicate, bool non_ascii_allowed, const ScanDelimiters* delimiters = nullptr);
+    // Skips printable ASCII up to the next delimiter in bulk (if possible), returning the bytes skipped.
+    std::string_view skip_plain_ascii(const ScanDelimiters&);
     // Skips all whitespace characters.
+    template <typename Policy = GenericPolicy>
     void ignore_whitespace();
     // Skips all whitespace characters with parameter entities in mind.
     void ignore_whitespace(const ParameterEntities&);
+    // Parse the next item of element content, adding any character data to the element text
+    // (character data not yet flushed is kept in the given string). Processing instructions
+    // and tags are only detected (opening markup consumed) - parsing them is left to the caller.
+    // Common errors are recorded in rejection rather than thrown (content then rejected).
+    template <typename Policy = GenericPolicy>
+    ContentType parse_content(const DoctypeDeclaration&, Element&, String&);
     // Parse a given element.
+    template <typename Policy = GenericPolicy>
     Element parse_element(const DoctypeDeclaration&, bool = false);
+    // Parse the content of an element up to and including its end tag (start tag already parsed).
+    // Returns early if the document is rejected (see rejection), as does parse_element.
+    template <typename Policy = GenericPolicy>
+    void parse_element_content(const DoctypeDeclaration&, Element&);
+    // Parse content until the end of the data (a part of the content of an element),
+    // adding the character data, PIs and child elements to the given element.
+    template <typename Policy = GenericPolicy>
+    void parse_content_fragment(const DoctypeDeclaration&, Element&);
+    // Parse the root element (opening '<' consumed) serially, with the policy for the input.
+    Element parse_serial_root_element(const DoctypeDeclaration&);
+    // Parse the root element, with its children split between the given number of threads
+    // (each taking at least the given number of bytes) where they can be found in advance.
+    Element parse_root_element(const DoctypeDeclaration&, unsigned, std::size_t);
+    // Handles an element whose start or empty tag has just been parsed - counting it, validating it
+    // as it starts, matching it against the paths and passing it on to the handler (with its end, if empty).
+    void begin_element(const Tag&);
+    // Handles the end of an element whose content has been parsed, given whether any of its character
+    // data was already passed on - validating its content and passing its end to the handler.
+    void end_element(const Element&, bool);
+    // Sets up parsing a document with the given options, returning the (empty) document to build.
+    Document begin_document(const ParseOptions&);
+    // Sets up validating the content of the document once parsed up to the root element,
+    // returning true if it is validated as it is parsed (streaming validation).
+    bool begin_content(const Document&, const ParseOptions&);
+    // Completes a document once parsed in full (given whether validated as it was parsed) -
+    // validating it otherwise, ending it for the handler and filling in the statistics.
+    void end_document(Document&, const ParseOptions&, bool);
+    // Parse the toplevel of the document outside the root element - either before the root
+    // element (stopping once its start tag is reached) or after it (until the end of the data).
+    void parse_toplevel(Document&, bool root_seen);
+    // Returns the current line number and position on the line (for buffers, from the offset).
+    std::pair<std::size_t, std::size_t> get_position() const;
     // Returns an error object with the current stream position included.
     XmlError get_error_object(const std::string&);
     public:
@@ -204,8 +484,23 @@ class Parser {
         Element parse_element();
         // Start method - document parsing begins here.
         Document parse_document(bool validate_elements = true, bool validate_attributes = true);
+        // Document parsing with the given options.
+        Document parse_document(const ParseOptions&);
+        // Document parsing with the given options, returning the outcome rather than throwing.
+        // The errors most often rejecting documents in element content are returned up the parser
+        // without being thrown at all, whereas the rest are thrown internally and caught here.
+        ParseResult try_parse_document(const ParseOptions& = {});
+        // Streaming document parsing - events are passed to the handler instead of building
+        // a document (no validation, well-formedness only).
+        void parse_document(Handler&);
+        // Parses an external DTD subset on its own (validated, with content models compiled).
+        DoctypeDeclaration parse_external_subset(const std::filesystem::path&);
         // String constructor.
         Parser(const std::string&);
+        // Contiguous buffer constructor (the data must outlive the parser).
+        Parser(std::string_view);
+        // Null-terminated string constructor (the data must outlive the parser).
+        Parser(const char*);
         // Stream constructor.
         Parser(std::istream&);
 };
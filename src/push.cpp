@@ -0,0 +1,389 @@
+#include "push.h"
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+
+namespace xml {
+
+// Data already parsed is only discarded once there is at least this much of it
+// (and it is at least half the data), so the rest is moved rarely.
+constexpr std::size_t MIN_DISCARD_SIZE = 1 << 16;
+
+PushParser::PushParser(Handler& handler) : parser(std::string_view(this->data)) {
+    this->handler = &handler;
+    this->parser.handler = &handler;
+    this->document = this->parser.begin_document(this->options);
+}
+
+PushParser::PushParser(const ParseOptions& options)
+    : options(options), parser(std::string_view(this->data)) {
+    this->document = this->parser.begin_document(this->options);
+}
+
+void PushParser::feed(const char* chunk, std::size_t size) {
+    if (this->finished) {
+        throw std::logic_error("Push parser input already finished");
+    }
+    this->run([&] {
+        this->parser.usage.bytes += size;
+        if (this->parser.usage.bytes > this->parser.limits.max_document_size) {
+            throw this->parser.get_error_object("Document size limit exceeded");
+        }
+        this->update_data(0, std::string_view(chunk, size));
+        this->scan();
+        this->set_view(this->complete);
+        this->parse();
+        this->compact();
+    });
+}
+
+void PushParser::feed(std::string_view data) {
+    this->feed(data.data(), data.size());
+}
+
+void PushParser::finish() {
+    if (this->finished) {
+        throw std::logic_error("Push parser input already finished");
+    }
+    this->finished = true;
+    this->run([this] {
+        // Whatever follows the last complete markup is now parsed too (incomplete or not).
+        this->set_view(this->data.size());
+        this->parse();
+    });
+}
+
+Document& PushParser::get_document() {
+    return this->document;
+}
+
+template <typename Function>
+void PushParser::run(Function step) {
+    if (this->error != nullptr) {
+        std::rethrow_exception(this->error);
+    }
+    try {
+        step();
+    } catch (...) {
+        this->error = std::current_exception();
+        throw;
+    }
+}
+
+void PushParser::update_data(std::size_t discarded, std::string_view chunk) {
+    // The parser points into the data, which may move - keep the offsets instead.
+    Parser& parser = this->parser;
+    std::size_t pos = parser.buffer_pos - parser.buffer_begin;
+    std::size_t end = parser.buffer_end - parser.buffer_begin;
+    std::size_t validated_end = std::max(parser.buffer_validated_end, parser.buffer_pos) - parser.buffer_begin;
+    std::size_t position_start = parser.position_start - parser.buffer_begin;
+    this->data.erase(0, discarded);
+    this->data.append(chunk);
+    parser.buffer_begin = this->data.data();
+    parser.buffer_pos = parser.buffer_begin + (pos - discarded);
+    parser.buffer_end = parser.buffer_begin + (end - discarded);
+    parser.buffer_validated_end = parser.buffer_begin + (validated_end - discarded);
+    parser.position_start = parser.buffer_begin + (position_start - discarded);
+    this->scanned -= discarded;
+    this->complete -= discarded;
+    this->markup_start -= std::min(this->markup_start, discarded);
+}
+
+void PushParser::set_view(std::size_t end) {
+    this->parser.buffer_end = this->parser.buffer_begin + end;
+}
+
+void PushParser::compact() {
+    Parser& parser = this->parser;
+    std::size_t parsed = parser.buffer_pos - parser.buffer_begin;
+    if (
+        parser.previous_char != -1 || parsed < MIN_DISCARD_SIZE || parsed < this->data.size() / 2
+    ) {
+        return;
+    }
+    // Positions for errors are then counted on from the first byte kept.
+    std::tie(parser.line_number, parser.line_pos) = parser.get_position();
+    parser.position_start = parser.buffer_pos;
+    this->update_data(parsed, {});
+}
+
+void PushParser::scan() {
+    // Only the markup boundaries matter here - anything malformed is left for the parser to
+    // report, once it is given the data (at the latest, when the input is finished).
+    const std::string& data = this->data;
+    std::size_t& pos = this->scanned;
+    // Looks for the given terminator of the markup, completing it if found.
+    auto find_end = [&](std::string_view terminator) {
+        std::size_t end = data.find(terminator, pos);
+        if (end == std::string::npos) {
+            // The terminator may yet be split across chunks.
+            pos = std::max(pos, data.size() - std::min(data.size(), terminator.size() - 1));
+            return false;
+        }
+        pos = end + terminator.size();
+        return true;
+    };
+    while (pos < data.size()) {
+        char c = data[pos];
+        switch (this->markup) {
+            case Markup::none:
+                // Character data up to the next markup.
+                pos = data.find('<', pos);
+                if (pos == std::string::npos) {
+                    pos = data.size();
+                    return;
+                }
+                this->markup_start = pos++;
+                this->markup = Markup::open;
+                continue;
+            case Markup::open:
+                if (c == '?') {
+                    this->markup = Markup::processing_instruction;
+                    ++pos;
+                } else if (c == '!') {
+                    this->markup = Markup::declaration;
+                    ++pos;
+                } else {
+                    this->markup = Markup::tag;
+                }
+                continue;
+            case Markup::declaration:
+                // <!-- or <![CDATA[ - anything else must be the DOCTYPE declaration.
+                if (c == '-') {
+                    this->markup = Markup::comment;
+                    pos = this->markup_start + 4;
+                } else if (c == '[') {
+                    this->markup = Markup::cdata;
+                    pos = this->markup_start + 9;
+                } else {
+                    this->markup = Markup::doctype;
+                }
+                continue;
+            case Markup::processing_instruction:
+                if (!find_end("?>")) {
+                    return;
+                }
+                break;
+            case Markup::comment:
+                if (!find_end("-->")) {
+                    return;
+                }
+                break;
+            case Markup::cdata:
+                if (!find_end("]]>")) {
+                    return;
+                }
+                break;
+            case Markup::tag:
+                ++pos;
+                if (this->quote != 0) {
+                    this->quote = c == this->quote ? 0 : this->quote;
+                    continue;
+                }
+                if (c == '"' || c == '\'') {
+                    this->quote = c;
+                    continue;
+                }
+                if (c != '>') {
+                    continue;
+                }
+                this->tag_seen = true;
+                break;
+            case Markup::doctype:
+                if (this->subset_markup != Markup::none) {
+                    // Comment or PI in the internal subset (quotes in it are not literals).
+                    if (!find_end(this->subset_markup == Markup::comment ? "-->" : "?>")) {
+                        return;
+                    }
+                    this->subset_markup = Markup::none;
+                    continue;
+                }
+                if (this->quote != 0) {
+                    this->quote = c == this->quote ? 0 : this->quote;
+                } else if (c == '"' || c == '\'') {
+                    this->quote = c;
+                } else if (this->in_internal_subset && c == '<') {
+                    if (pos + 1 == data.size() || (data[pos + 1] == '!' && pos + 4 > data.size())) {
+                        // Not yet known whether a comment or PI.
+                        return;
+                    }
+                    if (data[pos + 1] == '?') {
+                        this->subset_markup = Markup::processing_instruction;
+                        pos += 2;
+                        continue;
+                    }
+                    if (data.compare(pos, 4, "<!--") == 0) {
+                        this->subset_markup = Markup::comment;
+                        pos += 4;
+                        continue;
+                    }
+                } else if (this->in_internal_subset) {
+                    this->in_internal_subset = c != ']';
+                } else if (c == '[') {
+                    this->in_internal_subset = true;
+                } else if (c == '>') {
+                    ++pos;
+                    break;
+                }
+                ++pos;
+                continue;
+            default:
+                break;
+        }
+        // Markup complete.
+        this->markup = Markup::none;
+        this->complete = pos;
+    }
+}
+
+void PushParser::parse() {
+    const DoctypeDeclaration& dtd = this->document.doctype_declaration;
+    if (this->stage == Stage::prolog) {
+        // Everything before the root element is parsed together, once its start tag is complete.
+        if (!this->tag_seen && !this->finished) {
+            return;
+        }
+        this->parser.parse_toplevel(this->document, false);
+        this->streaming_validation = this->parser.begin_content(this->document, this->options);
+        this->stage = Stage::content;
+        // Without a DTD, the core loop is specialised for the buffer (no entities possible).
+        if (dtd.exists) {
+            this->start_element(this->parser.parse_tag<GenericPolicy>(dtd));
+        } else {
+            this->start_element(this->parser.parse_tag<PlainBufferPolicy>(dtd));
+        }
+    }
+    if (this->stage == Stage::content) {
+        if (dtd.exists) {
+            this->parse_content<GenericPolicy>();
+        } else {
+            this->parse_content<PlainBufferPolicy>();
+        }
+        if (!this->open_elements.empty()) {
+            return;
+        }
+        this->parser.validator = nullptr;
+        this->parser.path_filter = nullptr;
+        this->parser.path_match = PathMatch::full;
+        this->stage = Stage::epilog;
+    }
+    if (this->stage == Stage::epilog) {
+        this->parser.parse_toplevel(this->document, true);
+        if (this->finished) {
+            this->parser.end_document(this->document, this->options, this->streaming_validation);
+            this->stage = Stage::done;
+        }
+    }
+}
+
+template <typename Policy>
+void PushParser::parse_content() {
+    // As Parser::parse_element_content, but with the open elements kept here between chunks.
+    const DoctypeDeclaration& dtd = this->document.doctype_declaration;
+    Parser& parser = this->parser;
+    while (!this->open_elements.empty()) {
+        if (
+            !this->finished && parser.buffer_pos == parser.buffer_end && parser.previous_char == -1
+            && (!Policy::dtd || parser.general_entity_stack.empty())
+        ) {
+            // End of the complete markup - suspended until more data is fed.
+            return;
+        }
+        OpenElement& open = this->open_elements.back();
+        Element& element = open.element;
+        ContentType content_type = parser.parse_content<Policy>(dtd, element, open.char_data);
+        if (content_type == ContentType::rejected) {
+            throw XmlError(parser.rejection);
+        }
+        if (content_type != ContentType::processing_instruction && content_type != ContentType::tag) {
+            continue;
+        }
+        if ((this->handler != nullptr || !open.content_kept) && !element.text.empty()) {
+            // Streaming - pass on character data so far rather than retaining it.
+            if (this->handler != nullptr) {
+                this->handler->characters(element.text);
+            }
+            element.text.clear();
+            open.text_flushed = true;
+        }
+        if (content_type == ContentType::processing_instruction) {
+            if (this->handler != nullptr) {
+                this->handler->processing_instruction(parser.parse_processing_instruction());
+            } else if (open.content_kept) {
+                element.processing_instructions.push_back(parser.parse_processing_instruction());
+            } else {
+                parser.parse_processing_instruction();
+            }
+            continue;
+        }
+        Tag tag = parser.parse_tag<Policy>(dtd);
+        if (tag.type != TagType::end) {
+            this->start_element(std::move(tag));
+            continue;
+        }
+        if (tag.name != element.tag.name) {
+            throw parser.get_error_object("End tag name must match start tag name");
+        }
+        this->end_element();
+    }
+}
+
+void PushParser::start_element(Tag&& tag) {
+    Parser& parser = this->parser;
+    Element element(Element::allocator_type(parser.memory_resource));
+    element.tag = std::move(tag);
+    if (element.tag.type == TagType::end) {
+        throw parser.get_error_object("Not expecting end tag");
+    }
+    PathMatch parent_match = parser.path_match;
+    parser.begin_element(element.tag);
+    if (element.tag.type == TagType::empty) {
+        this->add_element(std::move(element));
+        return;
+    }
+    PathMatch match = parser.last_element_match;
+    parser.path_match = match;
+    ++parser.depth;
+    this->open_elements.push_back({
+        std::move(element), String(), parser.general_entity_stack.size(),
+        parent_match, match, match == PathMatch::full});
+}
+
+void PushParser::end_element() {
+    Parser& parser = this->parser;
+    OpenElement& open = this->open_elements.back();
+    // General entities not properly closed.
+    if (parser.general_entity_stack.size() != open.general_entity_stack_size) {
+        throw parser.get_error_object("Element must start and end in the same entity replacement text");
+    }
+    parser.end_element(open.element, open.text_flushed);
+    --parser.depth;
+    parser.path_match = open.parent_match;
+    if (open.parent_match == PathMatch::partial) {
+        parser.path_states.pop_back();
+    }
+    parser.last_element_match = open.match;
+    Element element = std::move(open.element);
+    this->open_elements.pop_back();
+    this->add_element(std::move(element));
+}
+
+void PushParser::add_element(Element&& element) {
+    if (this->open_elements.empty()) {
+        this->document.root = std::move(element);
+        return;
+    }
+    Element& parent = this->open_elements.back().element;
+    PathMatch match = this->parser.last_element_match;
+    if (
+        this->handler == nullptr
+        && (match == PathMatch::full || (match == PathMatch::partial && !element.children.empty()))
+    ) {
+        parent.children.push_back(std::move(element));
+    }
+    parent.is_empty = false;
+}
+
+}
@@ -0,0 +1,99 @@
+// Push parsing - documents fed in chunks as they arrive rather than pulled from a stream.
+#pragma once
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "handler.h"
+#include "parser.h"
+#include "utils.h"
+
+
+namespace xml {
+
+// Parses a document fed in chunks of any size as they arrive (e.g. from a socket or pipe),
+// so the whole document never needs to be available up front. Chunks may end anywhere (part way
+// through a tag or UTF-8 sequence): the data fed is buffered, and each chunk is parsed up to the
+// end of the last complete markup in it before returning, with events passed to the handler or
+// the document built progressively. Between chunks, the parser is simply suspended at that
+// markup boundary - no thread is involved, so any number of documents can be in flight at once.
+// Parsing uses the buffer input (as for a string), with data already parsed discarded as it goes.
+class PushParser {
+    // What is being parsed in the document.
+    enum class Stage {prolog, content, epilog, done};
+    // Kind of the markup scanned for in the raw data (to find where the complete markup ends).
+    enum class Markup {none, open, tag, processing_instruction, declaration, comment, cdata, doctype};
+    // An element whose start tag has been parsed but not yet its end tag.
+    struct OpenElement {
+        Element element; // Element built so far.
+        String char_data; // Character data not yet flushed to the element text.
+        std::size_t general_entity_stack_size; // Number of general entities open at the start tag.
+        PathMatch parent_match; // How much of the parent element is kept.
+        PathMatch match; // How much of the element is kept.
+        bool content_kept; // Content (other than elements leading to matches) kept?
+        bool text_flushed = false; // Character data already passed on to the handler (or discarded)?
+    };
+    Handler* handler = nullptr; // If set, receives parse events instead of a document being built.
+    ParseOptions options; // Options for building the document (no handler only).
+    std::string data; // Data fed, from the first byte not yet parsed (or still needed).
+    Parser parser; // Parser over the complete markup in the data.
+    Document document; // Document being built (no handler only).
+    bool streaming_validation = false; // Document validated as it is parsed?
+    Stage stage = Stage::prolog;
+    std::vector<OpenElement> open_elements; // Elements currently open, the root first.
+    // Scanning the raw data for the markup boundaries (offsets into the data).
+    std::size_t scanned = 0; // Offset of the first byte not yet scanned.
+    std::size_t complete = 0; // Offset just past the last complete markup.
+    std::size_t markup_start = 0; // Offset of the '<' starting the markup being scanned.
+    Markup markup = Markup::none; // Kind of the markup being scanned (none if in character data).
+    char quote = 0; // Quote of the literal being scanned in a tag or DOCTYPE declaration (if any).
+    bool in_internal_subset = false; // Scanning the internal subset of a DOCTYPE declaration?
+    Markup subset_markup = Markup::none; // Comment or PI being scanned in the internal subset.
+    bool tag_seen = false; // A complete tag scanned (so the whole prolog is available)?
+    bool finished = false; // No more data to come?
+    std::exception_ptr error = nullptr; // Error the document was rejected with, if any.
+
+    // Scans the data fed since the last scan for the end of the last complete markup.
+    void scan();
+    // Discards the given number of bytes from the start of the data and appends a chunk,
+    // keeping the parser at the same point in it.
+    void update_data(std::size_t, std::string_view);
+    // Lets the parser see the data up to the given offset.
+    void set_view(std::size_t);
+    // Discards the data parsed so far if worthwhile (keeping the position for errors).
+    void compact();
+    // Parses as far as the data in view allows, completing the document once finished.
+    void parse();
+    // Parses the content of the open elements as far as the data in view allows.
+    template <typename Policy>
+    void parse_content();
+    // Handles a start or empty tag just parsed, opening the element if a start tag.
+    void start_element(Tag&&);
+    // Handles the end tag of the innermost open element just parsed, closing it.
+    void end_element();
+    // Adds an element just completed to its parent (or as the root).
+    void add_element(Element&&);
+    // Runs a step of parsing, keeping any error to be thrown again on later calls.
+    template <typename Function>
+    void run(Function);
+    public:
+        // Push parser passing events to the handler (well-formedness only, as in streaming).
+        PushParser(Handler&);
+        // Push parser building a document with the given options (threads are not used).
+        PushParser(const ParseOptions& = {});
+        PushParser(const PushParser&) = delete;
+        PushParser& operator=(const PushParser&) = delete;
+        // Feeds the next chunk of the document, parsing as far as possible before returning
+        // (the data need not outlive the call). XmlError if the document is found to be invalid.
+        void feed(const char*, std::size_t);
+        // Feeds the next chunk of the document.
+        void feed(std::string_view);
+        // Indicates the end of the document, completing parsing.
+        // XmlError if the document is incomplete or invalid.
+        void finish();
+        // Returns the document built (once finished, and only without a handler).
+        Document& get_document();
+};
+
+}
@@ -0,0 +1,155 @@
+#include "reader.h"
+
+
+namespace xml {
+
+Reader::Reader(std::string_view buffer) {
+    this->parser = std::make_unique<Parser>(buffer);
+}
+
+Reader::Reader(std::istream& istream) {
+    this->parser = std::make_unique<Parser>(istream);
+}
+
+Reader::Reader(std::unique_ptr<MappedFile> file) {
+    this->file = std::move(file);
+    this->parser = std::make_unique<Parser>(this->file->view());
+}
+
+NodeType Reader::read_tag() {
+    Tag tag = this->parser->parse_tag(this->document.doctype_declaration);
+    this->name = tag.name;
+    switch (tag.type) {
+        case TagType::start:
+            this->attributes = std::move(tag.attributes);
+            this->depth = this->open_elements.size();
+            this->open_elements.push_back({tag.name, this->parser->general_entity_stack.size()});
+            return NodeType::start_element;
+        case TagType::empty:
+            this->attributes = std::move(tag.attributes);
+            this->depth = this->open_elements.size();
+            this->pending_end = true;
+            return NodeType::start_element;
+        case TagType::end:
+        default:
+            if (this->open_elements.empty()) {
+                throw this->parser->get_error_object("Not expecting end tag");
+            }
+            if (tag.name != this->open_elements.back().name) {
+                throw this->parser->get_error_object("End tag name must match start tag name");
+            }
+            // General entities not properly closed.
+            if (this->parser->general_entity_stack.size() != this->open_elements.back().general_entity_depth) {
+                throw this->parser->get_error_object(
+                    "Element must start and end in the same entity replacement text");
+            }
+            this->attributes.clear();
+            this->open_elements.pop_back();
+            this->depth = this->open_elements.size();
+            return NodeType::end_element;
+    }
+}
+
+NodeType Reader::next() {
+    switch (this->type) {
+        case NodeType::end_document:
+            return NodeType::end_document;
+        case NodeType::none:
+            // Toplevel before the root element, stopping at the root start tag.
+            this->parser->parse_toplevel(this->document, false);
+            this->type = this->read_tag();
+            return this->type;
+        default:
+            break;
+    }
+    if (this->pending_end) {
+        // End of empty element (same name and depth as its start).
+        this->pending_end = false;
+        this->attributes.clear();
+        this->type = NodeType::end_element;
+        return this->type;
+    }
+    if (this->open_elements.empty()) {
+        // Root element closed - remainder of the document must be toplevel only.
+        this->parser->parse_toplevel(this->document, true);
+        this->name.clear();
+        this->depth = 0;
+        this->type = NodeType::end_document;
+        return this->type;
+    }
+    this->depth = this->open_elements.size();
+    ContentType content_type = this->pending_markup;
+    this->pending_markup = ContentType::character_data;
+    while (content_type != ContentType::processing_instruction && content_type != ContentType::tag) {
+        content_type = this->parser->parse_content(
+            this->document.doctype_declaration, this->content, this->char_data);
+        if (content_type == ContentType::rejected) {
+            throw XmlError(this->parser->rejection);
+        }
+        if (
+            (content_type == ContentType::processing_instruction || content_type == ContentType::tag)
+            && !this->content.text.empty()
+        ) {
+            // Report the text first, parsing the detected markup on the next call.
+            this->pending_markup = content_type;
+            this->text = std::move(this->content.text);
+            this->content.text.clear();
+            this->type = NodeType::text;
+            return this->type;
+        }
+    }
+    if (content_type == ContentType::processing_instruction) {
+        this->processing_instruction = this->parser->parse_processing_instruction();
+        this->type = NodeType::processing_instruction;
+        return this->type;
+    }
+    this->type = this->read_tag();
+    return this->type;
+}
+
+void Reader::skip_subtree() {
+    if (this->type != NodeType::start_element) {
+        return;
+    }
+    if (this->pending_end) {
+        // Empty element - nothing in between.
+        this->next();
+        return;
+    }
+    std::size_t start_depth = this->depth;
+    while (this->next() != NodeType::end_element || this->depth != start_depth);
+}
+
+NodeType Reader::get_type() const {
+    return this->type;
+}
+
+const String& Reader::get_name() const {
+    return this->name;
+}
+
+const Attributes& Reader::get_attributes() const {
+    return this->attributes;
+}
+
+const String& Reader::get_text() const {
+    return this->text;
+}
+
+const ProcessingInstruction& Reader::get_processing_instruction() const {
+    return this->processing_instruction;
+}
+
+std::size_t Reader::get_depth() const {
+    return this->depth;
+}
+
+const Document& Reader::get_document() const {
+    return this->document;
+}
+
+Reader read_file(const std::filesystem::path& file_path) {
+    return Reader(std::make_unique<MappedFile>(file_path));
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Pull-based (cursor) reading of documents - an alternative to building an entire document.
+#pragma once
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "parser.h"
+#include "utils.h"
+
+
+namespace xml {
+
+// Kinds of nodes the reader can be positioned on.
+enum class NodeType {none, start_element, end_element, text, processing_instruction, end_document};
+
+
+// Reads a document one node at a time, with the caller requesting each next node.
+// Parsing only proceeds as far as requested, so reading can stop early at no extra cost.
+// Note that no validation is performed when reading (well-formedness only), and
+// toplevel items (XML declaration, DOCTYPE, PIs) are only available through the document.
+class Reader {
+    // Element that has been opened (start tag seen), but not yet closed.
+    struct OpenElement {
+        String name; // Element name.
+        std::size_t general_entity_depth; // General entity stack size at the start tag.
+    };
+    std::unique_ptr<MappedFile> file = nullptr; // Memory mapped file (file reading only).
+    std::unique_ptr<Parser> parser; // Underlying parser.
+    Document document; // Toplevel data of the document (root element left empty).
+    std::vector<OpenElement> open_elements; // Elements currently open, from root to innermost.
+    NodeType type = NodeType::none; // Type of the current node.
+    String name; // Element name of the current start/end element.
+    Attributes attributes; // Attributes of the current start element.
+    String text; // Text of the current text node.
+    ProcessingInstruction processing_instruction; // Current processing instruction.
+    std::size_t depth = 0; // Number of elements enclosing the current node.
+    // Markup already detected (opening consumed) whilst reading text, still to be parsed.
+    ContentType pending_markup = ContentType::character_data;
+    bool pending_end = false; // Current node is an empty tag, so its end element comes next.
+    Element content; // Scratch element collecting flushed character data.
+    String char_data; // Character data not yet flushed.
+
+    // Parse a tag (opening '<' consumed), returning the corresponding node type.
+    NodeType read_tag();
+    public:
+        // Contiguous buffer constructor (the data must outlive the reader).
+        Reader(std::string_view);
+        // Stream constructor (the stream must outlive the reader).
+        Reader(std::istream&);
+        // File constructor (memory mapped) - see read_file.
+        Reader(std::unique_ptr<MappedFile>);
+        // Moves to the next node and returns its type. Keeps returning end_document
+        // once the end of the document is reached.
+        NodeType next();
+        // If positioned on a start element, moves to its corresponding end element
+        // without reporting anything in between. Otherwise, does nothing.
+        void skip_subtree();
+        // Returns the type of the current node.
+        NodeType get_type() const;
+        // Returns the name of the current start/end element.
+        const String& get_name() const;
+        // Returns the attributes of the current start element (including ATTLIST defaults).
+        const Attributes& get_attributes() const;
+        // Returns the text of the current text node. Contiguous character data
+        // is reported as a single text node (comments are stripped away).
+        const String& get_text() const;
+        // Returns the current processing instruction.
+        const ProcessingInstruction& get_processing_instruction() const;
+        // Returns the number of elements enclosing the current node (0 for the root element).
+        std::size_t get_depth() const;
+        // Returns the toplevel data of the document - XML declaration, DOCTYPE declaration
+        // and toplevel PIs seen so far (no root element).
+        const Document& get_document() const;
+};
+
+// Returns a reader for the file at a given path (memory mapped).
+Reader read_file(const std::filesystem::path&);
+
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "resource.h"
+#include <utility>
+#include "parser.h"
+
+
+namespace xml {
+
+ResourceCache::ResourceCache(std::size_t max_bytes) {
+    this->max_bytes = max_bytes;
+}
+
+std::shared_ptr<const ExternalResource> ResourceCache::get(const std::filesystem::path& file_path) {
+    std::filesystem::path key = std::filesystem::absolute(file_path).lexically_normal();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto resource_it = this->resources_by_path.find(key);
+        if (resource_it != this->resources_by_path.end()) {
+            // Now the most recently used.
+            this->resources.splice(this->resources.begin(), this->resources, resource_it->second);
+            return resource_it->second->second;
+        }
+    }
+    // Loaded without holding the lock, so other resources can be looked up meanwhile.
+    // If loaded by another thread at the same time, the first one cached is kept.
+    std::shared_ptr<const ExternalResource> resource = EntityStream::load(file_path);
+    std::size_t resource_bytes = resource->file->view().size();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto resource_it = this->resources_by_path.find(key);
+    if (resource_it != this->resources_by_path.end()) {
+        return resource_it->second->second;
+    }
+    if (this->max_bytes && resource_bytes > this->max_bytes) {
+        // Too large to ever be cached.
+        return resource;
+    }
+    this->resources.emplace_front(key, resource);
+    this->resources_by_path[key] = this->resources.begin();
+    this->bytes += resource_bytes;
+    while (this->max_bytes && this->bytes > this->max_bytes) {
+        // Drop the least recently used (still alive for any streams reading it).
+        auto& [evicted_path, evicted] = this->resources.back();
+        this->bytes -= evicted->file->view().size();
+        this->resources_by_path.erase(evicted_path);
+        this->resources.pop_back();
+    }
+    return resource;
+}
+
+std::size_t ResourceCache::size() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->resources.size();
+}
+
+std::size_t ResourceCache::get_bytes() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->bytes;
+}
+
+void ResourceCache::clear() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->resources.clear();
+    this->resources_by_path.clear();
+    this->bytes = 0;
+}
+
+}
\ No newline at end of file
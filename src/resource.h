@@ -0,0 +1,52 @@
+// External resources (parsed entities, DTD subsets) loaded once for any number of references.
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "utils.h"
+
+
+namespace xml {
+
+// External parsed entity or DTD subset file, loaded and ready to be read from.
+// The text declaration (if any) has already been parsed and the UTF-8 validated,
+// so each reference only needs to start reading at the replacement text.
+struct ExternalResource {
+    std::unique_ptr<MappedFile> file = nullptr; // Memory mapped file contents.
+    std::size_t text_start = 0; // Byte offset of the text after the text declaration.
+    std::size_t line_number = 1; // Line number at the start of the text.
+    std::size_t line_pos = 1; // Line position at the start of the text.
+    std::size_t validated_size = 0; // Number of leading bytes known to be valid UTF-8.
+    String version; // XML Version (as per text declaration).
+    String encoding; // Encoding (as per text declaration).
+};
+
+// Loaded external resources by resolved (absolute) path. Each resource is loaded on
+// first reference, and then reused by every later reference - within a document, and
+// across documents if the cache is shared. If a maximum size is given, the least recently
+// used resources are dropped once the total file size exceeds it.
+// Thread-safe - many documents may be parsed at once using the same cache.
+class ResourceCache {
+    mutable std::mutex mutex; // Guards the cached resources.
+    std::size_t max_bytes; // Maximum total size of cached files in bytes (0 if unlimited).
+    std::size_t bytes = 0; // Total size of cached files in bytes.
+    // Cached resources with their paths, most recently used first.
+    std::list<std::pair<std::filesystem::path, std::shared_ptr<const ExternalResource>>> resources;
+    std::map<std::filesystem::path, decltype(resources)::iterator> resources_by_path; // Index by path.
+    public:
+        // Cache with an optional maximum total file size in bytes (unlimited by default).
+        explicit ResourceCache(std::size_t = 0);
+        // Returns the resource at the given path, loading (and caching) it if needed.
+        std::shared_ptr<const ExternalResource> get(const std::filesystem::path&);
+        // Returns the number of cached resources.
+        std::size_t size() const;
+        // Returns the total size of cached files in bytes.
+        std::size_t get_bytes() const;
+        // Removes all cached resources.
+        void clear();
+};
+
+}
\ No newline at end of file
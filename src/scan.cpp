@@ -0,0 +1,272 @@
+#include "scan.h"
+#include <cstring>
+#include <string_view>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XML_SCAN_SSE2
+#include <emmintrin.h>
+#ifdef __AVX2__
+#define XML_SCAN_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define XML_SCAN_NEON
+#include <arm_neon.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace xml {
+
+// Returns the index of the lowest set bit (bits must be non-zero).
+static inline unsigned lowest_set_bit(unsigned long long bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Returns true if a scan must stop at a given byte.
+static inline bool scan_stop(char byte, const ScanDelimiters& delimiters) {
+    unsigned char value = static_cast<unsigned char>(byte);
+    return value < 0x20 || value >= 0x80 || byte == delimiters[0] || byte == delimiters[1]
+        || byte == delimiters[2] || byte == delimiters[3];
+}
+
+std::size_t scan_plain_ascii(const char* begin, const char* end, const ScanDelimiters& delimiters) {
+    const char* pos = begin;
+    // Comparisons are signed - non-ASCII bytes are negative, so also below space.
+#ifdef XML_SCAN_AVX2
+    const __m256i wide_space = _mm256_set1_epi8(0x20);
+    const __m256i wide_delimiters[4] {
+        _mm256_set1_epi8(delimiters[0]), _mm256_set1_epi8(delimiters[1]),
+        _mm256_set1_epi8(delimiters[2]), _mm256_set1_epi8(delimiters[3])
+    };
+    while (end - pos >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+        __m256i stops = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpgt_epi8(wide_space, block), _mm256_cmpeq_epi8(block, wide_delimiters[0])),
+            _mm256_or_si256(
+                _mm256_or_si256(
+                    _mm256_cmpeq_epi8(block, wide_delimiters[1]),
+                    _mm256_cmpeq_epi8(block, wide_delimiters[2])),
+                _mm256_cmpeq_epi8(block, wide_delimiters[3])));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(stops));
+        if (mask) {
+            return pos - begin + lowest_set_bit(mask);
+        }
+        pos += 32;
+    }
+#endif
+#ifdef XML_SCAN_SSE2
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i delimiter_vectors[4] {
+        _mm_set1_epi8(delimiters[0]), _mm_set1_epi8(delimiters[1]),
+        _mm_set1_epi8(delimiters[2]), _mm_set1_epi8(delimiters[3])
+    };
+    while (end - pos >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        __m128i stops = _mm_or_si128(
+            _mm_or_si128(_mm_cmplt_epi8(block, space), _mm_cmpeq_epi8(block, delimiter_vectors[0])),
+            _mm_or_si128(
+                _mm_or_si128(
+                    _mm_cmpeq_epi8(block, delimiter_vectors[1]),
+                    _mm_cmpeq_epi8(block, delimiter_vectors[2])),
+                _mm_cmpeq_epi8(block, delimiter_vectors[3])));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(stops));
+        if (mask) {
+            return pos - begin + lowest_set_bit(mask);
+        }
+        pos += 16;
+    }
+#endif
+#ifdef XML_SCAN_NEON
+    const int8x16_t space = vdupq_n_s8(0x20);
+    const int8x16_t delimiter_vectors[4] {
+        vdupq_n_s8(delimiters[0]), vdupq_n_s8(delimiters[1]),
+        vdupq_n_s8(delimiters[2]), vdupq_n_s8(delimiters[3])
+    };
+    while (end - pos >= 16) {
+        int8x16_t block = vld1q_s8(reinterpret_cast<const int8_t*>(pos));
+        uint8x16_t stops = vorrq_u8(
+            vorrq_u8(vcltq_s8(block, space), vceqq_s8(block, delimiter_vectors[0])),
+            vorrq_u8(
+                vorrq_u8(vceqq_s8(block, delimiter_vectors[1]), vceqq_s8(block, delimiter_vectors[2])),
+                vceqq_s8(block, delimiter_vectors[3])));
+        // Narrow each byte of the comparison to 4 bits, giving a 64-bit mask.
+        unsigned long long mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(stops), 4)), 0);
+        if (mask) {
+            return pos - begin + lowest_set_bit(mask) / 4;
+        }
+        pos += 16;
+    }
+#endif
+    // Scalar fallback (and any remaining bytes after the last full block).
+    while (pos != end && !scan_stop(*pos, delimiters)) {
+        pos++;
+    }
+    return pos - begin;
+}
+
+// Returns the number of leading ASCII bytes.
+static std::size_t scan_ascii(const char* begin, const char* end) {
+    const char* pos = begin;
+#ifdef XML_SCAN_AVX2
+    while (end - pos >= 32) {
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos))));
+        if (mask) {
+            return pos - begin + lowest_set_bit(mask);
+        }
+        pos += 32;
+    }
+#endif
+#ifdef XML_SCAN_SSE2
+    while (end - pos >= 16) {
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))));
+        if (mask) {
+            return pos - begin + lowest_set_bit(mask);
+        }
+        pos += 16;
+    }
+#endif
+#ifdef XML_SCAN_NEON
+    while (end - pos >= 16) {
+        uint8x16_t non_ascii = vcgeq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(pos)), vdupq_n_u8(0x80));
+        unsigned long long mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(non_ascii), 4)), 0);
+        if (mask) {
+            return pos - begin + lowest_set_bit(mask) / 4;
+        }
+        pos += 16;
+    }
+#endif
+    while (pos != end && !(static_cast<unsigned char>(*pos) & 0b10000000)) {
+        pos++;
+    }
+    return pos - begin;
+}
+
+std::size_t valid_multibyte_character(const unsigned char* pos, std::size_t available) {
+    unsigned char lead = pos[0];
+    std::size_t length;
+    // Allowed range of the second byte - narrower for some lead bytes to reject
+    // overlong encodings (E0, F0), surrogates (ED) and values beyond U+10FFFF (F4).
+    unsigned char second_min = 0x80;
+    unsigned char second_max = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) {
+            second_min = 0xA0;
+        } else if (lead == 0xED) {
+            second_max = 0x9F;
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) {
+            second_min = 0x90;
+        } else if (lead == 0xF4) {
+            second_max = 0x8F;
+        }
+    } else {
+        return 0;
+    }
+    if (available < length || pos[1] < second_min || pos[1] > second_max) {
+        return 0;
+    }
+    for (std::size_t i = 2; i < length; ++i) {
+        if ((pos[i] & 0b11000000) != 0b10000000) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+const char* validate_utf8(const char* begin, const char* end) {
+    const char* pos = begin;
+    while (true) {
+        pos += scan_ascii(pos, end);
+        if (pos == end) {
+            return pos;
+        }
+        std::size_t length = valid_multibyte_character(
+            reinterpret_cast<const unsigned char*>(pos), end - pos);
+        if (!length) {
+            return pos;
+        }
+        pos += length;
+    }
+}
+
+// Returns the position just after the next occurrence of a terminator, or nullptr if none.
+static const char* skip_past(const char* pos, const char* end, std::string_view terminator) {
+    std::size_t index = std::string_view(pos, end - pos).find(terminator);
+    return index == std::string_view::npos ? nullptr : pos + index + terminator.size();
+}
+
+const char* scan_child_elements(const char* begin, const char* end, std::vector<const char*>& children) {
+    std::size_t depth = 0;
+    const char* pos = begin;
+    while (true) {
+        pos = static_cast<const char*>(std::memchr(pos, '<', end - pos));
+        if (pos == nullptr || end - pos < 2) {
+            return nullptr;
+        }
+        const char* markup = pos;
+        switch (pos[1]) {
+            case '!':
+                // Comment or CDATA section (anything else is invalid in content).
+                if (std::string_view(pos, end - pos).substr(0, 4) == "<!--") {
+                    pos = skip_past(pos + 4, end, "-->");
+                } else if (std::string_view(pos, end - pos).substr(0, 9) == "<![CDATA[") {
+                    pos = skip_past(pos + 9, end, "]]>");
+                } else {
+                    return nullptr;
+                }
+                break;
+            case '?':
+                pos = skip_past(pos + 2, end, "?>");
+                break;
+            case '/':
+                if (depth == 0) {
+                    return markup;
+                }
+                --depth;
+                pos = skip_past(pos + 2, end, ">");
+                break;
+            default: {
+                if (depth == 0) {
+                    children.push_back(markup);
+                }
+                // Start or empty tag - attribute values may contain '>' and '/'.
+                char quote = 0;
+                for (++pos; pos < end && (quote || *pos != '>'); ++pos) {
+                    if (quote ? *pos == quote : *pos == '\'' || *pos == '"') {
+                        quote = quote ? 0 : *pos;
+                    }
+                }
+                if (pos == end) {
+                    return nullptr;
+                }
+                if (pos[-1] != '/') {
+                    ++depth;
+                }
+                ++pos;
+            }
+        }
+        if (pos == nullptr) {
+            return nullptr;
+        }
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+// Vectorised scanning of raw input bytes for the next byte needing character-level processing.
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+
+
+namespace xml {
+
+// Bytes at which a scan stops, in addition to control and non-ASCII bytes
+// (repeat a delimiter if fewer are needed).
+typedef std::array<char, 4> ScanDelimiters;
+
+// Character data stops at markup, references and ']' / '>' (for the ']]>' check).
+constexpr ScanDelimiters CHARACTER_DATA_DELIMITERS {'<', '&', ']', '>'};
+// Attribute values stop at markup, references and quotes.
+constexpr ScanDelimiters ATTRIBUTE_VALUE_DELIMITERS {'<', '&', '\'', '"'};
+// Comments stop at hyphens (for the '--' check).
+constexpr ScanDelimiters COMMENT_DELIMITERS {'-', '-', '-', '-'};
+// CDATA sections stop at ']' and '>' (for the ']]>' terminator).
+constexpr ScanDelimiters CDATA_DELIMITERS {']', '>', ']', '>'};
+// Processing instructions stop at '?' and '>' (for the '?>' terminator).
+constexpr ScanDelimiters PROCESSING_INSTRUCTION_DELIMITERS {'?', '>', '?', '>'};
+
+// Returns the number of leading bytes which are printable ASCII (space onwards) and not delimiters.
+// Such bytes are always valid characters not affecting line numbers, so can be skipped in bulk.
+// Blocks of 32 (AVX2) or 16 (SSE2, NEON) bytes are checked at once where available.
+std::size_t scan_plain_ascii(const char* begin, const char* end, const ScanDelimiters&);
+
+// Bytes of input validated as UTF-8 at a time, just ahead of parsing (so parsing that stops
+// early does not pay for validating the rest of the input).
+constexpr std::size_t UTF8_VALIDATION_CHUNK_SIZE = 1 << 16;
+// Returns the end of the longest prefix of the data made up of complete, valid UTF-8 characters.
+// Validation is strict - overlong encodings, surrogates and values beyond U+10FFFF are rejected,
+// so characters in the prefix can be decoded without any further checks (see decode_utf8).
+// ASCII is checked in blocks (as above), other characters one at a time.
+const char* validate_utf8(const char* begin, const char* end);
+// Returns the length of the valid multi-byte character at the start of the given number of
+// bytes (0 if invalid or incomplete), by the same strict rules as validate_utf8.
+std::size_t valid_multibyte_character(const unsigned char*, std::size_t);
+
+// Quickly finds the child elements of an element, given its content (just after the start tag),
+// only looking at markup boundaries (no well-formedness checks - the content must still be parsed).
+// The start of each child ('<') is added to the given list. Returns the start of the end tag
+// of the element ('<'), or nullptr if the end could not be found.
+const char* scan_child_elements(const char* begin, const char* end, std::vector<const char*>&);
+
+}
\ No newline at end of file
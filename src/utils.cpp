@@ -1,147 +1,384 @@
 #include "utils.h"
+#include "scan.h"
 #include <string>
 #include <cstring>
+#include <fstream>
+#include <iterator>
+#include <new>
 #include <sstream>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 namespace xml {
 
-String::String(const char* string) {
-    std::string str(string, string + std::strlen(string));
-    StringBuffer string_buffer(str);
-    std::istream istream(&string_buffer);
-    while (istream.peek() != EOF) {
-        this->push_back(parse_utf8(istream));
-    }
-}
+String::String(const std::pmr::string& string) : std::pmr::string(string) {}
+
+String::String(std::pmr::string&& string) : std::pmr::string(std::move(string)) {}
+
+String::String(const std::string& string) : std::pmr::string(string.data(), string.size()) {}
 
-String::String(const std::string& string) : String::String(string.c_str()) {}
+String::String(std::string_view string) : std::pmr::string(string.data(), string.size()) {}
 
-std::ostream& operator<<(std::ostream& output, const String& string) {
-    return output << std::string(string);
+String::operator std::string() const {
+    return std::string(this->data(), this->size());
 }
 
-void fill_utf8_byte(char& byte, Char& value_left, int bits) {
-    for (int n = 0; n < bits; ++n) {
-        if (value_left & 1) {
-            byte |= (1 << n);
-        }   
-        value_left >>= 1;
+String::String(std::initializer_list<Char> chars) {
+    this->reserve(chars.size());
+    for (Char c : chars) {
+        this->push_back(c);
     }
 }
 
-String::operator std::string() const {
-    std::string string;
-    string.reserve(this->size() * 4);
-    // Converts each Unicode value to sequence of correct Unicode bytes.
-    for (Char c : *this) {
-        if (c < 0) {
-            // Invalid character - cannot be negative.
-            throw XmlError("Invalid character in String");
-        }
-        if (c <= UTF8_BYTE_LIMITS[0]) {
-            // Just ASCII - nothing special - can add character directly.
-            string.push_back(c);
-            continue;
-        } else if (c >= UTF8_BYTE_LIMITS[3]) {
-            // Too large - invalid.
-            throw XmlError("Invalid character in String");
-        }
-        // Deduce number of bytes required based on numeric value.
-        int bytes = c <= UTF8_BYTE_LIMITS[1] ? 2 : c <= UTF8_BYTE_LIMITS[2] ? 3 : 4;
-        // First character byte depends on number of bytes to represent character.
-        char byte1 = bytes == 2 ? 0b11000000 : bytes == 3 ? 0b11100000 : 0b11110000;
-        // All additional bytes are in the form 10xxxxxx
-        std::vector<char> extra_bytes(bytes - 1, 0b10000000);
-        for (int i = bytes - 2; i >= 0; --i) {
-            fill_utf8_byte(extra_bytes[i], c, 6);
-        }
-        fill_utf8_byte(byte1, c, 7 - bytes);
-        string.push_back(byte1);
-        string.insert(string.end(), extra_bytes.begin(), extra_bytes.end());
+void String::push_back_utf8(Char c) {
+    if (c < 0 || c > UTF8_BYTE_LIMITS[3]) {
+        // Invalid character - cannot be negative or too large.
+        throw XmlError("Invalid character in String");
+    }
+    // Deduce number of bytes required based on numeric value.
+    // First character byte depends on number of bytes to represent character,
+    // and all additional bytes are in the form 10xxxxxx.
+    if (c <= UTF8_BYTE_LIMITS[1]) {
+        std::pmr::string::push_back(static_cast<char>(0b11000000 | (c >> 6)));
+    } else if (c <= UTF8_BYTE_LIMITS[2]) {
+        std::pmr::string::push_back(static_cast<char>(0b11100000 | (c >> 12)));
+        std::pmr::string::push_back(static_cast<char>(0b10000000 | ((c >> 6) & 0b00111111)));
+    } else {
+        std::pmr::string::push_back(static_cast<char>(0b11110000 | (c >> 18)));
+        std::pmr::string::push_back(static_cast<char>(0b10000000 | ((c >> 12) & 0b00111111)));
+        std::pmr::string::push_back(static_cast<char>(0b10000000 | ((c >> 6) & 0b00111111)));
     }
-    string.shrink_to_fit();
-    return string;
+    std::pmr::string::push_back(static_cast<char>(0b10000000 | (c & 0b00111111)));
+}
+
+Codepoints String::codepoints() const {
+    return Codepoints(this->data(), this->data() + this->size());
+}
+
+CodepointIterator::CodepointIterator(const char* pos, const char* end) {
+    this->pos = pos;
+    this->end = end;
+}
+
+Char CodepointIterator::operator*() const {
+    const char* pos = this->pos;
+    return parse_utf8(pos, this->end);
+}
+
+CodepointIterator& CodepointIterator::operator++() {
+    parse_utf8(this->pos, this->end);
+    return *this;
+}
+
+bool CodepointIterator::operator==(const CodepointIterator& other) const {
+    return this->pos == other.pos;
+}
+
+bool CodepointIterator::operator!=(const CodepointIterator& other) const {
+    return this->pos != other.pos;
+}
+
+Codepoints::Codepoints(const char* begin, const char* end) {
+    this->begin_pos = begin;
+    this->end_pos = end;
+}
+
+CodepointIterator Codepoints::begin() const {
+    return CodepointIterator(this->begin_pos, this->end_pos);
+}
+
+CodepointIterator Codepoints::end() const {
+    return CodepointIterator(this->end_pos, this->end_pos);
+}
+
+// Returns the length of the UTF-8 character starting with the given byte (0 if never a lead byte).
+static int utf8_length(unsigned char lead) {
+    return lead < 0b10000000 ? 1 : lead >= 0xC2 && lead <= 0xDF ? 2
+        : lead >= 0xE0 && lead <= 0xEF ? 3 : lead >= 0xF0 && lead <= 0xF4 ? 4 : 0;
 }
 
 Char parse_utf8(std::istream& istream) {
-    char current_char = istream.get();
-    if ((current_char & 0b10000000) == 0) {
-        return current_char;
+    unsigned char bytes[4];
+    bytes[0] = istream.get();
+    int length = utf8_length(bytes[0]);
+    if (length == 1) {
+        return bytes[0];
     }
-    int sig_1s = 1;
-    char mask = 0b01000000;
-    // Determine if 2-bytes, 3-bytes or 4-bytes based on number of leading 1s.
-    while (current_char & mask) {
-        sig_1s++;
-        mask >>= 1;
-    }
-    // Validate indeed 2-4 bytes, and not invalid Unicode byte.
-    if (sig_1s < 2 || sig_1s > 4) {
+    if (!length) {
         throw XmlError("Invalid UTF-8 byte");
     }
-    // First byte has (8-n-1) bytes of interest where n is number of leading 1s
-    Char char_value = current_char & (0b11111111 >> sig_1s);
-    // Each subsequent byte has 10xxxxxx = 6 bytes of interest.
-    for (int offset = 1; offset < sig_1s; ++offset) {
-        char byte = istream.get();
+    for (int offset = 1; offset < length; ++offset) {
+        int byte = istream.get();
         if (byte == EOF) {
             throw XmlError("Incomplete UTF-8 character");
         }
-        // Ensure byte starts with 10......
-        if ((byte & 0b10000000) == 0 || (byte & 0b01000000) == 1)  {
-            throw XmlError("Invalid UTF-8 byte");
-        }
-        char_value <<= 6;
-        char_value += byte & 0b00111111;
+        bytes[offset] = byte;
     }
-    return char_value;
+    // Same rules as for buffers - no overlong encodings, surrogates or values beyond U+10FFFF.
+    if (!valid_multibyte_character(bytes, length)) {
+        throw XmlError("Invalid UTF-8 byte");
+    }
+    const char* pos = reinterpret_cast<const char*>(bytes);
+    return decode_utf8(pos);
 }
 
-StringBuffer::StringBuffer(const std::string& string) {
-    this->setg(const_cast<char*>(string.data()), const_cast<char*>(string.data()),
-        const_cast<char*>(string.data()) + string.size());
+Char parse_utf8(const char*& pos, const char* end) {
+    unsigned char current_char = *pos;
+    int length = utf8_length(current_char);
+    if (length == 1) {
+        // ASCII - by far the most common case.
+        ++pos;
+        return current_char;
+    }
+    if (!length) {
+        ++pos;
+        throw XmlError("Invalid UTF-8 byte");
+    }
+    if (end - pos < length) {
+        pos = end;
+        throw XmlError("Incomplete UTF-8 character");
+    }
+    // Checked exactly as when validating the buffer ahead of parsing (see validate_utf8).
+    if (!valid_multibyte_character(reinterpret_cast<const unsigned char*>(pos), length)) {
+        ++pos;
+        throw XmlError("Invalid UTF-8 byte");
+    }
+    return decode_utf8(pos);
 }
 
-GeneralEntity::GeneralEntity(const String& value) {
-    this->value = value;
+MappedFile::MappedFile(const std::filesystem::path& file_path) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(
+        file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(handle, &file_size) && file_size.QuadPart == 0) {
+            // Empty file - nothing to map (mapping an empty file fails).
+            CloseHandle(handle);
+            return;
+        }
+        HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view != nullptr) {
+            this->file_handle = handle;
+            this->mapping_handle = mapping;
+            this->data = static_cast<const char*>(view);
+            this->size = static_cast<std::size_t>(file_size.QuadPart);
+            this->is_mapped = true;
+            return;
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(handle);
+    }
+#else
+    int descriptor = open(file_path.c_str(), O_RDONLY);
+    if (descriptor != -1) {
+        struct stat file_info;
+        if (fstat(descriptor, &file_info) == 0 && S_ISREG(file_info.st_mode)) {
+            if (file_info.st_size == 0) {
+                // Empty file - nothing to map (mapping zero bytes fails).
+                close(descriptor);
+                return;
+            }
+            void* view = mmap(nullptr, file_info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (view != MAP_FAILED) {
+                // The document is consumed from start to end - allow aggressive read-ahead.
+                madvise(view, file_info.st_size, MADV_SEQUENTIAL);
+                // The mapping remains valid after the file descriptor is closed.
+                close(descriptor);
+                this->data = static_cast<const char*>(view);
+                this->size = file_info.st_size;
+                this->is_mapped = true;
+                return;
+            }
+        }
+        close(descriptor);
+    }
+#endif
+    // Could not map the file - read it into memory instead if it can be opened at all.
+    std::ifstream stream(file_path, std::ios::binary);
+    if (!stream.is_open()) {
+        throw XmlError("Could not open file: " + file_path.string());
+    }
+    this->fallback.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    this->data = this->fallback.data();
+    this->size = this->fallback.size();
 }
 
-bool is_whitespace(Char c) {
-    return std::find(WHITESPACE.cbegin(), WHITESPACE.cend(), c) != WHITESPACE.cend();
+MappedFile::~MappedFile() {
+    if (!this->is_mapped) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(this->data);
+    CloseHandle(this->mapping_handle);
+    CloseHandle(this->file_handle);
+#else
+    munmap(const_cast<char*>(this->data), this->size);
+#endif
 }
 
-bool in_any_character_range(Char c, const CharacterRanges& character_ranges) {
-    // Identifies a possible range the character can be in,
-    // and confirms it is indeed in range. If not within any range, this will be deduced.
-    auto possible_range_it = character_ranges.lower_bound({c, c});
-    return possible_range_it != character_ranges.cend()
-        && c >= possible_range_it->first && c <= possible_range_it->second;
+std::string_view MappedFile::view() const {
+    return std::string_view(this->data, this->size);
 }
 
-bool valid_character(Char c) {
-    return in_any_character_range(c, CHARACTER_RANGES);
+// Expands an internal general entity (and any entities it references, if not already).
+// Entities currently being expanded are tracked, detecting recursion.
+static void expand_general_entity(
+    const GeneralEntity& entity, const GeneralEntities* general_entities,
+    bool standalone, std::set<String>& expanding, std::size_t max_size
+) {
+    GeneralEntityExpansion expansion;
+    expansion.expanded = true;
+    if (entity.is_external || entity.is_unparsed) {
+        entity.expansion = std::move(expansion);
+        return;
+    }
+    expanding.insert(entity.name);
+    bool in_content = true;
+    bool in_attribute_value = true;
+    const char* pos = entity.value.data();
+    const char* end = pos + entity.value.size();
+    while (pos < end && (in_content || in_attribute_value)) {
+        if (expansion.text.size() > max_size) {
+            // Too large to expand in advance - left to be read as referenced.
+            in_content = in_attribute_value = false;
+            break;
+        }
+        Char c = decode_utf8(pos);
+        if (c == AMPERSAND) {
+            const char* reference_end = std::find(pos, end, SEMI_COLON);
+            if (reference_end == end) {
+                in_content = in_attribute_value = false;
+                break;
+            }
+            String reference(pos, reference_end + 1);
+            pos = reference_end + 1;
+            if (reference.front() == OCTOTHORPE) {
+                // Character reference - always data, whatever the character.
+                try {
+                    c = parse_character_reference(reference.substr(1));
+                } catch (const XmlError&) {
+                    in_content = in_attribute_value = false;
+                    break;
+                }
+                expansion.text.push_back(c);
+                expansion.attribute_text.push_back(c);
+                expansion.character_references_end = expansion.text.size();
+                expansion.whitespace_only = false;
+                continue;
+            }
+            reference.pop_back();
+            // Entity reference - must be fine to expand in place (no errors possible).
+            if (
+                general_entities == nullptr || !general_entities->count(reference)
+                || expanding.count(reference)
+            ) {
+                in_content = in_attribute_value = false;
+                break;
+            }
+            const GeneralEntity& referenced = general_entities->at(reference);
+            if (!BUILT_IN_GENERAL_ENTITIES.count(reference) && referenced.from_external && standalone) {
+                in_content = in_attribute_value = false;
+                break;
+            }
+            if (!referenced.expansion.expanded) {
+                expand_general_entity(referenced, general_entities, standalone, expanding, max_size);
+            }
+            const GeneralEntityExpansion& nested = referenced.expansion;
+            if (expansion.text.size() + nested.text.size() > max_size) {
+                // Too large to expand in advance - left to be read as referenced.
+                in_content = in_attribute_value = false;
+                break;
+            }
+            in_content = in_content && nested.in_content;
+            in_attribute_value = in_attribute_value && nested.in_attribute_value;
+            if (nested.character_references_end) {
+                expansion.character_references_end = expansion.text.size() + nested.character_references_end;
+            }
+            expansion.text.append(nested.text);
+            expansion.attribute_text.append(nested.attribute_text);
+            expansion.whitespace_only = expansion.whitespace_only && nested.whitespace_only;
+            continue;
+        }
+        if (c == LEFT_ANGLE_BRACKET) {
+            // Markup.
+            in_content = in_attribute_value = false;
+            break;
+        }
+        if (c == RIGHT_ANGLE_BRACKET || !valid_character(c)) {
+            // Any '>' must be checked for ']]>' in content.
+            in_content = false;
+        }
+        if (!valid_attribute_value_character(c)) {
+            in_attribute_value = false;
+        }
+        expansion.text.push_back(c);
+        if (is_whitespace(c)) {
+            expansion.attribute_text.push_back(SPACE);
+        } else {
+            expansion.attribute_text.push_back(c);
+            expansion.whitespace_only = false;
+        }
+    }
+    expanding.erase(entity.name);
+    expansion.in_content = in_content;
+    expansion.in_attribute_value = in_attribute_value;
+    if (!in_content && !in_attribute_value) {
+        // Not usable at all.
+        expansion.text.clear();
+        expansion.attribute_text.clear();
+    }
+    entity.expansion = std::move(expansion);
+}
+
+GeneralEntity::GeneralEntity(const String& value) {
+    this->value = value;
+    // Built-in entity - only character references.
+    std::set<String> expanding;
+    expand_general_entity(*this, nullptr, false, expanding, this->value.size());
 }
 
-bool valid_name_start_character(Char c) {
-    return in_any_character_range(c, NAME_START_CHARACTER_RANGES);
+const GeneralEntityExpansion& expand_general_entity(
+    const GeneralEntity& entity, const GeneralEntities& general_entities, bool standalone, std::size_t max_size
+) {
+    if (!entity.expansion.expanded) {
+        std::set<String> expanding;
+        expand_general_entity(entity, &general_entities, standalone, expanding, max_size);
+    }
+    return entity.expansion;
 }
 
-bool valid_name_character(Char c) {
-    return in_any_character_range(c, NAME_CHARACTER_RANGES);
+void reset_general_entity_expansions(const GeneralEntities& general_entities) {
+    for (const auto& [name, entity] : general_entities) {
+        entity.expansion = GeneralEntityExpansion();
+    }
 }
 
-bool valid_name(const String& name, bool check_all_chars) {
+bool valid_name(std::string_view name, bool check_all_chars) {
     if (name.empty()) {
         return false;
     }
     if (check_all_chars) {
         // Only when not checking on-the-go should validating all characters occur.
         // Such as an attribute value needing to be a valid Name.
-        if (!valid_name_start_character(name.front())) {
+        Codepoints chars(name.data(), name.data() + name.size());
+        if (!valid_name_start_character(*chars.begin())) {
             return false;
         }
-        if (!std::all_of(name.cbegin() + 1, name.cend(), valid_name_character)) {
+        if (!std::all_of(++chars.begin(), chars.end(), valid_name_character)) {
             return false;
         }
     }
@@ -149,8 +386,9 @@ bool valid_name(const String& name, bool check_all_chars) {
         return true;
     }
     // Names starting with xml (case-insensitive) are reserved. Disallow.
-    return !(std::tolower(name[0]) == 'x'
-            && std::tolower(name[1]) == 'm' && std::tolower(name[2]) == 'l');
+    return !(std::tolower(static_cast<unsigned char>(name[0])) == 'x'
+            && std::tolower(static_cast<unsigned char>(name[1])) == 'm'
+            && std::tolower(static_cast<unsigned char>(name[2])) == 'l');
 }
 
 bool valid_names_or_nmtokens(const String& string, bool is_nmtokens) {
@@ -159,7 +397,7 @@ bool valid_names_or_nmtokens(const String& string, bool is_nmtokens) {
     }
     // Names/nmtokens separated by a space without any leading/trailing spaces.
     String value;
-    for (Char c : string) {
+    for (char c : string) {
         if (c == SPACE) {
             if ((!is_nmtokens && !valid_name(value, true)) || (is_nmtokens && !valid_nmtoken(value))) {
                 return false;
@@ -178,7 +416,8 @@ bool valid_names(const String& names) {
 }
 
 bool valid_nmtoken(const String& nmtoken) {
-    return !nmtoken.empty() && std::all_of(nmtoken.cbegin(), nmtoken.cend(), valid_name_character);
+    Codepoints chars = nmtoken.codepoints();
+    return !nmtoken.empty() && std::all_of(chars.begin(), chars.end(), valid_name_character);
 }
 
 bool valid_nmtokens(const String& nmtokens) {
@@ -200,8 +439,8 @@ bool valid_processing_instruction_target(const String& target) {
 bool valid_version(const String& version) {
     // Must begin with 1. and subsequent characters are digits.
     return version.size() > 2 && version[0] == '1' && version[1] == '.'
-        && std::all_of(version.cbegin() + 2, version.cend(), [](Char c) {
-            return std::isdigit(c);
+        && std::all_of(version.cbegin() + 2, version.cend(), [](char c) {
+            return c >= '0' && c <= '9';
         });
 }
 
@@ -253,7 +492,7 @@ Char parse_character_reference(const String& string) {
     }
     Char char_value = 0;
     while (true) {
-        Char c = std::tolower(string[i++]);
+        Char c = std::tolower(static_cast<unsigned char>(string[i++]));
         if (c == SEMI_COLON) {
             break;
         }
@@ -284,7 +523,7 @@ Char parse_character_reference(const String& string) {
 String expand_character_references(const String& string) {
     String result;
     for (std::size_t i = 0; i < string.size(); ++i) {
-        Char c = string.at(i);
+        char c = string.at(i);
         if (c == AMPERSAND && string.at(i+1) == OCTOTHORPE) {
             String char_ref;
             i += 2;
@@ -314,4 +553,81 @@ bool is_url_resource(const std::string& file_path) {
     return false;
 }
 
+NameId NameTable::intern(std::string_view name) {
+    auto id_it = this->ids.find(name);
+    if (id_it != this->ids.end()) {
+        return id_it->second;
+    }
+    NameId id = this->names.size();
+    this->names.emplace_back(name);
+    this->ids.emplace(this->names.back(), id);
+    return id;
+}
+
+NameId NameTable::find(std::string_view name) const {
+    auto id_it = this->ids.find(name);
+    return id_it != this->ids.end() ? id_it->second : NO_NAME;
+}
+
+const String& NameTable::get_name(NameId id) const {
+    return this->names.at(id);
+}
+
+std::size_t NameTable::size() const {
+    return this->names.size();
+}
+
+Tag::Tag(const allocator_type& allocator) : name(allocator), attributes(allocator) {}
+
+Tag::Tag(const Tag& other, const allocator_type& allocator)
+    : name(other.name, allocator), type(other.type), attributes(other.attributes, allocator) {}
+
+Tag::Tag(Tag&& other, const allocator_type& allocator)
+    : name(std::move(other.name), allocator), type(other.type),
+    attributes(std::move(other.attributes), allocator) {}
+
+ProcessingInstruction::ProcessingInstruction(const allocator_type& allocator)
+    : target(allocator), instruction(allocator) {}
+
+ProcessingInstruction::ProcessingInstruction(
+    const ProcessingInstruction& other, const allocator_type& allocator
+) : target(other.target, allocator), instruction(other.instruction, allocator) {}
+
+ProcessingInstruction::ProcessingInstruction(ProcessingInstruction&& other, const allocator_type& allocator)
+    : target(std::move(other.target), allocator), instruction(std::move(other.instruction), allocator) {}
+
+Element::Element(const allocator_type& allocator)
+    : text(allocator), tag(allocator), children(allocator), processing_instructions(allocator) {}
+
+Element::Element(const Element& other, const allocator_type& allocator)
+    : text(other.text, allocator), tag(other.tag, allocator), children(other.children, allocator),
+    processing_instructions(other.processing_instructions, allocator),
+    is_empty(other.is_empty), children_only(other.children_only) {}
+
+Element::Element(Element&& other, const allocator_type& allocator)
+    : text(std::move(other.text), allocator), tag(std::move(other.tag), allocator),
+    children(std::move(other.children), allocator),
+    processing_instructions(std::move(other.processing_instructions), allocator),
+    is_empty(other.is_empty), children_only(other.children_only) {}
+
+Document::Document(std::shared_ptr<std::pmr::memory_resource> arena)
+    : arena(arena), root(Element::allocator_type(
+        arena != nullptr ? arena.get() : std::pmr::get_default_resource())) {}
+
+
+Document& Document::operator=(const Document& other) {
+    Document copy(other);
+    return *this = std::move(copy);
+}
+
+Document& Document::operator=(Document&& other) {
+    if (this != &other) {
+        // Memberwise assignment would keep the old allocators (reallocating everything)
+        // and release the old arena before the elements in it - rebuild instead.
+        this->~Document();
+        new (this) Document(std::move(other));
+    }
+    return *this;
+}
+
 }
\ No newline at end of file
@@ -1,47 +1,148 @@
 // General utilities for the parser.
 #pragma once
 #include <algorithm>
+#include <array>
 #include <climits>
+#include <cstddef>
+#include <deque>
 #include <filesystem>
 #include <initializer_list>
 #include <istream>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <set>
 #include <stdexcept>
 #include <streambuf>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 
 namespace xml {
 
-// Each character is represented as a 4-byte integer to support the full Unicode range.
+// Each decoded character is represented as a 4-byte integer to support the full Unicode range.
 typedef int Char;
-// Unicode string class for use in the XML parser.
-class String : public std::vector<Char> {
-    public:
-        using std::vector<Char>::vector;
-        String(const char*);
-        String(const std::string&);
-        // Display the string (converts to std::string first).
-        friend std::ostream& operator<<(std::ostream&, const String&);
-        // Convert Unicode characters in their numeric values
-        // back to their original binary form (std::string compatibility).
-        operator std::string() const;
-};
 // Max values in UTF-8 representable in 1 byte, 2 bytes, 3 bytes, 4 bytes.
 constexpr Char UTF8_BYTE_LIMITS[4] {0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
-// Fills UTF-8 byte with values (number of right bits to use and current value left).
-void fill_utf8_byte(char&, Char&, int);
 // Parses a UTF-8 character
 Char parse_utf8(std::istream&);
-// Convenient streambuf wrapper for handling std::string objects as buffer.
-// Can then be used in istream. Better to have one stream interface
-// for both strings and normal streams than duplicate similar code.
-class StringBuffer : public std::streambuf {
+// Parses a UTF-8 character from a contiguous buffer, advancing the position past it.
+Char parse_utf8(const char*&, const char*);
+// Decodes a UTF-8 character already known to be valid (no checks), advancing the position past it.
+inline Char decode_utf8(const char*& pos) {
+    unsigned char current_char = *pos++;
+    if (current_char < 0b10000000) {
+        return current_char;
+    }
+    Char char_value;
+    int continuation_bytes;
+    if (current_char < 0b11100000) {
+        char_value = current_char & 0b00011111;
+        continuation_bytes = 1;
+    } else if (current_char < 0b11110000) {
+        char_value = current_char & 0b00001111;
+        continuation_bytes = 2;
+    } else {
+        char_value = current_char & 0b00000111;
+        continuation_bytes = 3;
+    }
+    for (int i = 0; i < continuation_bytes; ++i) {
+        char_value = (char_value << 6) | (static_cast<unsigned char>(*pos++) & 0b00111111);
+    }
+    return char_value;
+}
+
+// Iterates over the Unicode characters (rather than bytes) of UTF-8 data.
+class CodepointIterator {
+    const char* pos; // Start of the current character.
+    const char* end; // End of the data.
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Char;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Char*;
+        using reference = Char;
+        CodepointIterator(const char*, const char*);
+        // Decodes the current character.
+        Char operator*() const;
+        // Moves to the next character.
+        CodepointIterator& operator++();
+        bool operator==(const CodepointIterator&) const;
+        bool operator!=(const CodepointIterator&) const;
+};
+// Range of Unicode characters over UTF-8 data (for use in range-based for loops).
+class Codepoints {
+    const char* begin_pos; // Start of the data.
+    const char* end_pos; // End of the data.
+    public:
+        Codepoints(const char*, const char*);
+        CodepointIterator begin() const;
+        CodepointIterator end() const;
+};
+
+// Unicode string class for use in the XML parser, stored as UTF-8 (one byte per ASCII character).
+// Comparisons, searches and iteration work on bytes. Since all markup characters are ASCII and
+// never occur within a UTF-8 multi-byte sequence, byte-wise searching for them is safe.
+// Use codepoints() where each Unicode character is needed (e.g. name validation).
+// Memory comes from a polymorphic allocator, so that document strings can come from an arena.
+class String : public std::pmr::string {
+    // Appends the UTF-8 encoding of a non-ASCII character.
+    void push_back_utf8(Char);
+    public:
+        using std::pmr::string::string;
+        String() = default;
+        String(const String&) = default;
+        String(String&&) = default;
+        String(const std::pmr::string&);
+        String(std::pmr::string&&);
+        String(const std::string&);
+        String(std::string_view);
+        String& operator=(const String&) = default;
+        String& operator=(String&&) = default;
+        // Constructs the string from a sequence of Unicode characters.
+        String(std::initializer_list<Char>);
+        // Appends a raw byte (e.g. when copying from another String).
+        using std::pmr::string::push_back;
+        // Appends a Unicode character, encoding it as UTF-8.
+        void push_back(Char c) {
+            if (c <= UTF8_BYTE_LIMITS[0] && c >= 0) {
+                // Just ASCII - nothing special - can add character directly.
+                std::pmr::string::push_back(static_cast<char>(c));
+            } else {
+                this->push_back_utf8(c);
+            }
+        }
+        // Returns the Unicode characters of the string.
+        Codepoints codepoints() const;
+        // Conversion to std::string (copies the data).
+        operator std::string() const;
+};
+
+// Read-only memory mapping of an entire file, so that the file can be parsed
+// straight out of memory without stream buffering or copying into a string.
+// Falls back to reading the file into memory if it cannot be mapped (e.g. a pipe).
+class MappedFile {
+    const char* data = nullptr; // Start of the file contents.
+    std::size_t size = 0; // Number of bytes in the file.
+    bool is_mapped = false; // Data is an actual mapping rather than the fallback buffer.
+    std::string fallback; // File contents if mapping was not possible.
+#ifdef _WIN32
+    void* file_handle = nullptr; // Windows file handle.
+    void* mapping_handle = nullptr; // Windows file mapping object handle.
+#endif
     public:
-        StringBuffer(const std::string&);
+        // Maps the file at the given path (error if the file cannot be opened).
+        MappedFile(const std::filesystem::path&);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+        // Returns the entire contents of the file.
+        std::string_view view() const;
 };
 
 // Error class for all errors that occur during XML parsing/validation.
@@ -76,68 +177,205 @@ constexpr Char SEMI_COLON = ';';
 constexpr Char CARRIAGE_RETURN = '\r';
 constexpr Char LINE_FEED = '\n';
 
+// Note: all tables below are const (initialised before main and never modified),
+// so they are safe to read from any number of threads parsing at once.
+
 // Whitespace characters as per standard.
-static String WHITESPACE {SPACE, 0x09, CARRIAGE_RETURN, LINE_FEED};
-static String WHITESPACE_AND_RIGHT_ANGLE_BRACKET = []{
+static const String WHITESPACE {SPACE, 0x09, CARRIAGE_RETURN, LINE_FEED};
+static const String WHITESPACE_AND_RIGHT_ANGLE_BRACKET = []{
     String valid_chars = WHITESPACE;
     valid_chars.push_back(RIGHT_ANGLE_BRACKET);
     return valid_chars;
 }();
 
-// Returns true if character is indeed whitespace.
-bool is_whitespace(Char);
+// Bytes that can be consumed in bulk straight from the input buffer, without any
+// character-level processing (ASCII only - other bytes go through normal decoding).
+// Plain character data excludes markup and references, ']' and '>' (for the ']]>' check)
+// and carriage returns (new line normalisation).
+inline bool is_plain_character_data_byte(char byte) {
+    return (byte >= SPACE && byte != LEFT_ANGLE_BRACKET && byte != AMPERSAND
+        && byte != RIGHT_SQUARE_BRACKET && byte != RIGHT_ANGLE_BRACKET) || byte == 0x09 || byte == LINE_FEED;
+}
+// Plain attribute value bytes exclude quotes, markup, references and whitespace other than space.
+inline bool is_plain_attribute_value_byte(char byte) {
+    return byte >= SPACE && byte != LEFT_ANGLE_BRACKET && byte != AMPERSAND
+        && byte != SINGLE_QUOTE && byte != DOUBLE_QUOTE;
+}
+// Plain name bytes are ASCII name characters.
+inline bool is_plain_name_byte(char byte) {
+    return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9')
+        || byte == '_' || byte == ':' || byte == '-' || byte == '.';
+}
 
 // Characters which may signal end of tag name.
-static String START_EMPTY_TAG_NAME_TERMINATORS = []{
+static const String START_EMPTY_TAG_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.insert(valid_chars.end(), {RIGHT_ANGLE_BRACKET, SOLIDUS});
     return valid_chars;
 }();
 // End tag name cannot end with solidus (solidus at back of other vector - exclude it).
-static String END_TAG_NAME_TERMINATORS = []{
+static const String END_TAG_NAME_TERMINATORS = []{
     String valid_chars = START_EMPTY_TAG_NAME_TERMINATORS;
     valid_chars.erase(std::find(valid_chars.begin(), valid_chars.end(), SOLIDUS));
     return valid_chars;
 }();
 
 // Order character ranges by max in range.
-static auto character_ranges_comparator = [](const std::pair<Char, Char>& a, const std::pair<Char, Char>& b) {
+static const auto character_ranges_comparator = [](const std::pair<Char, Char>& a, const std::pair<Char, Char>& b) {
     return a.second < b.second;
 };
 // Character ranges are min/max Unicode value pairs in ascending order.
 typedef std::set<std::pair<Char, Char>, decltype(character_ranges_comparator)> CharacterRanges;
 
+// Min/max Unicode value pair, usable at compile time.
+typedef std::pair<Char, Char> CharacterRange;
 // Accepted character data as per standard. All chars in document must lie in one of these ranges.
-static CharacterRanges CHARACTER_RANGES({
+constexpr CharacterRange CHARACTER_RANGES[] {
     {0x09, 0x0A}, {0x0D, 0x0D}, {0x20, 0xD7FF}, {0xE000, 0xFFFD}, {0x10000, 0x10FFFF}
-}, character_ranges_comparator);
-// Returns true if a character is in one of the given character ranges.
-bool in_any_character_range(Char, const CharacterRanges&);
-// Returns true if a character is allowed at all in XML data.
-bool valid_character(Char);
-
+};
 // Valid start name character ranges.
-static CharacterRanges NAME_START_CHARACTER_RANGES({
+constexpr CharacterRange NAME_START_CHARACTER_RANGES[] {
     {':', ':'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}, {0xC0, 0xD6}, {0xD8, 0xF6}, {0xF8, 0x2FF},
     {0x370, 0x37D}, {0x37F, 0x1FFF}, {0x200C, 0x200D}, {0x2070, 0x218F}, {0x2C00, 0x2FEF},
     {0x3001, 0xD7FF}, {0xF900, 0xFDCF}, {0xFDF0, 0xFFFD}, {0x10000, 0xEFFFF}
-}, character_ranges_comparator);
-// Valid name character ranges.
-static CharacterRanges NAME_CHARACTER_RANGES = []{
-    CharacterRanges character_ranges = NAME_START_CHARACTER_RANGES;
-    // Characters not allowed at start but allowed after the first character.
-    CharacterRanges additional_character_ranges ({
-        {'-', '.'}, {'0', '9'}, {0xB7, 0xB7}, {0x0300, 0x036F}, {0x203F, 0x2040}
-    }, character_ranges_comparator);
-    character_ranges.merge(additional_character_ranges);
-    return character_ranges;
-}();
+};
+// Characters not allowed at the start of a name but allowed after the first character.
+constexpr CharacterRange ADDITIONAL_NAME_CHARACTER_RANGES[] {
+    {'-', '.'}, {'0', '9'}, {0xB7, 0xB7}, {0x0300, 0x036F}, {0x203F, 0x2040}
+};
+
+// Character classes, as bit flags - a character may belong to several classes.
+constexpr unsigned char CHARACTER_CLASS_CHARACTER = 1 << 0; // Allowed at all in XML data.
+constexpr unsigned char CHARACTER_CLASS_NAME_START = 1 << 1; // Valid name start character.
+constexpr unsigned char CHARACTER_CLASS_NAME = 1 << 2; // Valid name character.
+constexpr unsigned char CHARACTER_CLASS_WHITESPACE = 1 << 3; // Whitespace as per standard.
+
+// Character classification is done by table lookup rather than searching the ranges,
+// with all tables generated at compile time from the ranges above.
+namespace character_classes {
+    // Characters per block of the two-level table.
+    constexpr Char BLOCK_SIZE = 256;
+    // Number of blocks covering the entire Unicode range.
+    constexpr std::size_t BLOCK_COUNT = (UTF8_BYTE_LIMITS[3] + 1) / BLOCK_SIZE;
+    // Block table entries with this bit set refer to a mixed block, otherwise
+    // all characters in the block share the classes of the entry.
+    constexpr unsigned char MIXED_BLOCK = 0x80;
+
+    // Returns true if a character is in one of the given character ranges.
+    template<std::size_t N>
+    constexpr bool in_ranges(Char c, const CharacterRange (&ranges)[N]) {
+        for (const CharacterRange& range : ranges) {
+            if (c >= range.first && c <= range.second) {
+                return true;
+            }
+        }
+        return false;
+    }
+    // Returns true if any range starts or ends within a block (so the block is not uniform).
+    template<std::size_t N>
+    constexpr bool splits_block(std::size_t block, const CharacterRange (&ranges)[N]) {
+        Char first = block * BLOCK_SIZE;
+        Char last = first + BLOCK_SIZE - 1;
+        for (const CharacterRange& range : ranges) {
+            if ((range.first > first && range.first <= last) || (range.second >= first && range.second < last)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    // Determines the classes of a character from the ranges (slow - compile time only).
+    constexpr unsigned char classify(Char c) {
+        unsigned char classes = 0;
+        if (in_ranges(c, CHARACTER_RANGES)) {
+            classes |= CHARACTER_CLASS_CHARACTER;
+        }
+        if (in_ranges(c, NAME_START_CHARACTER_RANGES)) {
+            classes |= CHARACTER_CLASS_NAME_START | CHARACTER_CLASS_NAME;
+        }
+        if (in_ranges(c, ADDITIONAL_NAME_CHARACTER_RANGES)) {
+            classes |= CHARACTER_CLASS_NAME;
+        }
+        if (c == SPACE || c == 0x09 || c == CARRIAGE_RETURN || c == LINE_FEED) {
+            classes |= CHARACTER_CLASS_WHITESPACE;
+        }
+        return classes;
+    }
+    // Returns true if the characters of a block do not all share the same classes.
+    constexpr bool mixed_block(std::size_t block) {
+        // Whitespace is ASCII only, always in the first (mixed) block.
+        return block == 0 || splits_block(block, CHARACTER_RANGES)
+            || splits_block(block, NAME_START_CHARACTER_RANGES)
+            || splits_block(block, ADDITIONAL_NAME_CHARACTER_RANGES);
+    }
+    // Counts the mixed blocks, each needing its own table of classes.
+    constexpr std::size_t count_mixed_blocks() {
+        std::size_t count = 0;
+        for (std::size_t block = 0; block < BLOCK_COUNT; ++block) {
+            count += mixed_block(block);
+        }
+        return count;
+    }
+    constexpr std::size_t MIXED_BLOCK_COUNT = count_mixed_blocks();
+    static_assert(MIXED_BLOCK_COUNT < MIXED_BLOCK, "Too many mixed blocks for the block table");
+
+    // First level - for each block, its shared classes or the index of its mixed block table.
+    constexpr std::array<unsigned char, BLOCK_COUNT> BLOCKS = []{
+        std::array<unsigned char, BLOCK_COUNT> blocks {};
+        unsigned char mixed_blocks = 0;
+        for (std::size_t block = 0; block < BLOCK_COUNT; ++block) {
+            blocks[block] = mixed_block(block) ? (MIXED_BLOCK | mixed_blocks++) : classify(block * BLOCK_SIZE);
+        }
+        return blocks;
+    }();
+    // Second level - classes of each character in each mixed block.
+    constexpr std::array<std::array<unsigned char, BLOCK_SIZE>, MIXED_BLOCK_COUNT> MIXED_BLOCKS = []{
+        std::array<std::array<unsigned char, BLOCK_SIZE>, MIXED_BLOCK_COUNT> mixed_blocks {};
+        std::size_t index = 0;
+        for (std::size_t block = 0; block < BLOCK_COUNT; ++block) {
+            if (mixed_block(block)) {
+                for (Char c = 0; c < BLOCK_SIZE; ++c) {
+                    mixed_blocks[index][c] = classify(block * BLOCK_SIZE + c);
+                }
+                ++index;
+            }
+        }
+        return mixed_blocks;
+    }();
+}
+
+// Returns the classes of a character (0 if not a Unicode character at all).
+inline unsigned char get_character_classes(Char c) {
+    if (c >= 0 && c <= UTF8_BYTE_LIMITS[0]) {
+        // ASCII fast path - always in the first mixed block.
+        return character_classes::MIXED_BLOCKS[0][c];
+    }
+    if (c < 0 || c > UTF8_BYTE_LIMITS[3]) {
+        return 0;
+    }
+    unsigned char block = character_classes::BLOCKS[c / character_classes::BLOCK_SIZE];
+    if (!(block & character_classes::MIXED_BLOCK)) {
+        return block;
+    }
+    return character_classes::MIXED_BLOCKS[block & ~character_classes::MIXED_BLOCK][c % character_classes::BLOCK_SIZE];
+}
+// Returns true if character is indeed whitespace.
+inline bool is_whitespace(Char c) {
+    return get_character_classes(c) & CHARACTER_CLASS_WHITESPACE;
+}
+// Returns true if a character is allowed at all in XML data.
+inline bool valid_character(Char c) {
+    return get_character_classes(c) & CHARACTER_CLASS_CHARACTER;
+}
 // Returns true if a characteer is a valid name start character.
-bool valid_name_start_character(Char);
+inline bool valid_name_start_character(Char c) {
+    return get_character_classes(c) & CHARACTER_CLASS_NAME_START;
+}
 // Returns true if a character is a valid name character.
-bool valid_name_character(Char);
+inline bool valid_name_character(Char c) {
+    return get_character_classes(c) & CHARACTER_CLASS_NAME;
+}
 // Returns true if a name is valid (optionally checking all characters if not already).
-bool valid_name(const String&, bool check_all_chars = false);
+bool valid_name(std::string_view, bool check_all_chars = false);
 // DRY - validation of Names and Nmtokens very similar.
 bool valid_names_or_nmtokens(const String&, bool);
 // Returns true if string matches Names.
@@ -149,8 +387,8 @@ bool valid_nmtoken(const String&);
 bool valid_nmtokens(const String&);
 
 // Left angle bracket and ampersand are disallowed literal characters in attribute values.
-static String INVALID_ATTRIBUTE_VALUE_CHARACTERS {LEFT_ANGLE_BRACKET, AMPERSAND};
-static String ATTRIBUTE_NAME_TERMINATORS = []{
+static const String INVALID_ATTRIBUTE_VALUE_CHARACTERS {LEFT_ANGLE_BRACKET, AMPERSAND};
+static const String ATTRIBUTE_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.push_back(EQUAL);
     return valid_chars;
@@ -159,13 +397,13 @@ static String ATTRIBUTE_NAME_TERMINATORS = []{
 bool valid_attribute_value_character(Char);
 
 // XML declaration handling.
-static String XML_DECLARATION_VERSION_NAME = "version";
-static String XML_DECLARATION_ENCODING_NAME = "encoding";
-static String XML_DECLARATION_STANDALONE_NAME = "standalone";
+static const String XML_DECLARATION_VERSION_NAME = "version";
+static const String XML_DECLARATION_ENCODING_NAME = "encoding";
+static const String XML_DECLARATION_STANDALONE_NAME = "standalone";
 // Currently supported encodings by THIS XML PARSER (lower-case).
-static std::vector<String> SUPPORTED_ENCODINGS {"utf-8"};
+static const std::vector<String> SUPPORTED_ENCODINGS {"utf-8"};
 // Standalone is either 'yes' (true) or 'no' (false).
-static std::map<String, bool> STANDALONE_VALUES {{"yes", true}, {"no", false}};
+static const std::map<String, bool> STANDALONE_VALUES {{"yes", true}, {"no", false}};
 // Returns true for a valid version specified (1.x).
 bool valid_version(const String&);
 // Returns true for a valid encoding specified (as recognised by this parser).
@@ -176,21 +414,41 @@ bool get_standalone_value(const String&);
 // Tag types: start (opening), end (closing), empty.
 enum class TagType {start, end, empty};
 // Attributes list - map is suitable and convenient (sorted keys).
-typedef std::map<String, String> Attributes;
+typedef std::pmr::map<String, String> Attributes;
 // Tag class - either start, end or empty tag.
 struct Tag {
+    typedef std::pmr::polymorphic_allocator<Tag> allocator_type;
     String name; // Tag name
     TagType type; // Tag type (start/end/empty)
     Attributes attributes; // Map of tag attribute name/value pairs.
+    Tag() = default;
+    Tag(const Tag&) = default;
+    Tag(Tag&&) = default;
+    // Allocator-aware constructors (all memory from the given allocator).
+    explicit Tag(const allocator_type&);
+    Tag(const Tag&, const allocator_type&);
+    Tag(Tag&&, const allocator_type&);
+    Tag& operator=(const Tag&) = default;
+    Tag& operator=(Tag&&) = default;
 };
 
 // Processing instruction class.
 struct ProcessingInstruction {
+    typedef std::pmr::polymorphic_allocator<ProcessingInstruction> allocator_type;
     String target; // Name of the target application this PI is directed to.
     String instruction; // The instruction.
+    ProcessingInstruction() = default;
+    ProcessingInstruction(const ProcessingInstruction&) = default;
+    ProcessingInstruction(ProcessingInstruction&&) = default;
+    // Allocator-aware constructors (all memory from the given allocator).
+    explicit ProcessingInstruction(const allocator_type&);
+    ProcessingInstruction(const ProcessingInstruction&, const allocator_type&);
+    ProcessingInstruction(ProcessingInstruction&&, const allocator_type&);
+    ProcessingInstruction& operator=(const ProcessingInstruction&) = default;
+    ProcessingInstruction& operator=(ProcessingInstruction&&) = default;
 };
 // Characters which may signal end of processing instruction target name.
-static String PROCESSING_INSTRUCTION_TARGET_NAME_TERMINATORS = []{
+static const String PROCESSING_INSTRUCTION_TARGET_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.push_back(QUESTION_MARK);
     return valid_chars;
@@ -199,14 +457,25 @@ static String PROCESSING_INSTRUCTION_TARGET_NAME_TERMINATORS = []{
 bool valid_processing_instruction_target(const String&);
 
 // Element class - including child elements, text etc.
+// All memory of an element (including its descendants) comes from its allocator.
 struct Element {
+    typedef std::pmr::polymorphic_allocator<Element> allocator_type;
     String text; // All character data in the element (excluding text in child elements).
     Tag tag; // Underlying tag info: name, type, attributes
-    std::vector<Element> children; // Child elements in order of being parsed.
-    std::vector<ProcessingInstruction> processing_instructions; // PIs in order of being parsed.
+    std::pmr::vector<Element> children; // Child elements in order of being parsed.
+    std::pmr::vector<ProcessingInstruction> processing_instructions; // PIs in order of being parsed.
     bool is_empty = true; // Element is EMPTY
     // Only child elements and raw whitespace (no CDATA, character references etc).
     bool children_only = true;
+    Element() = default;
+    Element(const Element&) = default;
+    Element(Element&&) = default;
+    // Allocator-aware constructors (all memory from the given allocator).
+    explicit Element(const allocator_type&);
+    Element(const Element&, const allocator_type&);
+    Element(Element&&, const allocator_type&);
+    Element& operator=(const Element&) = default;
+    Element& operator=(Element&&) = default;
 };
 
 // External ID types for external entities.
@@ -220,20 +489,23 @@ struct ExternalID {
     std::filesystem::path public_id;
 };
 // Expected literals indicating external IDs.
-static std::map<String, ExternalIDType> EXTERNAL_ID_TYPES {
+static const std::map<String, ExternalIDType> EXTERNAL_ID_TYPES {
     {"SYSTEM", ExternalIDType::system}, {"PUBLIC", ExternalIDType::public_}
 };
 // Returns the type of external ID if posssible.
 ExternalIDType get_external_id_type(const String&);
 // Valid public ID characters.
-static CharacterRanges PUBLIC_ID_CHARACTER_RANGES({
+static const CharacterRanges PUBLIC_ID_CHARACTER_RANGES({
     {'a', 'z'}, {'A', 'Z'}, {'0', '9'}
 }, character_ranges_comparator);
 // Too cumbersome to create separate range per valid public ID character.
-static String PUBLIC_ID_CHARACTERS = "-'()+,./:=?;!*#@$_% \u000d\u000a";
+static const String PUBLIC_ID_CHARACTERS = "-'()+,./:=?;!*#@$_% \u000d\u000a";
 // Returns true if a character is a valid public ID character.
 bool valid_public_id_character(Char);
 
+// Indicates the absence of a limit on a resource.
+constexpr std::size_t NO_LIMIT = std::numeric_limits<std::size_t>::max();
+
 // Element type info.
 enum class ElementType {empty, any, mixed, children};
 // Element appearance expectation for an element content model.
@@ -255,41 +527,45 @@ struct ElementContentModel {
 struct MixedContentModel {
     std::set<String> choices; // Accepted child tag names. Does not contain #PCDATA (implicit).
 };
+// Deterministic finite automaton accepting exactly the sequences of child element names
+// matching an element content model, so that children are validated in a single pass.
+struct ElementContentAutomaton {
+    // Index of each element name appearing in the content model. Other names match nothing.
+    std::map<String, std::size_t> symbols;
+    // Next state for each state (0 being the start) and symbol, row by row (-1 if no transition).
+    std::vector<int> transitions;
+    std::vector<bool> accepting; // Whether the children may end in each state.
+    // Why the content model cannot be validated against (not deterministic), with nothing
+    // else set - only an error once elements are validated. Empty if compiled.
+    std::string error;
+};
 // Element declaration as per <!ELEMENT ...>
 struct ElementDeclaration {
     ElementType type; // Type of element.
     String name; // Name of element.
     // Only for element type 'children'.
     ElementContentModel element_content; 
+    // Only for element type 'children' - compiled from the element content model after DTD parsing.
+    ElementContentAutomaton element_content_automaton;
     // Only for element type 'mixed'.
     MixedContentModel mixed_content;
 };
 // Symbols mapping to element counts in ECM.
 // ? -> 0 or 1, * -> 0 or more, + -> 1 or more
-static std::map<Char, ElementContentCount> ELEMENT_CONTENT_COUNT_SYMBOLS {
+static const std::map<Char, ElementContentCount> ELEMENT_CONTENT_COUNT_SYMBOLS {
     {QUESTION_MARK, ElementContentCount::zero_or_one},
     {ASTERISK, ElementContentCount::zero_or_more}, {PLUS, ElementContentCount::one_or_more}
 };
-// Min number of occurrences of an element given the count type.
-static std::map<ElementContentCount, int> ELEMENT_CONTENT_COUNT_MINIMA {
-    {ElementContentCount::one, 1}, {ElementContentCount::one_or_more, 1},
-    {ElementContentCount::zero_or_one, 0}, {ElementContentCount::zero_or_more, 0}
-};
-// Max number of occurrences of an element given the count type.
-static std::map<ElementContentCount, int> ELEMENT_CONTENT_COUNT_MAXIMA {
-    {ElementContentCount::one, 1}, {ElementContentCount::one_or_more, INT_MAX},
-    {ElementContentCount::zero_or_one, 1}, {ElementContentCount::zero_or_more, INT_MAX}
-};
 // Possible characters that can precede an element name in an ECM.
-static String ELEMENT_CONTENT_NAME_TERMINATORS = []{
+static const String ELEMENT_CONTENT_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.insert(valid_chars.end(), {
         QUESTION_MARK, ASTERISK, PLUS, COMMA, VERTICAL_BAR, RIGHT_PARENTHESIS});
     return valid_chars;
 }();
-static String PCDATA = "PCDATA";
+static const String PCDATA = "PCDATA";
 // Possible characters that can precede an element name in a MCM.
-static String MIXED_CONTENT_NAME_TERMINATORS = []{
+static const String MIXED_CONTENT_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.insert(valid_chars.end(), {VERTICAL_BAR, RIGHT_PARENTHESIS});
     return valid_chars;
@@ -301,7 +577,7 @@ enum class AttributeType {
 };
 // Literals mapping to a certain attribute type.
 // Note, enumerations will be detected from opening '(' so are not in this map.
-static std::map<String, AttributeType> ATTRIBUTE_TYPES {
+static const std::map<String, AttributeType> ATTRIBUTE_TYPES {
     {"CDATA", AttributeType::cdata}, {"ID", AttributeType::id},
     {"IDREF", AttributeType::idref}, {"IDREFS", AttributeType::idrefs},
     {"ENTITY", AttributeType::entity}, {"ENTITIES", AttributeType::entities},
@@ -312,7 +588,7 @@ static std::map<String, AttributeType> ATTRIBUTE_TYPES {
 // Fixed -> constant value (default), Relaxed -> with default, can override
 enum class AttributePresence {required, implied, fixed, relaxed};
 // Literals denoting a demanded attribute presence (after #).
-static std::map<String, AttributePresence> ATTRIBUTE_PRESENCES {
+static const std::map<String, AttributePresence> ATTRIBUTE_PRESENCES {
     {"REQUIRED", AttributePresence::required}, {"IMPLIED", AttributePresence::implied},
     {"FIXED", AttributePresence::fixed}
 };
@@ -335,23 +611,23 @@ AttributePresence get_attribute_presence(const String&);
 // Attribute names mapping to their corresponding declarations.
 typedef std::map<String, AttributeDeclaration> AttributeListDeclaration;
 // Possible characters preceding declaring the list of possible notation/enum attribute values.
-static String ENUMERATED_ATTRIBUTE_NAME_TERMINATORS = []{
+static const String ENUMERATED_ATTRIBUTE_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.insert(valid_chars.end(), {VERTICAL_BAR, RIGHT_PARENTHESIS});
     return valid_chars;
 }();
 // The xml:space special attribute allows specification of whitespace handling.
 // It is ignored by this parser, but still may exist and thus must be acknowleged.
-static String XML_SPACE = "xml:space";
+static const String XML_SPACE = "xml:space";
 // Note, xml:lang meant to be valid langauge specifier as per
 // https://datatracker.ietf.org/doc/html/rfc4646, but this is beyond the scope of this project.
 // The user is trusted that the language is correct.
 // The value of the xml:lang attribute does not affect parsing behaviour.
-static String XML_LANG = "xml:lang";
+static const String XML_LANG = "xml:lang";
 // Special built-in attribute names that would be rejected otherwise.
-static std::set<String> SPECIAL_ATTRIBUTE_NAMES {XML_SPACE, XML_LANG};
+static const std::set<String> SPECIAL_ATTRIBUTE_NAMES {XML_SPACE, XML_LANG};
 // For xml:space attributes, one or both of default/preserve must be in the enumeration.
-static std::set<std::set<String>> XML_SPACE_ENUMS {
+static const std::set<std::set<String>> XML_SPACE_ENUMS {
     {"default", "preserve"}, {"default"}, {"preserve"}
 };
 
@@ -369,10 +645,30 @@ Char parse_character_reference(const String&);
 // Expand all character entities in a given string, returning the resulting string.
 String expand_character_references(const String&);
 
+// Maximum size in bytes of the expanded replacement text of a general entity, whatever
+// the options. Longer replacement text is read as it is referenced instead (never expanded).
+constexpr std::size_t MAX_GENERAL_ENTITY_EXPANSION = 4096;
+
+// Replacement text of an internal general entity, expanded in full (including any entities
+// it references) on first reference. Only usable where the text is plain - no markup or
+// anything else that must be checked as it is parsed - so it can be taken in bulk.
+struct GeneralEntityExpansion {
+    bool expanded = false; // Expansion attempted (entities are only expanded once).
+    bool in_content = false; // Text can be taken in bulk in content.
+    bool in_attribute_value = false; // Text can be taken in bulk in attribute values.
+    String text; // Expanded text in content.
+    String attribute_text; // Expanded text in attribute values (literal whitespace as spaces).
+    // End of the last character from a character reference in the text (0 if none).
+    std::size_t character_references_end = 0;
+    bool whitespace_only = true; // Text is only literal whitespace.
+};
+
 // Represents a general entity (one for use in the main data).
 struct GeneralEntity : public Entity {
     bool is_unparsed = false; // General entities can also be unparsed (points to non-XML data).
     String notation_name; // The name of the notation (only if unparsed).
+    // Pre-expanded replacement text (internal only), filled in on first reference.
+    mutable GeneralEntityExpansion expansion;
     GeneralEntity() = default;
     GeneralEntity(const String&);
 };
@@ -389,6 +685,31 @@ struct NotationDeclaration {
     std::filesystem::path public_id; // Corresponding public ID if available.
 };
 
+// Small integer identifying an interned name (its index in the name table).
+typedef int NameId;
+// Indicates a name that is not in the name table.
+constexpr NameId NO_NAME = -1;
+
+// Table of distinct names, each given a small integer ID in the order first interned.
+// Names are looked up by hash, so a name only needs to be hashed once to find
+// everything stored by its ID (e.g. in vectors), rather than searched for in several maps.
+class NameTable {
+    std::deque<String> names; // Interned names by ID (a deque, so names never move).
+    std::unordered_map<std::string_view, NameId> ids; // ID of each name (viewing the names).
+    public:
+        NameTable() = default;
+        NameTable(const NameTable&) = delete;
+        NameTable& operator=(const NameTable&) = delete;
+        // Returns the ID of a name, interning it if not already interned.
+        NameId intern(std::string_view);
+        // Returns the ID of a name (NO_NAME if not interned).
+        NameId find(std::string_view) const;
+        // Returns the name with the given ID.
+        const String& get_name(NameId) const;
+        // Returns the number of interned names.
+        std::size_t size() const;
+};
+
 // Map of element declarations (element name to declaration).
 typedef std::map<String, ElementDeclaration> ElementDeclarations;
 // Map of attribute list declarations (element name to declaration).
@@ -400,12 +721,12 @@ typedef std::map<String, ParameterEntity> ParameterEntities;
 // Map of notation declaration (name to declaration).
 typedef std::map<String, NotationDeclaration> NotationDeclarations;
 // Name, value pairs for built-in general entities as per the standard.
-static GeneralEntities BUILT_IN_GENERAL_ENTITIES {
+static const GeneralEntities BUILT_IN_GENERAL_ENTITIES {
     {"lt", String("&#60;")}, {"gt", String("&#62;")}, {"amp", String("&#38;")},
     {"apos", String("&#39;")}, {"quot", String("&#34;")}
 };
 // The built-in entities that MUST be double escaped if explicitly declared.
-static std::set<String> BUILT_IN_GENERAL_ENTITIES_MANDATORY_DOUBLE_ESCAPE {"lt", "amp"};
+static const std::set<String> BUILT_IN_GENERAL_ENTITIES_MANDATORY_DOUBLE_ESCAPE {"lt", "amp"};
 // Stores info about the DOCTYPE declaration, if any.
 // A DTD is optional - if not provided, assume zero restrictions on actual elements.
 struct DoctypeDeclaration {
@@ -420,14 +741,24 @@ struct DoctypeDeclaration {
     ParameterEntities parameter_entities; // Parameter entities (name->object).
     NotationDeclarations notation_declarations; // Notation declarations map (name->decl).
 };
+// Expands the replacement text of an internal general entity where possible (if not already),
+// returning the expansion. Entities declared externally are not expanded into others if the
+// document is standalone. Replacement text longer than the maximum size is left unexpanded.
+// Not thread-safe until expanded - the expansion is cached in the entity.
+const GeneralEntityExpansion& expand_general_entity(
+    const GeneralEntity&, const GeneralEntities&, bool standalone,
+    std::size_t max_size = MAX_GENERAL_ENTITY_EXPANSION);
+// Discards the expansions of all general entities, so that each is expanded afresh on first
+// reference (e.g. once declarations copied from elsewhere are complete).
+void reset_general_entity_expansions(const GeneralEntities&);
 // Characters which may signal end of root name in DTD.
-static String DOCTYPE_DECLARATION_ROOT_NAME_TERMINATORS = []{
+static const String DOCTYPE_DECLARATION_ROOT_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.insert(valid_chars.end(), {LEFT_SQUARE_BRACKET, RIGHT_ANGLE_BRACKET});
     return valid_chars;
 }();
 // Characters which may signal end of a conditional section type name (INCLUDE/IGNORE).
-static String CONDITIONAL_TYPE_NAME_TERMINATORS = []{
+static const String CONDITIONAL_TYPE_NAME_TERMINATORS = []{
     String valid_chars = WHITESPACE;
     valid_chars.push_back(LEFT_SQUARE_BRACKET);
     return valid_chars;
@@ -437,18 +768,30 @@ static String CONDITIONAL_TYPE_NAME_TERMINATORS = []{
 // For some reason, URLs are detected as relative paths which is problematic.
 // Therefore detecting URLs explicitly allows for special treatment.
 // This XML parser does not support fetching resources over the network, only file system.
-static std::set<String> RECOGNISED_PROTOCOLS {"http://", "https://"};
+static const std::set<String> RECOGNISED_PROTOCOLS {"http://", "https://"};
 // Path starts with one of the recognised URL protocols.
 bool is_url_resource(const std::string&);
 
 // Ultimate document class - contains all information about the XML document.
 struct Document {
+    // Memory resource all elements of the document are allocated from (null if the default heap).
+    // Declared first so that it outlives everything allocated from it.
+    std::shared_ptr<std::pmr::memory_resource> arena = nullptr;
     String version = "1.0"; // Document version as per XML declaration (1.0 otherwise).
     String encoding = "utf-8"; // Encoding as per XML declaration, in lower-case.
     bool standalone = false; // Indicates whether document is 'standalone' (false by default).
     DoctypeDeclaration doctype_declaration; // Corresponding doctype declaration of document.
     Element root; // The root (overarching) element.
     std::vector<ProcessingInstruction> processing_instructions; // PIs that appear in toplevel scope.
+    Document() = default;
+    Document(const Document&) = default;
+    Document(Document&&) = default;
+    // Document with all elements allocated from the given memory resource (if not null).
+    explicit Document(std::shared_ptr<std::pmr::memory_resource>);
+    // Assignment replaces the document entirely, including the arena (if any),
+    // so that elements never outlive the arena they are allocated from.
+    Document& operator=(const Document&);
+    Document& operator=(Document&&);
 };
 
 }
\ No newline at end of file
@@ -1,10 +1,118 @@
 #include "validate.h"
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
 #include <sstream>
 
 
 namespace xml {
 
+DtdIndex::DtdIndex(const DoctypeDeclaration& dtd) : dtd(dtd) {
+    // Content model of each element declared with element content (by element name).
+    std::vector<std::pair<const String*, const ElementContentAutomaton*>> automata;
+    for (const auto& [name, ed] : dtd.element_declarations) {
+        this->names.intern(name);
+        for (const String& choice : ed.mixed_content.choices) {
+            this->names.intern(choice);
+        }
+        if (ed.type == ElementType::children) {
+            const ElementContentAutomaton* automaton = &ed.element_content_automaton;
+            if (automaton->accepting.empty() && automaton->error.empty()) {
+                // Declaration not from a parsed DTD - compile on demand.
+                automaton = &this->compiled_automata.emplace_back(
+                    compile_element_content_model(ed.element_content));
+            }
+            for (const auto& [symbol_name, _] : automaton->symbols) {
+                this->names.intern(symbol_name);
+            }
+            automata.emplace_back(&name, automaton);
+        }
+    }
+    for (const auto& [name, _] : dtd.attribute_list_declarations) {
+        this->names.intern(name);
+    }
+    this->elements.resize(this->names.size());
+    for (const auto& [name, ed] : dtd.element_declarations) {
+        ElementEntry& entry = this->elements[this->names.find(name)];
+        entry.declaration = &ed;
+        for (const String& choice : ed.mixed_content.choices) {
+            entry.choices.push_back(this->names.find(choice));
+        }
+        std::sort(entry.choices.begin(), entry.choices.end());
+    }
+    for (const auto& [name, automaton] : automata) {
+        ElementEntry& entry = this->elements[this->names.find(*name)];
+        entry.automaton = automaton;
+        for (const auto& [symbol_name, symbol] : automaton->symbols) {
+            entry.symbols.emplace_back(this->names.find(symbol_name), symbol);
+        }
+        std::sort(entry.symbols.begin(), entry.symbols.end());
+    }
+    for (const auto& [name, ald] : dtd.attribute_list_declarations) {
+        ElementEntry& entry = this->elements[this->names.find(name)];
+        entry.attribute_list_declaration = &ald;
+        for (const auto& [attribute_name, ad] : ald) {
+            if (ad.type == AttributeType::id) {
+                // Only one ID attribute expected per element type.
+                entry.id_attribute = &attribute_name;
+                break;
+            }
+        }
+    }
+}
+
+const DoctypeDeclaration& DtdIndex::get_dtd() const {
+    return this->dtd;
+}
+
+NameId DtdIndex::find(std::string_view name) const {
+    return this->names.find(name);
+}
+
+const ElementDeclaration* DtdIndex::get_element_declaration(NameId id) const {
+    return id != NO_NAME ? this->elements[id].declaration : nullptr;
+}
+
+const AttributeListDeclaration* DtdIndex::get_attribute_list_declaration(NameId id) const {
+    return id != NO_NAME ? this->elements[id].attribute_list_declaration : nullptr;
+}
+
+const String* DtdIndex::get_id_attribute(NameId id) const {
+    return id != NO_NAME ? this->elements[id].id_attribute : nullptr;
+}
+
+int DtdIndex::next_state(NameId id, int state, NameId child_id) const {
+    const ElementEntry& entry = this->elements[id];
+    auto symbol = std::lower_bound(
+        entry.symbols.begin(), entry.symbols.end(), std::pair<NameId, std::size_t>(child_id, 0));
+    if (symbol == entry.symbols.end() || symbol->first != child_id) {
+        // Names not in the DTD (NO_NAME) never match.
+        return -1;
+    }
+    return entry.automaton->transitions[state * entry.automaton->symbols.size() + symbol->second];
+}
+
+void DtdIndex::check_content_model(NameId id) const {
+    const std::string& error = this->elements[id].automaton->error;
+    if (!error.empty()) {
+        throw XmlError(error + ": " + std::string(this->elements[id].declaration->name));
+    }
+}
+
+bool DtdIndex::accepting(NameId id, int state) const {
+    return this->elements[id].automaton->accepting[state];
+}
+
+bool DtdIndex::allows_child(NameId id, NameId child_id) const {
+    const std::vector<NameId>& choices = this->elements[id].choices;
+    return child_id != NO_NAME && std::binary_search(choices.begin(), choices.end(), child_id);
+}
+
 void validate_document(
     const Document& document, bool validate_elements, bool validate_attributes_
 ) {
@@ -12,28 +120,28 @@ void validate_document(
         // Root name must match the root name in the DTD.
         throw XmlError("Root element name does not match declared root element name in DTD");
     }
+    DtdIndex index(document.doctype_declaration);
     if (validate_elements) {
         // Validate root element and all its children (recursively).
-        validate_element(
-            document.root, document.doctype_declaration.element_declarations, document.standalone);
+        validate_element(document.root, index, document.standalone);
     }
     if (validate_attributes_) {
         // Validate root element attributes and all attributes of children (recursively).
         std::set<String> ids;
-        parse_and_validate_ids(document.root, document.doctype_declaration, ids);
-        validate_attributes(document.root, document.doctype_declaration, ids);
+        parse_and_validate_ids(document.root, index, ids);
+        validate_attributes(document.root, index, ids);
     }
 }
 
-void validate_element(
-    const Element& element, const ElementDeclarations& element_declarations, bool standalone
-) {
-    if (!element_declarations.count(element.tag.name)) {
+// Validates the content of a single element (not its child elements).
+static void validate_element_node(const Element& element, const DtdIndex& index, bool standalone) {
+    NameId id = index.find(element.tag.name);
+    const ElementDeclaration* ed = index.get_element_declaration(id);
+    if (ed == nullptr) {
         // Element not declared at all.
         throw XmlError("Undeclared element: " + std::string(element.tag.name));
     }
-    ElementDeclaration ed = element_declarations.at(element.tag.name);
-    switch (ed.type) {
+    switch (ed->type) {
         case ElementType::any:
             // No content restriction whatsoever.
             break;
@@ -45,62 +153,160 @@ void validate_element(
             }
             break;
         case ElementType::children:
-            validate_element_content(element, ed.element_content, standalone);
+            validate_element_content(element, index, id, standalone);
             break;
         case ElementType::mixed:
-            validate_mixed_content(element, ed.mixed_content);
+            validate_mixed_content(element, index, id);
             break;
     }
+}
+
+void validate_element(const Element& element, const DtdIndex& index, bool standalone) {
+    validate_element_node(element, index, standalone);
     // Validate all child elements in the same way.
     for (const Element& child : element.children) {
-        validate_element(child, element_declarations, standalone);
+        validate_element(child, index, standalone);
     }
 }
 
-bool valid_element_content_helper(
-    const Element& element, const ElementContentModel& ecm, std::size_t& pos
+// Positions (name leaves) of a content model, as needed for building the automaton.
+struct ContentModelPositions {
+    std::size_t max_size; // Maximum number of positions (checked as each one is added).
+    std::vector<std::size_t> symbols; // Symbol of the element name at each position.
+    std::vector<std::set<std::size_t>> follow; // Positions which may directly follow each position.
+};
+
+// Properties of a (sub) content model, in terms of its positions.
+struct ContentModelSummary {
+    bool nullable; // Whether the model can match no elements at all.
+    std::set<std::size_t> first; // Positions which can match the first element.
+    std::set<std::size_t> last; // Positions which can match the last element.
+};
+
+// Recursively gathers the positions of a content model (with what may follow each one),
+// returning the summary of the model.
+static ContentModelSummary summarise_content_model(
+    const ElementContentModel& ecm, ContentModelPositions& positions,
+    std::map<String, std::size_t>& symbols
 ) {
-    int min_count = ELEMENT_CONTENT_COUNT_MINIMA.at(ecm.count);
-    int max_count = ELEMENT_CONTENT_COUNT_MAXIMA.at(ecm.count);
-    int count = 0;
+    ContentModelSummary summary;
     if (ecm.is_name) {
-        // Element name matching, in some way can be considered the base case.
-        while (
-            count < max_count && pos < element.children.size() 
-            && element.children.at(pos).tag.name == ecm.name
-        ) {
-            count++;
-            pos++;
+        std::size_t position = positions.symbols.size();
+        if (position == positions.max_size) {
+            throw XmlError("Content model size limit exceeded");
         }
+        std::size_t symbol = symbols.emplace(ecm.name, symbols.size()).first->second;
+        positions.symbols.push_back(symbol);
+        positions.follow.emplace_back();
+        summary.nullable = false;
+        summary.first = summary.last = {position};
     } else {
-        std::size_t previous_pos = pos;
-        // Function preparing for call for recursive element content validation.
-        auto recursive_call = [&](const ElementContentModel& child_ecm) {
-            return valid_element_content_helper(element, child_ecm, pos);
-        };
-        auto can_proceed = [&]{
-            if (ecm.is_sequence) {
-                // Sequence - full matches required.
-                return std::all_of(ecm.parts.begin(), ecm.parts.end(), recursive_call);
+        std::vector<ContentModelSummary> parts;
+        parts.reserve(ecm.parts.size());
+        for (const ElementContentModel& part : ecm.parts) {
+            parts.push_back(summarise_content_model(part, positions, symbols));
+        }
+        if (ecm.is_sequence) {
+            // Sequence - first/last as far into the sequence as the parts can be skipped.
+            summary.nullable = std::all_of(parts.begin(), parts.end(), [](const ContentModelSummary& part) {
+                return part.nullable;
+            });
+            for (const ContentModelSummary& part : parts) {
+                summary.first.insert(part.first.begin(), part.first.end());
+                if (!part.nullable) {
+                    break;
+                }
             }
-            // Choice - any (or first) match can be accepted.
-            return std::any_of(ecm.parts.begin(), ecm.parts.end(), recursive_call);
-        };
-        while (count < max_count && can_proceed()) {
-            if (pos == previous_pos) {
-                // DEADLOCK - cannot proceed / infinite count.
-                // Example of a potential deadlock: (Name?)* - can match 0 or more infinite times.
-                count = INT_MAX;
-                break;
+            for (auto part = parts.rbegin(); part != parts.rend(); ++part) {
+                summary.last.insert(part->last.begin(), part->last.end());
+                if (!part->nullable) {
+                    break;
+                }
+            }
+            // The end of a part may be followed by the start of the next part (or later parts
+            // if those in between can be skipped).
+            for (std::size_t i = 0; i < parts.size(); ++i) {
+                for (std::size_t j = i + 1; j < parts.size(); ++j) {
+                    for (std::size_t position : parts[i].last) {
+                        positions.follow[position].insert(parts[j].first.begin(), parts[j].first.end());
+                    }
+                    if (!parts[j].nullable) {
+                        break;
+                    }
+                }
+            }
+        } else {
+            // Choice - any one part.
+            summary.nullable = std::any_of(parts.begin(), parts.end(), [](const ContentModelSummary& part) {
+                return part.nullable;
+            });
+            for (const ContentModelSummary& part : parts) {
+                summary.first.insert(part.first.begin(), part.first.end());
+                summary.last.insert(part.last.begin(), part.last.end());
+            }
+        }
+    }
+    if (ecm.count == ElementContentCount::zero_or_one || ecm.count == ElementContentCount::zero_or_more) {
+        summary.nullable = true;
+    }
+    if (ecm.count == ElementContentCount::zero_or_more || ecm.count == ElementContentCount::one_or_more) {
+        // Repetition - the end of the model may be followed by its start again.
+        for (std::size_t position : summary.last) {
+            positions.follow[position].insert(summary.first.begin(), summary.first.end());
+        }
+    }
+    return summary;
+}
+
+ElementContentAutomaton compile_element_content_model(const ElementContentModel& ecm, std::size_t max_size) {
+    ElementContentAutomaton automaton;
+    ContentModelPositions positions;
+    positions.max_size = max_size;
+    ContentModelSummary summary = summarise_content_model(ecm, positions, automaton.symbols);
+    std::size_t symbol_count = automaton.symbols.size();
+    // XML only allows deterministic content models, where each child element can only match
+    // one position given the children before it. So each state is simply the position the
+    // children so far ended at (the position automaton), with the start state first.
+    std::size_t state_count = positions.symbols.size() + 1;
+    automaton.transitions.assign(state_count * symbol_count, -1);
+    automaton.accepting.assign(state_count, false);
+    automaton.accepting[0] = summary.nullable;
+    for (std::size_t state = 0; state < state_count; ++state) {
+        const std::set<std::size_t>& follow = state == 0 ? summary.first : positions.follow[state - 1];
+        for (std::size_t next_position : follow) {
+            int& transition = automaton.transitions[state * symbol_count + positions.symbols[next_position]];
+            if (transition != -1) {
+                // Two positions for the same element name - reported if validated against.
+                ElementContentAutomaton non_deterministic;
+                non_deterministic.error = "Element content model must be deterministic";
+                return non_deterministic;
             }
-            previous_pos = pos;
-            count++;
+            transition = next_position + 1;
         }
     }
-    return count >= min_count && count <= max_count;
+    for (std::size_t position : summary.last) {
+        automaton.accepting[position + 1] = true;
+    }
+    return automaton;
 }
 
-void validate_element_content(const Element& element, const ElementContentModel& ecm, bool standalone) {
+void compile_element_content_models(DoctypeDeclaration& dtd, std::size_t max_size) {
+    for (auto& [name, ed] : dtd.element_declarations) {
+        // Declarations from a compiled DTD already have their automaton.
+        if (
+            ed.type == ElementType::children && ed.element_content_automaton.accepting.empty()
+            && ed.element_content_automaton.error.empty()
+        ) {
+            try {
+                ed.element_content_automaton = compile_element_content_model(ed.element_content, max_size);
+            } catch (const XmlError& e) {
+                throw XmlError(std::string(e.what()) + ": " + std::string(name));
+            }
+        }
+    }
+}
+
+void validate_element_content(const Element& element, const DtdIndex& index, NameId id, bool standalone) {
     if (standalone && !element.text.empty()) {
         // Must not be standalone if whitespace occurs directly within any instance of those types
         throw XmlError(
@@ -112,18 +318,26 @@ void validate_element_content(const Element& element, const ElementContentModel&
             "Element with element content must have "
             "child elements only: " + std::string(element.tag.name));
     }
-    std::size_t pos = 0;
-    // Note: must also ensure all elements covered (hence pos must equal child count in the end).
-    if (!valid_element_content_helper(element, ecm, pos) || pos < element.children.size()) {
+    index.check_content_model(id);
+    // Single pass over the children, which must all be matched with the automaton then accepting.
+    int state = 0;
+    for (const Element& child : element.children) {
+        state = index.next_state(id, state, index.find(child.tag.name));
+        if (state == -1) {
+            throw XmlError(
+                "Element did not match element content model: " + std::string(element.tag.name));
+        }
+    }
+    if (!index.accepting(id, state)) {
         throw XmlError(
             "Element did not match element content model: " + std::string(element.tag.name));
     }
 }
 
-void validate_mixed_content(const Element& element, const MixedContentModel& mcm) {
+void validate_mixed_content(const Element& element, const DtdIndex& index, NameId id) {
     // Simply ensure all child elements have a permitted name.
     if (!std::all_of(element.children.begin(), element.children.end(), [&](const Element& child) {
-        return mcm.choices.count(child.tag.name);
+        return index.allows_child(id, index.find(child.tag.name));
     })) {
         throw XmlError("Element did not match mixed content model: " + std::string(element.tag.name));
     }
@@ -220,148 +434,419 @@ void validate_default_attribute_value(
     }
 }
 
-void validate_attributes(
-    const Element& element, const DoctypeDeclaration& dtd, const std::set<String>& ids
+void resolve_id_reference(const IdReference& reference, const std::set<String>& ids) {
+    bool resolved = true;
+    if (reference.multiple) {
+        String idref;
+        for (char c : reference.value) {
+            if (c == SPACE) {
+                resolved = resolved && ids.count(idref);
+                idref.clear();
+            } else {
+                idref.push_back(c);
+            }
+        }
+        resolved = resolved && ids.count(idref);
+    } else {
+        resolved = ids.count(reference.value);
+    }
+    if (!resolved) {
+        throw XmlError(
+            "Value error for attribute '" + std::string(reference.attribute_name) +
+            "' of element " + std::string(reference.element_name) + ": " + (reference.multiple
+                ? "All IDREFS values must match an ID value in the document"
+                : "IDREF value must match an ID value in the document"));
+    }
+}
+
+void validate_element_attributes(
+    const String& element_name, NameId id, const Attributes& attributes, const DtdIndex& index,
+    const std::set<String>* ids, std::vector<IdReference>* id_references
 ) {
-    if (!dtd.attribute_list_declarations.count(element.tag.name)) {
+    const AttributeListDeclaration* ald = index.get_attribute_list_declaration(id);
+    if (ald == nullptr) {
         // No attlist declaration - element must have no attributes or else error.
-        if (!element.tag.attributes.empty()) {
+        if (!attributes.empty()) {
             throw XmlError(
-                "Element with attribute must have ATTLIST declaration: " + std::string(element.tag.name));
+                "Element with attribute must have ATTLIST declaration: " + std::string(element_name));
         }
-    } else {
-        const AttributeListDeclaration& ald = dtd.attribute_list_declarations.at(element.tag.name);
-        const Attributes& attributes = element.tag.attributes;
-        // Number of registered attributes as per the attribute list declaration.
-        int registered = 0;
-        auto is_unparsed_entity = [&dtd](const String& value) {
-            return dtd.general_entities.count(value) && dtd.general_entities.at(value).is_unparsed;
-        };
-        for (const auto& [attribute_name, ad] : ald) {
-            if (!attributes.count(attribute_name)) {
-                if (ad.presence == AttributePresence::implied) {
-                    // Implied allows attribute to be omitted.
-                    continue;
-                }
-                // Attribute not in element and not IMPLIED => REQUIRED failed => invalid.
+        return;
+    }
+    const DoctypeDeclaration& dtd = index.get_dtd();
+    // Number of registered attributes as per the attribute list declaration.
+    int registered = 0;
+    auto is_unparsed_entity = [&dtd](const String& value) {
+        auto entity_it = dtd.general_entities.find(value);
+        return entity_it != dtd.general_entities.end() && entity_it->second.is_unparsed;
+    };
+    // Declarations and attributes are both in name order, so are matched up in a single pass.
+    auto attribute_it = attributes.begin();
+    for (const auto& [attribute_name, ad] : *ald) {
+        while (attribute_it != attributes.end() && attribute_it->first < attribute_name) {
+            // Undeclared attribute (counted below).
+            ++attribute_it;
+        }
+        if (attribute_it == attributes.end() || attribute_it->first != attribute_name) {
+            if (ad.presence == AttributePresence::implied) {
+                // Implied allows attribute to be omitted.
+                continue;
+            }
+            // Attribute not in element and not IMPLIED => REQUIRED failed => invalid.
+            throw XmlError(
+                "REQUIRED attribute '" + std::string(attribute_name) +
+                "' not specified in element: " + std::string(element_name));
+        }
+        registered++;
+        const String& value = attribute_it->second;
+        if (ad.presence == AttributePresence::fixed) {
+            // The attribute must always have the default value.
+            if (value != ad.default_value) {
                 throw XmlError(
-                    "REQUIRED attribute '" + std::string(attribute_name) +
-                    "' not specified in element: " + std::string(element.tag.name));
+                    "FIXED attribute '" + std::string(attribute_name) +
+                    "' does not match default value in element: " + std::string(element_name));
             }
-            registered++;
-            const String& value = attributes.at(attribute_name);
-            if (ad.presence == AttributePresence::fixed) {
-                // The attribute must always have the default value.
-                if (value != ad.default_value) {
-                    throw XmlError(
-                        "FIXED attribute '" + std::string(attribute_name) +
-                        "' does not match default value in element: " + std::string(element.tag.name));
-                }
-            } else {
-                // Need to check basic validity: based on default value validation.
-                // Only required if not FIXED (Fixed default value already validated).
-                try {
-                    validate_default_attribute_value(ad, dtd, &value);
-                } catch (const XmlError& e) {
-                    throw XmlError(
-                        "Value error for attribute '" + std::string(ad.name) +
-                        "' of element " + std::string(element.tag.name) + ": " + e.what());
+        } else {
+            // Need to check basic validity: based on default value validation.
+            // Only required if not FIXED (Fixed default value already validated).
+            try {
+                validate_default_attribute_value(ad, dtd, &value);
+            } catch (const XmlError& e) {
+                throw XmlError(
+                    "Value error for attribute '" + std::string(ad.name) +
+                    "' of element " + std::string(element_name) + ": " + e.what());
+            }
+        }
+        // Further validation now that this a real attribute value.
+        // If error info not empty after, throw an error.
+        std::string error_details;
+        switch (ad.type) {
+            case AttributeType::idref:
+            case AttributeType::idrefs: {
+                IdReference reference {element_name, attribute_name, value, ad.type == AttributeType::idrefs};
+                if (ids != nullptr) {
+                    resolve_id_reference(reference, *ids);
+                } else {
+                    // Not all IDs known yet.
+                    id_references->push_back(std::move(reference));
                 }
+                break;
             }
-            // Further validation now that this a real attribute value.
-            // If error info not empty after, throw an error.
-            std::string error_details;
-            switch (ad.type) {
-                case AttributeType::idref:
-                    if (!ids.count(value)) {
-                        error_details = "IDREF value must match an ID value in the document";
-                    }
-                    break;
-                case AttributeType::idrefs: {
-                    String idref;
-                    for (Char c : value) {
-                        if (c == SPACE) {
-                            if (!ids.count(idref)) {
-                                error_details =
-                                    "All IDREFS values must match an ID value in the document";
-                                goto done;
-                            }
-                            idref.clear();
-                        } else {
-                            idref.push_back(c);
-                        }
-                    }
-                    if (!ids.count(idref)) {
-                        error_details = "All IDREFS values must match an ID value in the document";
-                    }
-                    break;
+            case AttributeType::entity:
+                if (!is_unparsed_entity(value)) {
+                    error_details = "ENTITY value must match the name of a declared unparsed entity";
                 }
-                case AttributeType::entity:
-                    if (!is_unparsed_entity(value)) {
-                        error_details = "ENTITY value must match the name of a declared unparsed entity";
-                    }
-                    break;
-                case AttributeType::entities: {
-                    // Must all match the name of declared unparsed entity.
-                    String unparsed_entity;
-                    for (Char c : value) {
-                        if (c == SPACE) {
-                            if (!is_unparsed_entity(unparsed_entity)) {
-                                error_details =
-                                    "All ENTITIES values must match "
-                                    "the name of a declared unparsed entity";
-                                goto done;
-                            }
-                            unparsed_entity.clear();
-                        } else {
-                            unparsed_entity.push_back(c);
+                break;
+            case AttributeType::entities: {
+                // Must all match the name of declared unparsed entity.
+                String unparsed_entity;
+                for (char c : value) {
+                    if (c == SPACE) {
+                        if (!is_unparsed_entity(unparsed_entity)) {
+                            error_details =
+                                "All ENTITIES values must match "
+                                "the name of a declared unparsed entity";
+                            goto done;
                         }
+                        unparsed_entity.clear();
+                    } else {
+                        unparsed_entity.push_back(c);
                     }
-                    if (!is_unparsed_entity(unparsed_entity)) {
-                        error_details =
-                            "All ENTITIES values must match the name of a declared unparsed entity";
-                    }
-                    break;
                 }
-            }
-            done:
-            if (!error_details.empty()) {
-                throw XmlError(
-                    "Value error for attribute '" + std::string(ad.name) +
-                    "' of element " + std::string(element.tag.name) + ": " + error_details);
+                if (!is_unparsed_entity(unparsed_entity)) {
+                    error_details =
+                        "All ENTITIES values must match the name of a declared unparsed entity";
+                }
+                break;
             }
         }
-        if (registered < attributes.size()) {
-            // Excess attributes that are not declared. Invalid.
-            throw XmlError("Undeclared attributes found in element: " + std::string(element.tag.name));
+        done:
+        if (!error_details.empty()) {
+            throw XmlError(
+                "Value error for attribute '" + std::string(ad.name) +
+                "' of element " + std::string(element_name) + ": " + error_details);
         }
     }
+    if (registered < attributes.size()) {
+        // Excess attributes that are not declared. Invalid.
+        throw XmlError("Undeclared attributes found in element: " + std::string(element_name));
+    }
+}
+
+void validate_attributes(const Element& element, const DtdIndex& index, const std::set<String>& ids) {
+    validate_element_attributes(
+        element.tag.name, index.find(element.tag.name), element.tag.attributes, index, &ids);
     // Recursively validate attributes of children.
     for (const Element& child : element.children) {
-        validate_attributes(child, dtd, ids);
+        validate_attributes(child, index, ids);
     }
 }
 
-void parse_and_validate_ids(const Element& element, const DoctypeDeclaration& dtd, std::set<String>& ids) {
-    if (dtd.attribute_list_declarations.count(element.tag.name)) {
-        for (const auto& [attribute_name, ad] : dtd.attribute_list_declarations.at(element.tag.name)) {
-            if (ad.type == AttributeType::id) {
-                if (element.tag.attributes.count(attribute_name)) {
-                    const String& id = element.tag.attributes.at(attribute_name);
-                    if (ids.count(id)) {
-                        // Repeated ID values in document forbidden.
-                        throw XmlError("Repeated ID value: '" + std::string(id) + "'");
-                    }
-                    ids.insert(id);
-                }
-                // Only one ID attribute expected per element type.
-                break;
-            }
+void add_id(NameId id, const Attributes& attributes, const DtdIndex& index, std::set<String>& ids) {
+    const String* id_attribute = index.get_id_attribute(id);
+    if (id_attribute == nullptr) {
+        return;
+    }
+    auto attribute_it = attributes.find(*id_attribute);
+    if (attribute_it != attributes.end()) {
+        const String& id_value = attribute_it->second;
+        if (!ids.insert(id_value).second) {
+            // Repeated ID values in document forbidden.
+            throw XmlError("Repeated ID value: '" + std::string(id_value) + "'");
         }
     }
+}
+
+void parse_and_validate_ids(const Element& element, const DtdIndex& index, std::set<String>& ids) {
+    add_id(index.find(element.tag.name), element.tag.attributes, index, ids);
     // Recursively traverse children to find more ID values.
     for (const Element& child : element.children) {
-        parse_and_validate_ids(child, dtd, ids);
+        parse_and_validate_ids(child, index, ids);
+    }
+}
+
+// Units of work per thread in parallel validation (balancing uneven subtrees).
+constexpr std::size_t VALIDATION_UNITS_PER_THREAD = 4;
+// Maximum depth of single elements above the subtrees in parallel validation.
+constexpr int MAX_VALIDATION_SPLIT_DEPTH = 8;
+
+// Part of a document validated by a single thread in parallel validation -
+// either an element alone, or an element and all its descendants.
+struct ValidationUnit {
+    const Element* element; // Element (root of the subtree if a subtree).
+    bool subtree; // Includes all descendants of the element.
+};
+
+// Adds the units of an element in document order - subtrees at the given depth below it,
+// and single elements above.
+static void add_validation_units(const Element& element, int depth, std::vector<ValidationUnit>& units) {
+    units.push_back({&element, depth == 0});
+    if (depth > 0) {
+        for (const Element& child : element.children) {
+            add_validation_units(child, depth - 1, units);
+        }
+    }
+}
+
+// Splits a document into units in document order, going down levels of the tree
+// until there are enough subtrees to share between the threads.
+static std::vector<ValidationUnit> split_validation_units(const Element& root, std::size_t target) {
+    int depth = 0;
+    std::vector<const Element*> level {&root};
+    while (level.size() < target && depth < MAX_VALIDATION_SPLIT_DEPTH) {
+        std::vector<const Element*> next_level;
+        for (const Element* element : level) {
+            for (const Element& child : element->children) {
+                next_level.push_back(&child);
+            }
+        }
+        if (next_level.empty()) {
+            break;
+        }
+        level = std::move(next_level);
+        ++depth;
+    }
+    std::vector<ValidationUnit> units;
+    add_validation_units(root, depth, units);
+    return units;
+}
+
+// Runs a check on every unit, the units taken in turn by the threads (check given the thread index).
+// The units together are in document order, so the error of the first unit to fail
+// is the error serial validation would have thrown.
+static void check_validation_units(
+    const std::vector<ValidationUnit>& units, unsigned threads,
+    const std::function<void(const ValidationUnit&, unsigned)>& check
+) {
+    std::vector<std::exception_ptr> errors(units.size());
+    std::atomic<std::size_t> next_unit = 0;
+    // No need to check units after one that has already failed.
+    std::atomic<std::size_t> first_error = units.size();
+    auto check_units = [&](unsigned thread) {
+        for (std::size_t i; (i = next_unit++) < first_error;) {
+            try {
+                check(units[i], thread);
+            } catch (...) {
+                errors[i] = std::current_exception();
+                std::size_t error = first_error;
+                while (i < error && !first_error.compare_exchange_weak(error, i));
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < std::min<std::size_t>(threads, units.size()); ++i) {
+        workers.emplace_back(check_units, i);
+    }
+    check_units(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (first_error < units.size()) {
+        std::rethrow_exception(errors[first_error]);
+    }
+}
+
+void validate_document(
+    const Document& document, bool validate_elements, bool validate_attributes_, unsigned threads
+) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    std::vector<ValidationUnit> units;
+    if (threads > 1 && (validate_elements || validate_attributes_)) {
+        units = split_validation_units(document.root, threads * VALIDATION_UNITS_PER_THREAD);
+    }
+    if (units.size() < 2) {
+        // Nothing to share between threads.
+        validate_document(document, validate_elements, validate_attributes_);
+        return;
+    }
+    if (document.root.tag.name != document.doctype_declaration.root_name) {
+        throw XmlError("Root element name does not match declared root element name in DTD");
+    }
+    DtdIndex index(document.doctype_declaration);
+    // Elements validated and IDs collected (into a set per thread) in the same pass.
+    std::vector<std::set<String>> thread_ids(validate_attributes_ ? threads : 0);
+    std::atomic<bool> repeated_id = false;
+    check_validation_units(units, threads, [&](const ValidationUnit& unit, unsigned thread) {
+        if (validate_elements) {
+            if (unit.subtree) {
+                validate_element(*unit.element, index, document.standalone);
+            } else {
+                validate_element_node(*unit.element, index, document.standalone);
+            }
+        }
+        if (validate_attributes_ && !repeated_id) {
+            try {
+                if (unit.subtree) {
+                    parse_and_validate_ids(*unit.element, index, thread_ids[thread]);
+                } else {
+                    add_id(index.find(unit.element->tag.name), unit.element->tag.attributes, index, thread_ids[thread]);
+                }
+            } catch (const XmlError&) {
+                // Not necessarily the first repeated ID in the document.
+                repeated_id = true;
+            }
+        }
+    });
+    if (!validate_attributes_) {
+        return;
+    }
+    std::set<String> ids = std::move(thread_ids.front());
+    for (std::set<String>& other_ids : thread_ids) {
+        // Any IDs left behind are repeated across threads.
+        ids.merge(other_ids);
+        repeated_id = repeated_id || !other_ids.empty();
+    }
+    if (repeated_id) {
+        // Finds the first repeated ID in document order, as in serial validation.
+        ids.clear();
+        parse_and_validate_ids(document.root, index, ids);
+    }
+    check_validation_units(units, threads, [&](const ValidationUnit& unit, unsigned) {
+        if (unit.subtree) {
+            validate_attributes(*unit.element, index, ids);
+        } else {
+            const Element& element = *unit.element;
+            validate_element_attributes(
+                element.tag.name, index.find(element.tag.name), element.tag.attributes, index, &ids);
+        }
+    });
+}
+
+Validator::Validator(
+    const DoctypeDeclaration& dtd, bool validate_elements, bool validate_attributes, bool standalone
+) : dtd(dtd), index(dtd) {
+    this->validate_elements = validate_elements;
+    this->validate_attributes = validate_attributes;
+    this->standalone = standalone;
+}
+
+void Validator::validate_child(OpenElement& parent, NameId id) {
+    const ElementDeclaration& ed = *parent.declaration;
+    switch (ed.type) {
+        case ElementType::any:
+            break;
+        case ElementType::empty:
+            throw XmlError("Element declared EMPTY but contains content: " + std::string(ed.name));
+        case ElementType::mixed:
+            if (!this->index.allows_child(parent.name_id, id)) {
+                throw XmlError("Element did not match mixed content model: " + std::string(ed.name));
+            }
+            break;
+        case ElementType::children:
+            parent.state = this->index.next_state(parent.name_id, parent.state, id);
+            if (parent.state == -1) {
+                throw XmlError("Element did not match element content model: " + std::string(ed.name));
+            }
+            break;
+    }
+}
+
+void Validator::start_element(const String& name, const Attributes& attributes) {
+    if (this->open_elements.empty() && name != this->dtd.root_name) {
+        // Root name must match the root name in the DTD.
+        throw XmlError("Root element name does not match declared root element name in DTD");
+    }
+    OpenElement element;
+    element.name_id = this->index.find(name);
+    if (this->validate_elements) {
+        if (!this->open_elements.empty()) {
+            this->validate_child(this->open_elements.back(), element.name_id);
+        }
+        element.declaration = this->index.get_element_declaration(element.name_id);
+        if (element.declaration == nullptr) {
+            // Element not declared at all.
+            throw XmlError("Undeclared element: " + std::string(name));
+        }
+        if (element.declaration->type == ElementType::children) {
+            this->index.check_content_model(element.name_id);
+        }
+    }
+    if (this->validate_attributes) {
+        add_id(element.name_id, attributes, this->index, this->ids);
+        validate_element_attributes(
+            name, element.name_id, attributes, this->index, nullptr, &this->id_references);
+    }
+    this->open_elements.push_back(element);
+}
+
+void Validator::end_element(bool is_empty, bool children_only, bool has_text) {
+    const OpenElement& element = this->open_elements.back();
+    if (this->validate_elements) {
+        const ElementDeclaration& ed = *element.declaration;
+        switch (ed.type) {
+            case ElementType::empty:
+                // Element must simply have no content.
+                if (!is_empty) {
+                    throw XmlError("Element declared EMPTY but contains content: " + std::string(ed.name));
+                }
+                break;
+            case ElementType::children:
+                if (this->standalone && has_text) {
+                    // Must not be standalone if whitespace occurs directly within any instance of those types
+                    throw XmlError(
+                        "Standalone document cannot have whitespace "
+                        "in element with element content: " + std::string(ed.name));
+                }
+                if (!children_only) {
+                    throw XmlError(
+                        "Element with element content must have "
+                        "child elements only: " + std::string(ed.name));
+                }
+                if (!this->index.accepting(element.name_id, element.state)) {
+                    throw XmlError("Element did not match element content model: " + std::string(ed.name));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    this->open_elements.pop_back();
+}
+
+void Validator::end_document() {
+    for (const IdReference& reference : this->id_references) {
+        resolve_id_reference(reference, this->ids);
     }
 }
 
@@ -1,24 +1,85 @@
 // Element content validation and attributes validation etc.
 #pragma once
+#include <deque>
+#include <map>
 #include <set>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include "utils.h"
 
 namespace xml {
 
+// Declarations of a DTD indexed by interned element name, so that each element name is
+// only hashed once to find its element declaration, attribute list declaration and ID attribute,
+// with child elements then matched against content models by name ID.
+// Refers to the declarations of the DTD, which must outlive the index and not be modified.
+class DtdIndex {
+    // Everything declared for a single element name.
+    struct ElementEntry {
+        const ElementDeclaration* declaration = nullptr; // Element declaration (null if undeclared).
+        const AttributeListDeclaration* attribute_list_declaration = nullptr; // Null if none.
+        const String* id_attribute = nullptr; // Name of the ID attribute (null if none).
+        const ElementContentAutomaton* automaton = nullptr; // Content model (element content only).
+        std::vector<std::pair<NameId, std::size_t>> symbols; // Automaton symbol of each name ID, by ID.
+        std::vector<NameId> choices; // Permitted child name IDs (mixed content only), in order.
+    };
+    const DoctypeDeclaration& dtd; // DTD indexed.
+    NameTable names; // All element names in the DTD (declared or in content models).
+    std::vector<ElementEntry> elements; // Entry of each element name by ID.
+    // Content models compiled on demand (declarations not from a parsed DTD).
+    std::deque<ElementContentAutomaton> compiled_automata;
+    public:
+        // Indexes the declarations of the DTD (which must outlive the index).
+        explicit DtdIndex(const DoctypeDeclaration&);
+        // Returns the indexed DTD.
+        const DoctypeDeclaration& get_dtd() const;
+        // Returns the ID of an element name (NO_NAME if not in the DTD).
+        NameId find(std::string_view) const;
+        // Returns the element declaration with the given name ID (null if none).
+        const ElementDeclaration* get_element_declaration(NameId) const;
+        // Returns the attribute list declaration of the element with the given name ID (null if none).
+        const AttributeListDeclaration* get_attribute_list_declaration(NameId) const;
+        // Returns the name of the ID attribute of the element with the given name ID (null if none).
+        const String* get_id_attribute(NameId) const;
+        // Returns the content model state after the given child (by name ID) of an element
+        // with element content, in the given state (-1 if the child does not match).
+        int next_state(NameId, int, NameId) const;
+        // XmlError if the content model of the element with element content (by name ID)
+        // could not be compiled, so elements cannot be validated against it.
+        void check_content_model(NameId) const;
+        // Returns true if the element with element content may end in the given state.
+        bool accepting(NameId, int) const;
+        // Returns true if the child (by name ID) is permitted in the element with mixed content.
+        bool allows_child(NameId, NameId) const;
+};
+
 // Validates a given document (may have already done some validation during parsing
 // but the rest will be completed here).
 void validate_document(const Document&, bool, bool);
+// Validates a given document as above, but with subtrees validated in parallel by the given
+// number of threads (0 for all hardware threads). IDs are collected per thread, and then
+// merged before attributes are validated. Errors are exactly as in serial validation.
+void validate_document(const Document&, bool, bool, unsigned);
 
 // Validates an element, ensuring it meets the content requirements as declared in the DTD.
-void validate_element(const Element&, const ElementDeclarations&, bool);
+void validate_element(const Element&, const DtdIndex&, bool);
 
-// Recursive helper for element content validation. Returns true if match.
-bool valid_element_content_helper(const Element&, const ElementContentModel&, std::size_t&);
-// Validates element content (child elements separated by optional whitespace only).
-void validate_element_content(const Element&, const ElementContentModel&, bool);
+// Compiles an element content model into the equivalent deterministic automaton.
+// XmlError if the model has more element names than the given maximum. If the model is not
+// deterministic (an element could match more than one position), the automaton only has
+// its error set, which is reported once an element is validated against it.
+ElementContentAutomaton compile_element_content_model(const ElementContentModel&, std::size_t = NO_LIMIT);
+// Compiles the content models of all element declarations with element content,
+// each with at most the given number of element names.
+void compile_element_content_models(DoctypeDeclaration&, std::size_t = NO_LIMIT);
+// Validates element content (child elements separated by optional whitespace only),
+// given the name ID of the element.
+void validate_element_content(const Element&, const DtdIndex&, NameId, bool);
 
-// Validates mixed content (any number of certain child elements, cdata allowed).
-void validate_mixed_content(const Element&, const MixedContentModel&);
+// Validates mixed content (any number of certain child elements, cdata allowed),
+// given the name ID of the element.
+void validate_mixed_content(const Element&, const DtdIndex&, NameId);
 
 // Validates attribute list declarations after parsing DTD.
 void validate_attribute_list_declarations(const DoctypeDeclaration&);
@@ -27,11 +88,67 @@ void validate_attribute_list_declarations(const DoctypeDeclaration&);
 void validate_default_attribute_value(
     const AttributeDeclaration&, const DoctypeDeclaration&, const String* = nullptr);
 
+// IDREF/IDREFS attribute value, to be resolved against the IDs of the document.
+struct IdReference {
+    String element_name; // Name of the element with the attribute.
+    String attribute_name; // Name of the attribute.
+    String value; // Attribute value (space-separated for IDREFS).
+    bool multiple; // IDREFS rather than IDREF.
+};
+
+// Resolves an IDREF/IDREFS value, ensuring it matches IDs in the document.
+void resolve_id_reference(const IdReference&, const std::set<String>&);
+
+// Validates the attributes of a single element (name, name ID, attributes).
+// IDREF/IDREFS values are resolved against the given IDs,
+// or otherwise added to the given references to be resolved later.
+void validate_element_attributes(
+    const String&, NameId, const Attributes&, const DtdIndex&,
+    const std::set<String>*, std::vector<IdReference>* = nullptr);
+
 // Validates the attributes of an element, and then attributes of child elements recursively.
-void validate_attributes(const Element&, const DoctypeDeclaration&, const std::set<String>&);
+void validate_attributes(const Element&, const DtdIndex&, const std::set<String>&);
+
+// Adds the ID value of a single element (name ID, attributes) if any, ensuring it is not a duplicate.
+void add_id(NameId, const Attributes&, const DtdIndex&, std::set<String>&);
 
 // Parse and validate all ID values, ensuring no duplicates, done before
 // further attributes validation. Does not perform any other validation.
-void parse_and_validate_ids(const Element&, const DoctypeDeclaration&, std::set<String>&);
+void parse_and_validate_ids(const Element&, const DtdIndex&, std::set<String>&);
+
+// Validates a document incrementally as it is parsed rather than after the whole document
+// is built, so invalid documents fail fast and no tree is needed. A start tag is checked
+// straight away (against the content model of the parent and the attribute list declaration),
+// the content of an element when it closes, and IDREF/IDREFS values at the end of the document.
+class Validator {
+    // Element that has been opened (start tag seen), but not yet closed.
+    struct OpenElement {
+        NameId name_id = NO_NAME; // ID of the element name.
+        const ElementDeclaration* declaration = nullptr; // Declaration (elements validated only).
+        int state = 0; // Current state of the automaton, given the child elements so far.
+    };
+    const DoctypeDeclaration& dtd; // DTD to validate against.
+    DtdIndex index; // Declarations of the DTD by element name ID.
+    bool validate_elements; // Validate elements against their declarations?
+    bool validate_attributes; // Validate attributes against attribute list declarations?
+    bool standalone; // Document is standalone?
+    std::vector<OpenElement> open_elements; // Elements currently open, from root to innermost.
+    std::set<String> ids; // ID values seen so far.
+    std::vector<IdReference> id_references; // IDREF/IDREFS values seen so far, resolved at the end.
+
+    // Validates a child element (by name ID) against the content model of its parent.
+    void validate_child(OpenElement&, NameId);
+    public:
+        // The DTD must outlive the validator.
+        Validator(const DoctypeDeclaration&, bool validate_elements, bool validate_attributes, bool standalone);
+        // Validates the start of an element (attributes including defaults).
+        void start_element(const String& name, const Attributes&);
+        // Validates the end of the innermost open element, given whether it had any content,
+        // whether its content was child elements (and whitespace) only, and whether
+        // it had any character data at all.
+        void end_element(bool is_empty, bool children_only, bool has_text);
+        // Completes validation at the end of the document (resolving IDREF/IDREFS values).
+        void end_document();
+};
 
 }
\ No newline at end of file
@@ -8,9 +8,76 @@ Document parse(const std::string& string, bool validate_elements, bool validate_
     return parser.parse_document(validate_elements, validate_attributes);
 }
 
+Document parse(std::string_view buffer, bool validate_elements, bool validate_attributes) {
+    Parser parser(buffer);
+    return parser.parse_document(validate_elements, validate_attributes);
+}
+
+Document parse(const char* string, bool validate_elements, bool validate_attributes) {
+    return parse(std::string_view(string), validate_elements, validate_attributes);
+}
+
 Document parse(std::istream& istream, bool validate_elements, bool validate_attributes) {
     Parser parser(istream);
     return parser.parse_document(validate_elements, validate_attributes);
 }
 
+Document parse_file(const std::filesystem::path& file_path, bool validate_elements, bool validate_attributes) {
+    MappedFile file(file_path);
+    Parser parser(file.view());
+    return parser.parse_document(validate_elements, validate_attributes);
+}
+
+Document parse(std::string_view buffer, const ParseOptions& options) {
+    Parser parser(buffer);
+    return parser.parse_document(options);
+}
+
+Document parse(std::istream& istream, const ParseOptions& options) {
+    Parser parser(istream);
+    return parser.parse_document(options);
 }
+
+Document parse_file(const std::filesystem::path& file_path, const ParseOptions& options) {
+    MappedFile file(file_path);
+    Parser parser(file.view());
+    return parser.parse_document(options);
+}
+
+ParseResult try_parse(std::string_view buffer, const ParseOptions& options) {
+    return Parser(buffer).try_parse_document(options);
+}
+
+ParseResult try_parse(std::istream& istream, const ParseOptions& options) {
+    return Parser(istream).try_parse_document(options);
+}
+
+ParseResult try_parse_file(const std::filesystem::path& file_path, const ParseOptions& options) {
+    std::unique_ptr<MappedFile> file;
+    try {
+        file = std::make_unique<MappedFile>(file_path);
+    } catch (const XmlError& e) {
+        ParseResult result;
+        result.error = e.what();
+        return result;
+    }
+    return Parser(file->view()).try_parse_document(options);
+}
+
+void parse(std::string_view buffer, Handler& handler) {
+    Parser parser(buffer);
+    parser.parse_document(handler);
+}
+
+void parse(std::istream& istream, Handler& handler) {
+    Parser parser(istream);
+    parser.parse_document(handler);
+}
+
+void parse_file(const std::filesystem::path& file_path, Handler& handler) {
+    MappedFile file(file_path);
+    Parser parser(file.view());
+    parser.parse_document(handler);
+}
+
+}
\ No newline at end of file
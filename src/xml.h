@@ -1,6 +1,14 @@
 // Main module of the XML parser library.
 #pragma once
+#include <filesystem>
 #include <string>
+#include <string_view>
+#include "batch.h"
+#include "compact.h"
+#include "dtd.h"
+#include "handler.h"
+#include "push.h"
+#include "reader.h"
 #include "utils.h"
 #include "parser.h"
 
@@ -11,10 +19,53 @@ namespace xml {
 // By default, elements and attributes are thoroughly validated but
 // this can be turned off by setting the corresponding parameter to false.
 Document parse(const std::string&, bool = true, bool = true);
+// Accepts a contiguous buffer of XML data to parse, and returns the parsed document.
+// The data is read directly from memory without any copying.
+// By default, elements and attributes are thoroughly validated but
+// this can be turned off by setting the corresponding parameter to false.
+Document parse(std::string_view, bool = true, bool = true);
+// Accepts a null-terminated string to parse, and returns the parsed document.
+// By default, elements and attributes are thoroughly validated but
+// this can be turned off by setting the corresponding parameter to false.
+Document parse(const char*, bool = true, bool = true);
 // Accepts an input stream to parse, and returns the parsed document.
 // Leaves the stream at the end if successfully parsed, otherwise unknown state if error.
 // By default, elements and attributes are thoroughly validated but
 // this can be turned off by setting the corresponding parameter to false.
 Document parse(std::istream&, bool = true, bool = true);
+// Accepts the path of a file to parse, and returns the parsed document.
+// The file is memory mapped and parsed straight out of the mapping.
+// By default, elements and attributes are thoroughly validated but
+// this can be turned off by setting the corresponding parameter to false.
+Document parse_file(const std::filesystem::path&, bool = true, bool = true);
+// Accepts a contiguous buffer of XML data to parse with the given options (e.g. an arena),
+// and returns the parsed document.
+Document parse(std::string_view, const ParseOptions&);
+// Accepts an input stream to parse with the given options, and returns the parsed document.
+Document parse(std::istream&, const ParseOptions&);
+// Accepts the path of a file to parse (memory mapped) with the given options,
+// and returns the parsed document.
+Document parse_file(const std::filesystem::path&, const ParseOptions&);
+// Accepts a contiguous buffer of XML data to parse with the given options, and returns
+// the outcome - the document, or the error message if it is malformed or invalid.
+// No XmlError is thrown, for when rejecting documents is routine (e.g. untrusted input), and
+// the most common errors in element content are never thrown internally either (see
+// Parser::try_parse_document). Anything else (e.g. std::bad_alloc, or std::invalid_argument
+// for malformed paths in the options) is not a parse failure, so still propagates.
+ParseResult try_parse(std::string_view, const ParseOptions& = {});
+// Accepts an input stream to parse with the given options, and returns the outcome.
+ParseResult try_parse(std::istream&, const ParseOptions& = {});
+// Accepts the path of a file to parse (memory mapped) with the given options,
+// and returns the outcome (including failure to open the file).
+ParseResult try_parse_file(const std::filesystem::path&, const ParseOptions& = {});
+
+// Streaming (SAX-style) parsing of a contiguous buffer. Rather than a document being built,
+// events are passed to the handler as parsing progresses.
+// Only well-formedness is checked when streaming (no validation).
+void parse(std::string_view, Handler&);
+// Streaming (SAX-style) parsing of an input stream, passing events to the handler.
+void parse(std::istream&, Handler&);
+// Streaming (SAX-style) parsing of a file (memory mapped), passing events to the handler.
+void parse_file(const std::filesystem::path&, Handler&);
 
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+// Regression benchmark - building and validating a document must not deep copy nodes.
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+// Counts every heap allocation made by the program.
+static std::size_t allocations = 0;
+
+// Allocates and frees through malloc/free, counting each allocation. Kept out of line,
+// so that the compiler never sees memory from operator new released with free.
+[[gnu::noinline]] static void* allocate(std::size_t size, std::size_t align = 0) {
+    allocations++;
+    void* p = align ? std::aligned_alloc(align, (size + align - 1) / align * align) : std::malloc(size != 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+[[gnu::noinline]] static void deallocate(void* p) noexcept {
+    std::free(p);
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+// Used by the default memory resource (polymorphic allocators).
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    deallocate(p);
+}
+
+
+// Returns the number of heap allocations made whilst parsing the given document.
+std::size_t count_allocations(const std::string& string, bool validate) {
+    std::size_t before = allocations;
+    {
+        Document document = parse(string, validate, validate);
+    }
+    return allocations - before;
+}
+
+// Elements nested to the given depth, each with a long name and attribute value.
+std::string nested_document(int depth) {
+    std::string dtd = "<!DOCTYPE element_with_a_long_name [<!ELEMENT element_with_a_long_name ANY>"
+        "<!ATTLIST element_with_a_long_name attribute CDATA #IMPLIED>]>";
+    std::string start = "<element_with_a_long_name attribute='a value that does not fit inline'>";
+    std::string end = "</element_with_a_long_name>";
+    std::string document = dtd;
+    for (int i = 0; i < depth; ++i) {
+        document += start;
+    }
+    for (int i = 0; i < depth; ++i) {
+        document += end;
+    }
+    return document;
+}
+
+// Siblings validated against a large content model.
+std::string sibling_document(int count) {
+    std::string document = "<!DOCTYPE root [<!ELEMENT root (item*)><!ELEMENT item (";
+    for (int i = 0; i < 50; ++i) {
+        document += "option_number_" + std::to_string(i) + (i < 49 ? "|" : ")*>");
+    }
+    document += "]><root>";
+    for (int i = 0; i < count; ++i) {
+        document += "<item/>";
+    }
+    return document + "</root>";
+}
+
+
+int main() {
+    // Deep copies of child subtrees would make allocations quadratic in the depth.
+    std::size_t nested = count_allocations(nested_document(200), true);
+    std::size_t nested_twice = count_allocations(nested_document(400), true);
+    std::cout << "Nested: " << nested << " / " << nested_twice << " allocations.\n";
+    assert((nested_twice < nested * 2 + 200));
+    // Copying the element declaration for every element visited would make
+    // validation allocate in proportion to the number of elements.
+    std::size_t unvalidated = count_allocations(sibling_document(1000), false);
+    std::size_t validated = count_allocations(sibling_document(1000), true);
+    std::cout << "Siblings: " << unvalidated << " / " << validated << " allocations.\n";
+    assert((validated < unvalidated + 100));
+    std::cout << "Allocations Test 0 passed.\n";
+}
\ No newline at end of file
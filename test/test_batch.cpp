@@ -0,0 +1,132 @@
+// Tests parsing many documents at once with a shared thread pool.
+/*
+!!!MUST!!! BE
+RUN FROM THE ROOT OF THE PROJECT.
+*/
+#include <atomic>
+#include <cassert>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <iostream>
+#include <vector>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+const std::string FOLDER = "test/test_files";
+
+
+unsigned test_number = 0;
+void passed() {
+    std::cout << "Batch Test " << test_number++ << " passed.\n";
+}
+
+
+int main() {
+    std::atomic<int> count = 0;
+    {
+        // Tasks spread (and stolen) across all workers, including tasks submitted by tasks.
+        ThreadPool pool(4);
+        assert((pool.size() == 4));
+        assert((ThreadPool::current_worker() == -1));
+        for (int i = 0; i < 100; ++i) {
+            pool.submit([&pool, &count] {
+                assert((ThreadPool::current_worker() >= 0 && ThreadPool::current_worker() < 4));
+                pool.submit([&count] { ++count; });
+                ++count;
+            });
+        }
+        // Remaining tasks are all run before the pool is destroyed.
+    }
+    assert((count == 200));
+    passed();
+
+    std::vector<std::string> strings;
+    for (int i = 0; i < 200; ++i) {
+        strings.push_back("<doc n='" + std::to_string(i) + "'>" + std::string(i % 17 * 50, 'x') + "</doc>");
+    }
+    strings[42] = "<doc></dob>";
+    strings[137] = "<!DOCTYPE doc [<!ELEMENT doc EMPTY>]><doc>Not empty</doc>";
+    std::vector<BatchResult> results = parse_batch(strings);
+    assert((results.size() == strings.size()));
+    for (int i = 0; i < 200; ++i) {
+        if (i == 42 || i == 137) {
+            // Errors are exactly those of parsing the document alone.
+            assert((!results[i].success));
+            try {
+                parse(strings[i]);
+                assert((false));
+            } catch (const XmlError& e) {
+                assert((results[i].error == e.what()));
+            }
+            continue;
+        }
+        assert((results[i].success));
+        assert((results[i].error.empty()));
+        assert((results[i].document.root.tag.attributes.at("n") == String(std::to_string(i))));
+        assert((results[i].document.root.text.size() == static_cast<std::size_t>(i % 17 * 50)));
+    }
+    passed();
+
+    // Shared pool across batches, with per-worker arenas.
+    ThreadPool pool(3);
+    BatchOptions options;
+    options.pool = &pool;
+    options.worker_arenas = true;
+    for (int batch = 0; batch < 3; ++batch) {
+        results = parse_batch(strings, options);
+        for (int i = 0; i < 200; ++i) {
+            assert((results[i].success == (i != 42 && i != 137)));
+            if (results[i].success) {
+                assert((results[i].document.arena != nullptr));
+                assert((results[i].document.root.tag.attributes.at("n") == String(std::to_string(i))));
+            }
+        }
+    }
+    // Documents outlive the batch (and still own their arenas).
+    std::vector<BatchResult> kept = parse_batch(std::vector<BatchInput> {"<a>1</a>", strings[5]}, options);
+    assert((kept[0].document.root.text == String("1")));
+    assert((kept[1].document.root.tag.attributes.at("n") == String("5")));
+    passed();
+
+    // Files sharing an external DTD subset, compiled and loaded once for the batch.
+    std::vector<std::filesystem::path> paths;
+    for (int i = 0; i < 20; ++i) {
+        paths.push_back(FOLDER + (i % 2 ? "/ext_subset.xml" : "/external.xml"));
+    }
+    paths.push_back(FOLDER + "/missing.xml");
+    BatchOptions file_options;
+    file_options.threads = 4;
+    file_options.parse_options.validate_elements = false;
+    file_options.parse_options.dtd_cache = std::make_shared<DtdCache>();
+    results = parse_batch(paths, file_options);
+    for (int i = 0; i < 20; ++i) {
+        assert((results[i].success));
+        Document expected = parse_file(paths[i], false);
+        assert((results[i].document.root.children.size() == expected.root.children.size()));
+        assert((results[i].document.doctype_declaration.element_declarations.size()
+            == expected.doctype_declaration.element_declarations.size()));
+    }
+    assert((!results.back().success));
+    assert((file_options.parse_options.dtd_cache->size() == 1));
+    assert((parse_batch(std::vector<BatchInput>()).empty()));
+    passed();
+
+    // A batch parsed from a task of the same pool, even with a single worker.
+    ThreadPool single(1);
+    BatchOptions nested_options;
+    nested_options.pool = &single;
+    std::promise<std::vector<BatchResult>> nested;
+    single.submit([&] {
+        nested.set_value(parse_batch(std::vector<BatchInput> {"<a>1</a>", "<b>2</b>", "<c>"}, nested_options));
+    });
+    std::vector<BatchResult> nested_results = nested.get_future().get();
+    assert((nested_results.size() == 3));
+    assert((nested_results[0].success && nested_results[0].document.root.tag.name == "a"));
+    assert((nested_results[1].success && nested_results[1].document.root.text == "2"));
+    assert((!nested_results[2].success));
+    passed();
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+// Tests the compact (flat node table) document representation.
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <iostream>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+typedef std::function<void(const CompactDocument&)> TestCompact;
+unsigned test_number = 0;
+void test_compact(const std::string& string, TestCompact callback) {
+    CompactDocument document = parse_compact(string);
+    callback(document);
+    // Decoding values on access must give the same results, as must viewing them in the input.
+    callback(parse_compact(string, true));
+    callback(parse_compact(string, false, true));
+    std::cout << "Compact Test " << test_number++ << " passed.\n";
+}
+
+
+int main() {
+    test_compact("<?xml version='1.0'?><a>Sanity Check</a>", [](const CompactDocument& document) {
+        assert((document.version == String("1.0")));
+        assert((document.size() == 2));
+        assert((document.name(document.root()) == "a"));
+        assert((document.parent(document.root()) == NO_NODE));
+        NodeIndex text = document.first_child(document.root());
+        assert((document.type(text) == CompactNodeType::text));
+        assert((document.value(text) == "Sanity Check"));
+        assert((document.next_sibling(text) == NO_NODE));
+    });
+    test_compact(R"(<?pi first?><root id="1" b='2'>Start<!-- comment -->&amp;<item name='x'/>
+        <item name="y"><sub/>Text<![CDATA[<raw>]]></item><?pi second?>End</root><?pi last?>)",
+    [](const CompactDocument& document) {
+        assert((document.processing_instructions.size() == 2));
+        NodeIndex root = document.root();
+        assert((document.attribute_count(root) == 2));
+        assert((document.attribute_name(root, 0) == "b" && document.attribute_value(root, 0) == "2"));
+        assert((document.attribute(root, "id") == "1"));
+        assert((!document.has_attribute(root, "name")));
+        // Children in order: text, item, text, item, PI, text.
+        std::vector<CompactNodeType> types;
+        for (NodeIndex child = document.first_child(root); child != NO_NODE; child = document.next_sibling(child)) {
+            assert((document.parent(child) == root));
+            types.push_back(document.type(child));
+        }
+        std::vector<CompactNodeType> expected {
+            CompactNodeType::text, CompactNodeType::element, CompactNodeType::text,
+            CompactNodeType::element, CompactNodeType::processing_instruction, CompactNodeType::text
+        };
+        assert((types == expected));
+        assert((document.text(root) == String("Start&\n        End")));
+        NodeIndex first_item = document.next_sibling(document.first_child(root));
+        NodeIndex second_item = document.next_sibling(document.next_sibling(first_item));
+        assert((document.attribute(first_item, "name") == "x"));
+        assert((document.first_child(first_item) == NO_NODE));
+        assert((document.name(document.first_child(second_item)) == "sub"));
+        assert((document.text(second_item) == String("Text<raw>")));
+        NodeIndex pi = document.next_sibling(second_item);
+        assert((document.name(pi) == "pi" && document.value(pi) == "second"));
+        // Document order - every node comes before its children.
+        for (NodeIndex i = 1; i < document.size(); ++i) {
+            assert((document.parent(i) < i));
+        }
+    });
+    test_compact(R"(<!DOCTYPE root [
+        <!ATTLIST child att CDATA "default">
+        <!ENTITY greeting "Hello, <child/>world">
+    ]><root>&greeting;!</root>)", [](const CompactDocument& document) {
+        assert((document.doctype_declaration.root_name == String("root")));
+        NodeIndex child = document.next_sibling(document.first_child(document.root()));
+        assert((document.name(child) == "child"));
+        assert((document.attribute(child, "att") == "default"));
+        assert((document.text(document.root()) == String("Hello, world!")));
+    });
+    // Well-formedness errors must still be detected (whether or not values are decoded lazily).
+    for (bool lazy : {false, true}) {
+        for (const char* malformed : {
+            "<a><b></a></b>", "<a>]]></a>", "<a b='<'/>", "<a>&lt</a>", "<a b='&#0;'/>", "<a>&undeclared;</a>"
+        }) {
+            try {
+                parse_compact(malformed, lazy);
+                assert((false));
+            } catch (const XmlError&) {}
+        }
+    }
+    CompactDocument lazy_document = parse_compact(
+        "<a b=' &#x41; &quot;\r\n'>1&#50;<!---->\r\n3]><b/><![CDATA[4]]></a>", true);
+    assert((lazy_document.attribute(lazy_document.root(), "b") == " A \" "));
+    assert((lazy_document.text(lazy_document.root()) == String("12\n3]>4")));
+    std::cout << "Compact Test " << test_number++ << " passed.\n";
+    // Values needing no decoding are views into the input, anything else is decoded.
+    std::string input = "<root a='plain' b='&lt;'>Text<é c='x y'>&#65;</é></root>";
+    auto in_input = [&input](std::string_view view) {
+        return view.data() >= input.data() && view.data() + view.size() <= input.data() + input.size();
+    };
+    CompactDocument view_document = parse_compact(input, false, true);
+    NodeIndex root = view_document.root();
+    assert((view_document.name(root) == "root" && in_input(view_document.name(root))));
+    assert((view_document.attribute(root, "a") == "plain" && in_input(view_document.attribute(root, "a"))));
+    assert((view_document.attribute(root, "b") == "<" && !in_input(view_document.attribute(root, "b"))));
+    NodeIndex text = view_document.first_child(root);
+    assert((view_document.value(text) == "Text" && in_input(view_document.value(text))));
+    NodeIndex child = view_document.next_sibling(text);
+    assert((view_document.name(child) == "é" && in_input(view_document.name(child))));
+    assert((view_document.attribute_name(child, 0) == "c" && view_document.attribute_value(child, 0) == "x y"));
+    assert((view_document.text(child) == String("A")));
+    // With a DTD, everything is copied (and decoded) as usual.
+    std::string with_dtd = "<!DOCTYPE root><root a='plain'>Text</root>";
+    CompactDocument copied_document = parse_compact(with_dtd, false, true);
+    std::string_view copied = copied_document.attribute(copied_document.root(), "a");
+    assert((copied == "plain" && (copied.data() < with_dtd.data() || copied.data() >= with_dtd.data() + with_dtd.size())));
+    // Views into a file mapping keep the mapping alive.
+    std::filesystem::path file_path = std::filesystem::temp_directory_path() / "xml_compact_views.xml";
+    std::ofstream(file_path) << input;
+    CompactDocument file_document = parse_compact_file(file_path, false, true);
+    CompactDocument file_document_copy = file_document;
+    file_document = CompactDocument();
+    assert((file_document_copy.value(file_document_copy.first_child(file_document_copy.root())) == "Text"));
+    std::filesystem::remove(file_path);
+    std::cout << "Compact Test " << test_number++ << " passed.\n";
+    // Views give the same names, attributes (in name order) and text as building them, and the
+    // same errors at the same positions.
+    std::string attributes_input = "<r z='1' a='2' m=\"3\"><s q='' p='x'>t<u/>v</s>w</r>";
+    CompactDocument built_document = parse_compact(attributes_input, true);
+    CompactDocument viewed_document = parse_compact(attributes_input, false, true);
+    NodeIndex built_root = built_document.root();
+    NodeIndex viewed_root = viewed_document.root();
+    assert((viewed_document.attribute_count(viewed_root) == 3));
+    for (std::size_t i = 0; i < 3; ++i) {
+        assert((viewed_document.attribute_name(viewed_root, i) == built_document.attribute_name(built_root, i)));
+        assert((viewed_document.attribute_value(viewed_root, i) == built_document.attribute_value(built_root, i)));
+    }
+    assert((viewed_document.attribute_name(viewed_root, 0) == "a" && viewed_document.attribute_value(viewed_root, 2) == "1"));
+    NodeIndex viewed_child = viewed_document.first_child(viewed_root);
+    assert((viewed_document.name(viewed_child) == "s" && viewed_document.attribute(viewed_child, "p") == "x"));
+    assert((viewed_document.text(viewed_root) == built_document.text(built_root)));
+    for (std::string malformed : {
+        "<a b='1' c='2' b='3'/>", "<a c='1' b='2' c='3' b='4'/>", "<a b='1' c='2' c='3' b='4'/>",
+        "<a><b></c></a>", "<a><b></bc></a>", "<a 1='x'/>", "<a xmlfoo='x'/>", "<a b='1' b='1'>"
+    }) {
+        std::string built_error;
+        std::string viewed_error;
+        try {
+            parse_compact(malformed, true);
+        } catch (const XmlError& error) {
+            built_error = error.what();
+        }
+        try {
+            parse_compact(malformed, false, true);
+        } catch (const XmlError& error) {
+            viewed_error = error.what();
+        }
+        assert((!built_error.empty() && built_error == viewed_error));
+    }
+    std::cout << "Compact Test " << test_number++ << " passed.\n";
+}
@@ -1,14 +1,39 @@
 // Tests the functionality of entire document parsing.
 #include <cassert>
 #include <functional>
+#include <map>
 #include <string>
 #include <iostream>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
 #include "../src/parser.h"
+#include "../src/validate.h"
 
 
 using namespace xml;
 
 
+// Memory resource counting the allocations made through it.
+class CountingResource : public std::pmr::memory_resource {
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        deallocations++;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+    public:
+        std::size_t allocations = 0;
+        std::size_t deallocations = 0;
+};
+
+
 typedef std::function<void(const Document&)> TestDocument;
 unsigned test_number = 0;
 void test_document(
@@ -17,6 +42,17 @@ void test_document(
 ) {
     Document document = Parser(string).parse_document(validate_elements, validate_attributes);
     callback(document);
+    // Streaming validation must accept exactly the same documents.
+    ParseOptions options;
+    options.validate_elements = validate_elements;
+    options.validate_attributes = validate_attributes;
+    options.streaming_validation = true;
+    callback(Parser(string).parse_document(options));
+    // Parsing the children of the root element in parallel must give the same results.
+    options.streaming_validation = false;
+    options.threads = 4;
+    options.parallel_chunk_size = 1;
+    callback(Parser(string).parse_document(options));
     std::cout << "Document Test " << test_number++ << " passed.\n";
 }
 
@@ -416,7 +452,7 @@ xyz" b="&d;&d;A&a;&#x20;&a;B&da;" c="&#xd;&#xd;A&#xa;&#xa;B&#xd;&#xa;&t;&t;"></r
         assert((root.attributes.at("count") == String("4")));
         assert((root.attributes.at("userId") == String("123456")));
         assert((root.attributes.at("settings") == String("43&54&&25")));
-        std::vector<Element> activities = document.root.children;
+        std::pmr::vector<Element> activities = document.root.children;
         std::vector<String> ids {"8888", "1234", "0000", "2323"};
         std::vector<String> distances {"5.44", "6.46", "7.77", "9.99"};
         std::vector<String> titles {"Afternoon Run", "Night Jog", "Wet & Fun Run<", "Dry & Boring Run<>"};
@@ -439,4 +475,624 @@ xyz" b="&d;&d;A&a;&#x20;&a;B&da;" c="&#xd;&#xd;A&#xa;&#xa;B&#xd;&#xa;&t;&t;"></r
         assert((document.root.children.size() == 3));
         assert((document.root.children.at(1).tag.attributes.at("c") == String("d")));
     }, false, false);
+    // Contiguous buffer input must stop at the end of the view, not the end of the string.
+    std::string buffer = "<?xml version='1.0'?><café à='ï'>漢字😀</café>Trailing junk";
+    Document document = Parser(std::string_view(buffer).substr(0, buffer.find("Trailing")))
+        .parse_document();
+    assert((document.root.tag.name == String("café")));
+    assert((document.root.tag.attributes.at("à") == String("ï")));
+    assert((document.root.text == String("漢字😀")));
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    test_document(R"(
+        <!DOCTYPE 名前 [
+            <!ELEMENT 名前 (#PCDATA)>
+            <!ATTLIST 名前 tokens NMTOKENS #REQUIRED>
+            <!ENTITY ü "Grüße &#x1F600;">
+        ]><名前 tokens="é ñ  文字">&ü;&#233;</名前>
+    )", [](const Document& document) {
+        // Strings are UTF-8 - one byte per ASCII character, up to four otherwise.
+        assert((document.root.tag.name == String{0x540D, 0x524D}));
+        assert((document.root.tag.attributes.at("tokens") == String("é ñ 文字")));
+        assert((document.root.text == String("Grüße 😀é")));
+        assert((document.root.text.size() == 14));
+        std::size_t chars = 0;
+        for (Char c : document.root.text.codepoints()) {
+            assert((c != 0xFFFD));
+            chars++;
+        }
+        assert((chars == 8));
+    });
+    // All elements come from the arena, which the document keeps alive.
+    auto counter = std::make_shared<CountingResource>();
+    ParseOptions options;
+    options.arena = counter;
+    options.validate_elements = false;
+    document = Parser(R"(<!DOCTYPE root [<!ATTLIST item id ID #IMPLIED>]>
+        <root><item id="first">A fairly long piece of text that does not fit inline.</item>
+        <item id="second"><?pi A fairly long processing instruction that does not fit inline.?></item>
+        </root>)").parse_document(options);
+    options.arena = nullptr;
+    assert((document.arena == counter));
+    assert((counter->allocations > 0));
+    assert((document.root.children.get_allocator().resource() == counter.get()));
+    const Element& item = document.root.children.at(1);
+    assert((item.tag.attributes.get_allocator().resource() == counter.get()));
+    assert((item.processing_instructions.at(0).instruction.get_allocator().resource() == counter.get()));
+    assert((document.root.children.at(0).text.get_allocator().resource() == counter.get()));
+    // Copies use the default heap, independent of the arena.
+    Element copy = document.root;
+    assert((copy.children.get_allocator().resource() == std::pmr::get_default_resource()));
+    assert((copy.children.at(0).tag.attributes.at("id") == String("first")));
+    std::size_t allocations = counter->allocations;
+    document = Document();
+    assert((counter.use_count() == 1));
+    assert((counter->allocations == allocations && counter->deallocations == allocations));
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Content models are matched as a whole - no greedy matching of parts.
+    std::string content_models = R"(<!DOCTYPE root [
+        <!ELEMENT root ANY><!ELEMENT a EMPTY><!ELEMENT b EMPTY><!ELEMENT c EMPTY>
+        <!ELEMENT optional (a, a?)><!ELEMENT choice (a, (b | c))><!ELEMENT repeat (a, (b?, a)+)>
+        <!ELEMENT nested ((a | b)*, c)>
+    ]>)";
+    test_document(content_models + R"(<root>
+        <optional><a/></optional><optional><a/><a/></optional><choice><a/><c/></choice>
+        <repeat><a/><a/><b/><a/></repeat><nested><b/><a/><c/></nested><nested><c/></nested></root>
+    )", [](const Document& document) {
+        const ElementContentAutomaton& automaton = document.doctype_declaration
+            .element_declarations.at("choice").element_content_automaton;
+        assert((automaton.symbols.size() == 3));
+        assert((automaton.accepting.size() == 4));
+        assert((document.root.children.size() == 6));
+    });
+    for (const char* mismatch : {
+        "<optional/>", "<optional><a/><a/><a/></optional>", "<choice><a/></choice>",
+        "<choice><a/><b/><c/></choice>", "<repeat><a/><b/></repeat>", "<nested><a/></nested>",
+        "<nested><c/><c/></nested>", "<nested><d/></nested>"
+    }) {
+        try {
+            Parser(content_models + "<root>" + mismatch + "</root>").parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+        try {
+            ParseOptions options;
+            options.streaming_validation = true;
+            Parser(content_models + "<root>" + mismatch + "</root>").parse_document(options);
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    // Non-deterministic content models are rejected once validated against - including ones whose
+    // subset construction would have exponentially many states. Without validating elements,
+    // documents declaring them are parsed as normal.
+    std::string exponential = "((a|b)*, a";
+    for (int i = 0; i < 20; ++i) {
+        exponential += ", (a|b)";
+    }
+    exponential += ")";
+    for (std::string model : {
+        "(a?, a)", "((a, b) | (a, c))", "((a, b?)+, a)", "(a*, a)", "((a, b) | (a, b, b))", exponential.c_str()
+    }) {
+        std::string non_deterministic =
+            "<!DOCTYPE r [<!ELEMENT r " + model + "><!ELEMENT a EMPTY><!ELEMENT b EMPTY>]><r><a/><b/></r>";
+        for (bool streaming_validation : {false, true}) {
+            ParseOptions options;
+            options.streaming_validation = streaming_validation;
+            try {
+                Parser(non_deterministic).parse_document(options);
+                assert((false));
+            } catch (const XmlError& e) {
+                // Only the position is added when validating as parsed.
+                std::string error = e.what();
+                std::string expected = "Element content model must be deterministic: r";
+                assert((error.size() >= expected.size()
+                    && error.compare(error.size() - expected.size(), expected.size(), expected) == 0));
+            }
+            options.validate_elements = false;
+            Document document = Parser(non_deterministic).parse_document(options);
+            assert((document.root.children.size() == 2));
+            assert((!document.doctype_declaration.element_declarations.at("r").element_content_automaton.error.empty()));
+        }
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Plain internal entities are expanded once and taken in bulk - same results as otherwise.
+    std::string expanded_entities = R"(<!DOCTYPE root [
+        <!ELEMENT root ANY><!ELEMENT list (item*)><!ELEMENT item EMPTY>
+        <!ATTLIST root a CDATA #IMPLIED b NMTOKENS #IMPLIED>
+        <!ENTITY s "plain"><!ENTITY n "[&s;&amp;&s;]"><!ENTITY ws " &#9; "><!ENTITY ref "&#38;#9;">
+        <!ENTITY m "<item/>"><!ENTITY close ">"><!ENTITY r1 "&r2;"><!ENTITY r2 "&r1;">
+    ]>)";
+    test_document(expanded_entities + R"(<root a="&n;&ws;&ref;" b=" &s;&ws;&s; ">&n;&ws;&ref;&lt;
+        <list>&ws;<item/>&ws;</list><list>&m;</list>&close;</root>)", [](const Document& document) {
+        const GeneralEntities& entities = document.doctype_declaration.general_entities;
+        assert((entities.at("n").expansion.in_content && entities.at("n").expansion.in_attribute_value));
+        assert((entities.at("n").expansion.text == String("[plain&plain]")));
+        assert((entities.at("n").expansion.character_references_end == 7));
+        assert((entities.at("ws").expansion.attribute_text == String("   ")));
+        assert((entities.at("ws").expansion.whitespace_only));
+        assert((!entities.at("ref").expansion.whitespace_only));
+        assert((!entities.at("m").expansion.in_content && !entities.at("m").expansion.in_attribute_value));
+        assert((!entities.at("close").expansion.in_content && entities.at("close").expansion.in_attribute_value));
+        assert((!entities.at("r1").expansion.in_content));
+        assert((entities.at("lt").expansion.text == String("<")));
+        assert((document.root.tag.attributes.at("a") == String("[plain&plain]   \t")));
+        assert((document.root.tag.attributes.at("b") == String("plain plain")));
+        assert((document.root.text == String("[plain&plain] \t \t<\n        >")));
+        assert((document.root.children.at(1).children.size() == 1));
+    });
+    for (const char* invalid : {"<root>]]&close;</root>", "<root>&r1;</root>", "<root><list>&ref;</list></root>"}) {
+        try {
+            Parser(expanded_entities + invalid).parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Entities are only expanded once referenced, and never beyond a fixed size, so declaring
+    // exponentially expanding entities costs nothing (in time or memory) unless they are used.
+    std::string unreferenced = "<!DOCTYPE r [<!ELEMENT r ANY><!ATTLIST r a CDATA #IMPLIED><!ENTITY l0 'lol'>";
+    for (int i = 1; i <= 30; ++i) {
+        unreferenced += "<!ENTITY l" + std::to_string(i) + " '";
+        for (int j = 0; j < 10; ++j) {
+            unreferenced += "&l" + std::to_string(i - 1) + ";";
+        }
+        unreferenced += "'>";
+    }
+    unreferenced += "]>";
+    for (unsigned threads : {1, 4}) {
+        ParseOptions unreferenced_options;
+        unreferenced_options.threads = threads;
+        unreferenced_options.parallel_chunk_size = 1;
+        Document laughs_document = Parser(unreferenced + "<r>&l2;</r>").parse_document(unreferenced_options);
+        const GeneralEntities* entities = &laughs_document.doctype_declaration.general_entities;
+        assert((laughs_document.root.text.size() == 300 && entities->at("l2").expansion.in_content));
+        assert((threads > 1 || !entities->at("l30").expansion.expanded));
+        // Too large to expand in advance - read as referenced instead, with the same result.
+        laughs_document = Parser(unreferenced + "<r a='&l4;'>&l4;</r>").parse_document(unreferenced_options);
+        assert((laughs_document.root.text.size() == 30000));
+        assert((laughs_document.root.tag.attributes.at("a").size() == 30000));
+        entities = &laughs_document.doctype_declaration.general_entities;
+        assert((!entities->at("l4").expansion.in_content && !entities->at("l4").expansion.in_attribute_value));
+        assert((entities->at("l3").expansion.text.size() <= MAX_GENERAL_ENTITY_EXPANSION));
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Parallel parsing - chunks of children joined in order, errors exactly as serial parsing.
+    ParseOptions parallel;
+    parallel.threads = 3;
+    parallel.parallel_chunk_size = 16;
+    std::string records;
+    for (int i = 0; i < 1000; ++i) {
+        records += "<record id='r" + std::to_string(i) + "' note='/> \"'>" + std::to_string(i) + "</record>\n";
+    }
+    std::vector<const char*> children;
+    std::string scanned = records + "</root>";
+    assert((scan_child_elements(scanned.data(), scanned.data() + scanned.size(), children)
+        == scanned.data() + records.size()));
+    assert((children.size() == 1000 && children.at(1) == scanned.data() + records.find("<record id='r1'")));
+    Document parallel_document = Parser("<root>start" + records + "<?pi?>end</root>").parse_document(parallel);
+    assert((parallel_document.root.children.size() == 1000));
+    assert((parallel_document.root.children.at(999).text == String("999")));
+    assert((parallel_document.root.text.size() == 1008));
+    assert((parallel_document.root.processing_instructions.size() == 1));
+    for (const std::string& invalid : {
+        "<root>" + records + "<record>\x01</record></root>", "<root>" + records + "</record></root>",
+        "<root>" + records + "<!-- </root>", "<root>" + records + "</root><root/>"
+    }) {
+        std::string serial_error, parallel_error;
+        try {
+            Parser(invalid).parse_document();
+        } catch (const XmlError& e) {
+            serial_error = e.what();
+        }
+        try {
+            Parser(invalid).parse_document(parallel);
+        } catch (const XmlError& e) {
+            parallel_error = e.what();
+        }
+        assert((!serial_error.empty() && serial_error == parallel_error));
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Parallel validation of subtrees - errors exactly as serial validation.
+    auto groups = [](const std::map<int, std::string>& replacements) {
+        std::string groups = R"(<!DOCTYPE root [
+            <!ELEMENT root (group*)><!ELEMENT group (item+)><!ELEMENT item (#PCDATA)>
+            <!ATTLIST item id ID #IMPLIED ref IDREF #IMPLIED>
+        ]><root>)";
+        for (int i = 0; i < 100; ++i) {
+            auto replacement = replacements.find(i);
+            groups += replacement != replacements.end() ? replacement->second : "<group><item id='i"
+                + std::to_string(i) + "' ref='i0'>" + std::to_string(i) + "</item><item/></group>";
+        }
+        return groups + "</root>";
+    };
+    for (const std::string& string : {
+        groups({}), groups({{40, "<group><item id='b'/><item id='a'/></group>"},
+            {5, "<group><item id='b'/></group>"}, {3, "<group><item id='a'/></group>"}}),
+        groups({{90, "<group/>"}, {10, "<group><item id='i11'/></group>"}}),
+        groups({{70, "<group><item ref='missing'/></group>"}, {69, "<group><item other=''/></group>"}}),
+        groups({{60, "<item/>"}, {61, "<group><item><group/></item></group>"}})
+    }) {
+        Document unvalidated = Parser(string).parse_document(false, false);
+        for (auto [validate_elements, validate_attributes] : {
+            std::pair(true, true), std::pair(true, false), std::pair(false, true)
+        }) {
+            std::string serial_error, parallel_error;
+            try {
+                validate_document(unvalidated, validate_elements, validate_attributes);
+            } catch (const XmlError& e) {
+                serial_error = e.what();
+            }
+            for (unsigned threads : {2, 3, 8}) {
+                try {
+                    validate_document(unvalidated, validate_elements, validate_attributes, threads);
+                    parallel_error.clear();
+                } catch (const XmlError& e) {
+                    parallel_error = e.what();
+                }
+                assert((serial_error == parallel_error));
+            }
+        }
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Declarations indexed by interned name - including content models not yet compiled.
+    DoctypeDeclaration built;
+    ElementContentModel item_model;
+    item_model.is_name = true;
+    item_model.name = "item";
+    item_model.count = ElementContentCount::one_or_more;
+    ElementDeclaration list_declaration;
+    list_declaration.type = ElementType::children;
+    list_declaration.name = "list";
+    list_declaration.element_content = item_model;
+    built.element_declarations.emplace("list", list_declaration);
+    ElementDeclaration item_declaration;
+    item_declaration.type = ElementType::any;
+    item_declaration.name = "item";
+    built.element_declarations.emplace("item", item_declaration);
+    AttributeDeclaration key_declaration;
+    key_declaration.name = "key";
+    key_declaration.type = AttributeType::id;
+    key_declaration.presence = AttributePresence::implied;
+    built.attribute_list_declarations["item"].emplace("key", key_declaration);
+    DtdIndex index(built);
+    NameId list_id = index.find("list"), item_id = index.find("item");
+    assert((list_id != NO_NAME && item_id != NO_NAME && index.find("other") == NO_NAME));
+    assert((index.get_element_declaration(list_id)->type == ElementType::children));
+    assert((index.get_attribute_list_declaration(list_id) == nullptr));
+    assert((*index.get_id_attribute(item_id) == String("key")));
+    int state = index.next_state(list_id, 0, item_id);
+    assert((state != -1 && index.accepting(list_id, state) && !index.accepting(list_id, 0)));
+    assert((index.next_state(list_id, state, index.find("other")) == -1));
+    Document built_document;
+    built.root_name = "list";
+    built_document.doctype_declaration = built;
+    built_document.root.tag.name = "list";
+    built_document.root.children_only = true;
+    try {
+        validate_document(built_document, true, true);
+        assert((false));
+    } catch (const XmlError& e) {
+        assert((std::string(e.what()) == "Element did not match element content model: list"));
+    }
+    built_document.root.children.emplace_back().tag.name = "item";
+    built_document.root.children.back().tag.attributes["key"] = "k";
+    validate_document(built_document, true, true);
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Streaming validation fails at the first invalid element, reporting its position.
+    ParseOptions streaming;
+    streaming.streaming_validation = true;
+    std::string invalid_ids = R"(<!DOCTYPE root [
+        <!ELEMENT root (a*)><!ELEMENT a EMPTY><!ATTLIST a id ID #IMPLIED ref IDREF #IMPLIED>
+    ]><root><a ref="later"/><a id="later"/>
+    <a id="later"/></root>)";
+    try {
+        Parser(invalid_ids).parse_document(streaming);
+        assert((false));
+    } catch (const XmlError& e) {
+        assert((std::string(e.what()).find("line 4") != std::string::npos));
+        assert((std::string(e.what()).find("Repeated ID value") != std::string::npos));
+    }
+    // IDREF values may refer to later IDs, so are only resolved at the end.
+    document = Parser(R"(<!DOCTYPE root [
+        <!ELEMENT root (a*)><!ELEMENT a EMPTY><!ATTLIST a id ID #IMPLIED ref IDREFS #IMPLIED>
+    ]><root><a ref="x y"/><a id="x"/><a id="y"/></root>)").parse_document(streaming);
+    assert((document.root.children.size() == 3));
+    try {
+        Parser(R"(<!DOCTYPE root [
+            <!ELEMENT root (a*)><!ELEMENT a EMPTY><!ATTLIST a id ID #IMPLIED ref IDREFS #IMPLIED>
+        ]><root><a ref="x z"/><a id="x"/></root>)").parse_document(streaming);
+        assert((false));
+    } catch (const XmlError&) {}
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Delimiters must be found wherever they fall within a scanned block.
+    for (std::size_t offset = 0; offset < 70; ++offset) {
+        std::string run(offset, 'x');
+        Document scanned = Parser(
+            "<a b='" + run + "&quot;'>" + run + "&amp;<!--" + run + "-y" + run + "--><![CDATA["
+            + run + "]]]]><?pi " + run + "?" + run + "?>" + run + "\u00E9</a>").parse_document();
+        assert((scanned.root.tag.attributes.at("b") == String(run + "\"")));
+        assert((scanned.root.text == String(run + "&" + run + "]]" + run + "\u00E9")));
+        assert((scanned.root.processing_instructions.at(0).instruction == String(run + "?" + run)));
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Characters straddling the boundary of a validated chunk are decoded as normal.
+    for (std::size_t offset = 0; offset < 4; ++offset) {
+        std::string run("<a>" + std::string(UTF8_VALIDATION_CHUNK_SIZE - offset - 3, 'x'));
+        Document straddling = Parser(run + "\U0001F600\u00E9</a>").parse_document();
+        assert((straddling.root.text.size() == UTF8_VALIDATION_CHUNK_SIZE - offset - 3 + 6));
+        assert((straddling.root.text.substr(straddling.root.text.size() - 6) == String{0x1F600, 0xE9}));
+    }
+    // Continuation bytes must be of the form 10xxxxxx, and overlong encodings, surrogates and
+    // values beyond U+10FFFF are rejected - strictly alike for buffers and streams.
+    for (const char* invalid_utf8 : {
+        "<a>\xC3\xC3</a>", "<a>\xE6\x96\xC7</a>",
+        "<a>\xC0\xAF</a>", "<a>\xC1\xBF</a>", "<a>\xE0\x80\xAF</a>", "<a>\xE0\x9F\xBF</a>",
+        "<a>\xF0\x80\x80\xAF</a>", "<a>\xF0\x8F\xBF\xBF</a>", "<a x='\xC0\xAF'/>",
+        "<a>\xED\xA0\x80</a>", "<a>\xED\xBF\xBF</a>",
+        "<a>\xF4\x90\x80\x80</a>", "<a>\xF5\x80\x80\x80</a>", "<a>\xF8\x88\x80\x80\x80</a>"
+    }) {
+        try {
+            Parser(invalid_utf8).parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+        try {
+            std::istringstream stream(invalid_utf8);
+            Parser(stream).parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    // Characters just inside each of those limits are still accepted.
+    for (const auto& [valid_utf8, c] : std::vector<std::pair<std::string, Char>> {
+        {"\xC2\x80", 0x80}, {"\xE0\xA0\x80", 0x800}, {"\xED\x9F\xBF", 0xD7FF},
+        {"\xEE\x80\x80", 0xE000}, {"\xF0\x90\x80\x80", 0x10000}, {"\xF4\x8F\xBF\xBD", 0x10FFFD}
+    }) {
+        std::istringstream stream("<a>" + valid_utf8 + "</a>");
+        assert((Parser("<a>" + valid_utf8 + "</a>").parse_document().root.text == String{c}));
+        assert((Parser(stream).parse_document().root.text == String{c}));
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Lookup tables must agree with the character ranges for every possible character.
+    for (Char c = -1; c <= 0x110000; ++c) {
+        bool name_start = character_classes::in_ranges(c, NAME_START_CHARACTER_RANGES);
+        assert((valid_character(c) == character_classes::in_ranges(c, CHARACTER_RANGES)));
+        assert((valid_name_start_character(c) == name_start));
+        assert((valid_name_character(c)
+            == (name_start || character_classes::in_ranges(c, ADDITIONAL_NAME_CHARACTER_RANGES))));
+        assert((is_whitespace(c) == (c == ' ' || c == '\t' || c == '\r' || c == '\n')));
+    }
+    test_document("<a\u037F\u0300/>", [](const Document& document) {
+        assert((document.root.tag.name == String{'a', 0x37F, 0x300}));
+    });
+    for (const char* invalid_name : {"<\u0300/>", "<a\u037E/>"}) {
+        try {
+            Parser(invalid_name).parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Path filtering keeps only matching subtrees, along with the tags of their ancestors.
+    ParseOptions filtered;
+    filtered.paths = {"/feed/entry/id", "/feed/*/link", "/feed/title"};
+    std::string feed = R"(<feed lang="en">text<?pi?><title>T<b/></title>
+        <entry n="1"><id>1</id><summary>s<link/></summary><link href="a"/></entry>
+        <meta><link href="b"/><x><link/></x></meta><other><id>2</id></other><entry/>
+        <entry><id><![CDATA[3]]><deep>d</deep></id></entry></feed>)";
+    document = Parser(feed).parse_document(filtered);
+    const Element& root = document.root;
+    assert((root.tag.attributes.at("lang") == "en" && root.text.empty()));
+    assert((root.processing_instructions.empty() && root.children.size() == 4));
+    assert((root.children[0].tag.name == "title" && root.children[0].text == "T"));
+    assert((root.children[0].children.size() == 1));
+    assert((root.children[1].tag.attributes.at("n") == "1" && root.children[1].children.size() == 2));
+    assert((root.children[1].children[0].text == "1"));
+    assert((root.children[1].children[1].tag.attributes.at("href") == "a"));
+    assert((root.children[2].tag.name == "meta" && root.children[2].children.size() == 1));
+    assert((root.children[3].children[0].text == "3"));
+    assert((root.children[3].children[0].children.at(0).text == "d"));
+    // An unmatched root element is still kept (tag only).
+    filtered.paths = {"/other/id"};
+    document = Parser(feed).parse_document(filtered);
+    assert((document.root.tag.name == "feed" && document.root.children.empty()));
+    // Discarded elements are still checked for well-formedness.
+    try {
+        Parser("<feed><other><a></b></other></feed>").parse_document(filtered);
+        assert((false));
+    } catch (const XmlError&) {}
+    for (const char* invalid_path : {"", "/", "feed/id", "/feed//id", "/feed/"}) {
+        filtered.paths = {invalid_path};
+        try {
+            Parser(feed).parse_document(filtered);
+            assert((false));
+        } catch (const std::invalid_argument&) {}
+    }
+    // With a DTD, the whole document is still validated (even the discarded elements).
+    filtered.paths = {"/root/a"};
+    std::string filtered_dtd = R"(<!DOCTYPE root [
+        <!ELEMENT root (a|b)*><!ELEMENT a (#PCDATA)><!ELEMENT b EMPTY>
+        <!ATTLIST b ref IDREF #IMPLIED><!ATTLIST a id ID #IMPLIED>
+    ]><root><b ref="x"/><a id="x">a</a>)";
+    document = Parser(filtered_dtd + "</root>").parse_document(filtered);
+    assert((document.root.children.size() == 1 && document.root.children[0].text == "a"));
+    for (const char* invalid_content : {"<b>b</b></root>", "<b ref='y'/></root>"}) {
+        try {
+            Parser(filtered_dtd + invalid_content).parse_document(filtered);
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Well-formedness only - nothing in the DTD or document is validated, but entities,
+    // attribute defaults and normalisation still apply.
+    ParseOptions well_formed;
+    well_formed.well_formed_only = true;
+    std::string unchecked = R"(<!DOCTYPE other [
+        <!ELEMENT root EMPTY><!ENTITY e "entity">
+        <!ATTLIST root a ID #FIXED "x" b ID #IMPLIED t NMTOKENS "  p  q  " n NOTATION (missing) #IMPLIED>
+    ]><root b="  y  z  " c="  w  ">&e;<undeclared/></root>)";
+    for (unsigned threads : {1, 2}) {
+        well_formed.threads = threads;
+        well_formed.parallel_chunk_size = 1;
+        document = Parser(unchecked).parse_document(well_formed);
+        assert((document.root.text == "entity" && document.root.children.size() == 1));
+        assert((document.root.tag.attributes.at("a") == "x" && document.root.tag.attributes.at("b") == "y z"));
+        assert((document.root.tag.attributes.at("c") == "  w  " && document.root.tag.attributes.at("t") == "p q"));
+    }
+    try {
+        Parser(unchecked).parse_document();
+        assert((false));
+    } catch (const XmlError&) {}
+    for (const char* malformed : {"<root>&undeclared;</root>", "<root><a></root>", "<root a='1' a='2'/>"}) {
+        try {
+            Parser(malformed).parse_document(well_formed);
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Line breaks are normalised wherever they fall (CR LF, lone CR), keeping the character after.
+    std::string line_breaks = "<a b='1\r\n2\r3'>\r\n\r\rx\r<![CDATA[\r\n]]>y\r\nz<b>\rc</b></a>\r\n";
+    std::istringstream line_breaks_stream(line_breaks);
+    ParseOptions line_breaks_threads;
+    line_breaks_threads.threads = 2;
+    line_breaks_threads.parallel_chunk_size = 1;
+    for (Document line_breaks_document : {
+        Parser(line_breaks).parse_document(), Parser(line_breaks_stream).parse_document(),
+        Parser(line_breaks).parse_document(line_breaks_threads)
+    }) {
+        assert((line_breaks_document.root.tag.attributes.at("b") == "1 2 3"));
+        assert((line_breaks_document.root.text == "\n\n\nx\n\ny\nz"));
+        assert((line_breaks_document.root.children.at(0).text == "\nc"));
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Attributes not in the attribute list of their element are CDATA (not normalised further).
+    std::string undeclared = R"(<!DOCTYPE r [<!ATTLIST r t NMTOKENS #IMPLIED>]><r t="  p  q  " u="  v  w  "/>)";
+    std::istringstream undeclared_stream(undeclared);
+    ParseOptions unvalidated;
+    unvalidated.validate_elements = false;
+    unvalidated.validate_attributes = false;
+    for (Document undeclared_document : {
+        Parser(undeclared).parse_document(unvalidated), Parser(undeclared_stream).parse_document(unvalidated)
+    }) {
+        assert((undeclared_document.root.tag.attributes.at("t") == "p q"));
+        assert((undeclared_document.root.tag.attributes.at("u") == "  v  w  "));
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Documents without a DTD parse the same way from a buffer and a stream.
+    std::string plain = "<r a='&lt;1&#x41;'>téxt<b/><?p i?><!--c--><![CDATA[<&>]]>&amp;</r>";
+    std::istringstream plain_stream(plain);
+    for (Document plain_document : {Parser(plain).parse_document(), Parser(plain_stream).parse_document()}) {
+        assert((plain_document.root.tag.attributes.at("a") == "<1A"));
+        assert((plain_document.root.text == String{'t', 0xE9, 'x', 't', '<', '&', '>', '&'}));
+        assert((plain_document.root.children.size() == 1 && plain_document.root.children[0].tag.name == "b"));
+        assert((plain_document.root.processing_instructions.size() == 1));
+    }
+    for (const char* malformed : {"<r>&lt</r>", "<r>a</s>", "<r a='<'/>"}) {
+        std::istringstream malformed_stream(malformed);
+        try {
+            Parser(malformed).parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+        try {
+            Parser(malformed_stream).parse_document();
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Resource limits - anything within them parses as usual, serially or in parallel.
+    auto exceeds_limit = [](const std::string& string, const ParseOptions& options) {
+        std::istringstream stream(string);
+        try {
+            Parser(string).parse_document(options);
+            assert((false));
+        } catch (const XmlError&) {}
+        try {
+            Parser(stream).parse_document(options);
+            assert((false));
+        } catch (const XmlError&) {}
+    };
+    std::string laughs = R"(<!DOCTYPE r [
+        <!ENTITY a "hahahaha"><!ENTITY b "&a;&a;&a;&a;&a;&a;&a;&a;"><!ENTITY c "&b;&b;&b;&b;&b;&b;&b;&b;">
+    ]><r x="&c;"><s>&c;</s><s>&c;&c;</s></r>)";
+    std::string nested = "<r a='1' b='2'><s><t/></s><s c='3'/></r>";
+    for (unsigned threads : {1, 2}) {
+        ParseOptions limited;
+        limited.threads = threads;
+        limited.parallel_chunk_size = 1;
+        limited.well_formed_only = true;
+        limited.limits.max_entity_expansion = 2048;
+        assert((Parser(laughs).parse_document(limited).root.children[1].text.size() == 1024));
+        limited.limits.max_entity_expansion = 2047;
+        exceeds_limit(laughs, limited);
+        limited.limits = {};
+        limited.limits.max_depth = 3;
+        limited.limits.max_attributes = 2;
+        limited.limits.max_document_size = nested.size();
+        std::istringstream nested_stream(nested);
+        assert((Parser(nested).parse_document(limited).root.children.size() == 2));
+        assert((Parser(nested_stream).parse_document(limited).root.children.size() == 2));
+        for (std::size_t ParseLimits::*limit : {
+            &ParseLimits::max_depth, &ParseLimits::max_attributes, &ParseLimits::max_document_size
+        }) {
+            ParseOptions exceeded = limited;
+            exceeded.limits.*limit -= 1;
+            exceeds_limit(nested, exceeded);
+        }
+    }
+    // Entity expansion is limited by default - a billion laughs fails without any options.
+    std::string billion_laughs = "<!DOCTYPE r [<!ELEMENT r ANY><!ENTITY l0 'lol'>";
+    for (int level = 1; level <= 9; ++level) {
+        billion_laughs += "<!ENTITY l" + std::to_string(level) + " '";
+        for (int i = 0; i < 10; ++i) {
+            billion_laughs += "&l" + std::to_string(level - 1) + ";";
+        }
+        billion_laughs += "'>";
+    }
+    billion_laughs += "]><r>&l9;</r>";
+    exceeds_limit(billion_laughs, ParseOptions());
+    // As is nesting depth - deep enough to overflow the stack fails without any options
+    // (4096 levels by default, which fits the stack even without optimisations).
+    auto nest = [](std::size_t depth) {
+        std::string nest;
+        for (std::size_t i = 0; i < depth; ++i) {
+            nest += "<a>";
+        }
+        for (std::size_t i = 0; i < depth; ++i) {
+            nest += "</a>";
+        }
+        return nest;
+    };
+    assert((Parser(nest(4096)).parse_document().root.children.size() == 1));
+    exceeds_limit(nest(4097), ParseOptions());
+    exceeds_limit(nest(100000), ParseOptions());
+    // And the size of each content model compiled (even if never validated against).
+    std::string large_model = "<!DOCTYPE r [<!ELEMENT r (a0";
+    for (int i = 1; i < 1025; ++i) {
+        large_model += "|a" + std::to_string(i);
+    }
+    large_model += ")*>]><r/>";
+    ParseOptions unlimited_model;
+    unlimited_model.validate_elements = false;
+    exceeds_limit(large_model, unlimited_model);
+    unlimited_model.limits.max_content_model_size = 1025;
+    assert((Parser(large_model).parse_document(unlimited_model).doctype_declaration
+        .element_declarations.at("r").element_content_automaton.accepting.size() == 1026));
+    std::cout << "Document Test " << test_number++ << " passed.\n";
+    // Statistics are the same however the document is parsed.
+    std::string counted = R"(<!DOCTYPE r [
+        <!ELEMENT r (s*)><!ELEMENT s (#PCDATA|t)*><!ELEMENT t EMPTY>
+        <!ATTLIST s a CDATA 'x'><!ENTITY e "text">
+    ]><r><s>&e;</s><s a='y'>&e;<t/>&e;</s></r>)";
+    for (unsigned threads : {1, 2}) {
+        for (bool stream : {false, true}) {
+            ParseStats stats;
+            ParseOptions with_stats;
+            with_stats.threads = threads;
+            with_stats.parallel_chunk_size = 1;
+            with_stats.stats = &stats;
+            std::istringstream counted_stream(counted);
+            document = stream ? Parser(counted_stream).parse_document(with_stats)
+                : Parser(counted).parse_document(with_stats);
+            assert((document.root.children.size() == 2 && document.root.children[1].text == "texttext"));
+            assert((stats.bytes == counted.size() && stats.elements == 4 && stats.attributes == 2));
+            assert((stats.entity_references == 3 && stats.entity_expansion == 12));
+            assert((stats.external_resources == 0 && stats.max_depth == 3 && stats.allocations > 0));
+            assert((stats.dtd_seconds > 0 && stats.content_seconds > 0 && stats.validation_seconds > 0));
+        }
+    }
+    std::cout << "Document Test " << test_number++ << " passed.\n";
 }
\ No newline at end of file
@@ -8,9 +8,10 @@ RUN FROM THE ROOT OF THE PROJECT.
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
 #include <stdexcept>
-#include "../src/parser.h"
+#include "../src/xml.h"
 
 
 using namespace xml;
@@ -19,6 +20,11 @@ using namespace xml;
 const std::string FOLDER = "test/test_files";
 
 
+// Caches shared by all documents - one unbounded, one small enough to keep evicting.
+auto resource_cache = std::make_shared<ResourceCache>();
+auto small_resource_cache = std::make_shared<ResourceCache>(300);
+
+
 typedef std::function<void(const Document&)> TestDocument;
 unsigned test_number = 0;
 void test_document_file(
@@ -32,6 +38,21 @@ void test_document_file(
     }
     Document document = Parser(file).parse_document(validate_elements, validate_attributes);
     callback(document);
+    // Memory mapped parsing must give the same results as stream parsing.
+    callback(parse_file(file_path, validate_elements, validate_attributes));
+    // Streaming validation must accept exactly the same documents.
+    ParseOptions options;
+    options.validate_elements = validate_elements;
+    options.validate_attributes = validate_attributes;
+    options.streaming_validation = true;
+    callback(parse_file(file_path, options));
+    // External resources reused across documents must give the same results.
+    options.streaming_validation = false;
+    options.resource_cache = resource_cache;
+    callback(parse_file(file_path, options));
+    callback(parse_file(file_path, options));
+    options.resource_cache = small_resource_cache;
+    callback(parse_file(file_path, options));
     std::cout << "Document File Test " << test_number++ << " passed.\n";
 }
 
@@ -133,4 +154,55 @@ int main() {
         assert((root.tag.attributes.at("att2") == String("&2&")));
         assert((root.text == String("abcdef")));
     });
+    // Errors returned rather than thrown, with the same positions for streams and buffers.
+    ParseResult result = try_parse_file(FOLDER + "/standalone.xml");
+    assert((result.success && result.error.empty() && result.document.root.text == String("abcdef")));
+    assert((!try_parse_file(FOLDER + "/missing.xml").success));
+    for (const char* malformed : {
+        "<a>\r\n  <b x='1'\ty='é'>\r\r\n\xC3\xA9\x01</b></a>", "<a>\n<b>\n\n  \xE2\x82</b></a>", "<a>\r\n<b></a>"
+    }) {
+        std::istringstream stream(malformed);
+        ParseResult buffer_result = try_parse(malformed);
+        ParseResult stream_result = try_parse(stream);
+        assert((!buffer_result.success && !stream_result.success));
+        assert((buffer_result.error == stream_result.error));
+        assert((buffer_result.error.find("line 1,") == std::string::npos));
+    }
+    // Errors returned up the parser (not thrown) reported exactly as when thrown.
+    for (const char* rejected : {
+        "<a>\n<b>text", "<a>x\x01</a>", "<a><b></a>",
+        "<!DOCTYPE a [<!ELEMENT a ANY>]><a><a>&#65;</b></a>", "<a><b><c/></b>\x02</a>"
+    }) {
+        std::string error;
+        try {
+            parse(std::string_view(rejected));
+        } catch (const XmlError& e) {
+            error = e.what();
+        }
+        ParseResult rejected_result = try_parse(rejected);
+        assert((!rejected_result.success && !error.empty() && rejected_result.error == error));
+    }
+    assert((!try_parse("<!DOCTYPE a other [<!ELEMENT a ANY>]><a/>").success));
+    // Only parse errors are returned - anything else (e.g. malformed options) still propagates.
+    ParseOptions malformed_paths;
+    malformed_paths.paths = {"relative"};
+    try {
+        try_parse("<a/>", malformed_paths);
+        assert((false));
+    } catch (const std::invalid_argument&) {}
+    // Every reference to an external file counts towards the limit, loaded or not.
+    ParseOptions limited;
+    limited.validate_elements = false;
+    limited.limits.max_external_resources = 0;
+    assert((!try_parse_file(FOLDER + "/external.xml", limited).success));
+    assert((try_parse_file(FOLDER + "/sanity.xml", limited).success));
+    // Each external file loaded once, whichever document references it.
+    assert((resource_cache->size() == 10));
+    assert((small_resource_cache->get_bytes() <= 300));
+    std::size_t bytes = resource_cache->get_bytes();
+    resource_cache->get("test/test_files/../test_files/external/basic.xml");
+    assert((resource_cache->size() == 10 && resource_cache->get_bytes() == bytes));
+    resource_cache->clear();
+    assert((resource_cache->size() == 0 && resource_cache->get_bytes() == 0));
+    std::cout << "Document File Test " << test_number++ << " passed.\n";
 }
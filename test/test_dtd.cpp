@@ -0,0 +1,131 @@
+// Tests compiled external DTD subsets shared across documents.
+/*
+!!!MUST!!! BE
+RUN FROM THE ROOT OF THE PROJECT.
+*/
+#include <cassert>
+#include <functional>
+#include <string>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+const std::string FOLDER = "test/test_files";
+const std::string EXTERNAL_SUBSET = "test/test_files/external/ext_subset.xml";
+
+
+typedef std::function<void(const Document&)> TestDocument;
+unsigned test_number = 0;
+void test_dtd(const std::string& filename, const ParseOptions& options, TestDocument callback) {
+    Document document = parse_file(FOLDER + "/" + filename, options);
+    callback(document);
+    // Must be exactly as if the external subset was parsed.
+    ParseOptions parse_options = options;
+    parse_options.external_dtd = nullptr;
+    parse_options.dtd_cache = nullptr;
+    callback(parse_file(FOLDER + "/" + filename, parse_options));
+    std::cout << "DTD Test " << test_number++ << " passed.\n";
+}
+
+
+void test_ext_subset(const Document& document) {
+    auto dtd = document.doctype_declaration;
+    assert((dtd.root_name == String("products")));
+    assert((dtd.element_declarations.at("product").element_content.parts.size() == 3));
+    assert((dtd.attribute_list_declarations.at("product")
+        .at("desc").default_value == String("\"Product\"")));
+    assert((dtd.attribute_list_declarations.at("product").at("desc").from_external));
+    assert((dtd.processing_instructions.at(0).instruction == String("prod_proc.exe")));
+    assert((dtd.notation_declarations.count("Products")));
+    Element root = document.root;
+    assert((root.children.size() == 2));
+    assert((root.children.at(0).children.at(0).
+        tag.attributes.at("href") == String("xml-parser.png")));
+    assert((root.children.at(1).tag.attributes.at("id") == String("222")));
+}
+
+
+int main() {
+    auto compiled = std::make_shared<const CompiledDtd>(EXTERNAL_SUBSET);
+    assert((compiled->get_system_id() == std::filesystem::path(EXTERNAL_SUBSET)));
+    assert((compiled->get_declarations().root_name.empty()));
+    assert((compiled->get_declarations().element_declarations.size() == 2));
+    assert((!compiled->get_declarations()
+        .element_declarations.at("product").element_content_automaton.accepting.empty()));
+    ParseOptions options;
+    options.validate_elements = false;
+    options.external_dtd = compiled;
+    test_dtd("ext_subset.xml", options, test_ext_subset);
+    // Compiled DTD used whatever the system ID - the external subset is never read.
+    Document document = parse("<!DOCTYPE example SYSTEM 'missing.dtd'><example att='1'/>", options);
+    assert((document.doctype_declaration.element_declarations.count("product")));
+    // Elements validated against the compiled declarations.
+    options.validate_elements = true;
+    try {
+        parse("<!DOCTYPE product SYSTEM 'test/test_files/external/ext_subset.xml'>"
+            "<product name='x'><review/></product>", options);
+        assert((false));
+    } catch (const XmlError&) {}
+    parse("<!DOCTYPE example SYSTEM 'test/test_files/external/ext_subset.xml'>"
+        "<example att='1'>Any</example>", options);
+
+    auto cache = std::make_shared<DtdCache>();
+    options = ParseOptions();
+    options.validate_elements = false;
+    options.dtd_cache = cache;
+    test_dtd("ext_subset.xml", options, test_ext_subset);
+    assert((cache->size() == 1));
+    std::shared_ptr<const CompiledDtd> cached = cache->get("test/test_files/./external/ext_subset.xml");
+    assert((cache->size() == 1));
+    assert((cached == cache->get(EXTERNAL_SUBSET)));
+    // Internal subset overrides (but no parameter entities) - merged after the internal subset.
+    parse("<!DOCTYPE products SYSTEM 'test/test_files/external/ext_subset.xml' ["
+        "<!ATTLIST product desc CDATA 'N/A'><!ENTITY img-ext '.jpg'>]>"
+        "<products><product name='a' desc='b'><image href='c&img-ext;'/></product></products>",
+        options);
+    // Internal subset parameter entities may change the external subset - parsed instead.
+    test_dtd("int_and_ext_subset.xml", options, [](const Document& document) {
+        auto dtd = document.doctype_declaration;
+        assert((dtd.element_declarations.at("product")
+            .element_content.parts.at(1).name == String("video")));
+        assert((dtd.attribute_list_declarations.at("product")
+            .at("desc").default_value == String("N/A")));
+        Element product = document.root.children.at(0);
+        assert((product.children.at(0).tag.attributes.at("href") == String("gm64.jpg")));
+    });
+    assert((cache->size() == 1));
+    // Duplicate element declaration across the internal subset and compiled DTD.
+    try {
+        parse("<!DOCTYPE example SYSTEM 'test/test_files/external/ext_subset.xml' ["
+            "<!ELEMENT example EMPTY>]><example/>", options);
+        assert((false));
+    } catch (const XmlError&) {}
+    cache->clear();
+    assert((cache->size() == 0));
+
+    // A single cache shared by many threads at once.
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&options]() {
+            for (int j = 0; j < 10; ++j) {
+                test_ext_subset(parse_file(FOLDER + "/ext_subset.xml", options));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    assert((cache->size() == 1));
+    std::cout << "DTD Test " << test_number++ << " passed.\n";
+    try {
+        CompiledDtd("test/test_files/external/missing.xml");
+        assert((false));
+    } catch (const XmlError&) {}
+    std::cout << "DTD Test " << test_number++ << " passed.\n";
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Tests streaming (SAX-style) parsing with a handler.
+#include <cassert>
+#include <functional>
+#include <string>
+#include <iostream>
+#include <vector>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+// Records every event as a string for easy comparison.
+class RecordingHandler : public Handler {
+    public:
+        std::vector<std::string> events;
+        void xml_declaration(const String& version, const String& encoding, bool standalone) override {
+            events.push_back("xml " + std::string(version) + " " + std::string(encoding)
+                + (standalone ? " standalone" : ""));
+        }
+        void element_declaration(const ElementDeclaration& declaration) override {
+            events.push_back("!element " + std::string(declaration.name));
+        }
+        void attribute_declaration(const String& element, const AttributeDeclaration& declaration) override {
+            events.push_back("!attribute " + std::string(element) + " " + std::string(declaration.name));
+        }
+        void general_entity_declaration(const GeneralEntity& entity) override {
+            events.push_back("!entity " + std::string(entity.name));
+        }
+        void doctype_declaration(const DoctypeDeclaration& dtd) override {
+            events.push_back("!doctype " + std::string(dtd.root_name));
+        }
+        void start_element(const String& name, const Attributes& attributes) override {
+            std::string event = "<" + std::string(name);
+            for (const auto& [attribute_name, value] : attributes) {
+                event += " " + std::string(attribute_name) + "=" + std::string(value);
+            }
+            events.push_back(event);
+        }
+        void end_element(const String& name) override {
+            events.push_back("</" + std::string(name));
+        }
+        void characters(const String& text) override {
+            // Merge adjacent character data for predictable comparisons.
+            if (!events.empty() && events.back().front() == '#') {
+                events.back() += std::string(text);
+            } else {
+                events.push_back("#" + std::string(text));
+            }
+        }
+        void processing_instruction(const ProcessingInstruction& pi) override {
+            events.push_back("?" + std::string(pi.target) + " " + std::string(pi.instruction));
+        }
+        void end_document() override {
+            events.push_back("end");
+        }
+};
+
+
+typedef std::function<void(const std::vector<std::string>&)> TestHandler;
+unsigned test_number = 0;
+void test_handler(const std::string& string, TestHandler callback) {
+    RecordingHandler handler;
+    parse(string, handler);
+    callback(handler.events);
+    std::cout << "Handler Test " << test_number++ << " passed.\n";
+}
+
+
+int main() {
+    test_handler("<?xml version='1.0'?><a>Sanity Check</a>", [](const std::vector<std::string>& events) {
+        std::vector<std::string> expected {"xml 1.0 utf-8", "<a", "#Sanity Check", "</a", "end"};
+        assert((events == expected));
+    });
+    test_handler(R"(<?pi first?><root id="1">
+        <item name='x'/>text<![CDATA[<raw>]]><!-- ignored --><?pi second?>&amp;<b>bold</b>
+    </root><?pi last?>)", [](const std::vector<std::string>& events) {
+        std::vector<std::string> expected {
+            "?pi first", "<root id=1", "#\n        ", "<item name=x", "</item", "#text<raw>",
+            "?pi second", "#&", "<b", "#bold", "</b", "#\n    ", "</root", "?pi last", "end"
+        };
+        assert((events == expected));
+    });
+    test_handler(R"(<!DOCTYPE root [
+        <!ELEMENT root (#PCDATA|child)*>
+        <!ELEMENT child EMPTY>
+        <!ATTLIST child att CDATA "default">
+        <!ENTITY greeting "Hello, <child/>world">
+    ]><root>&greeting;!</root>)", [](const std::vector<std::string>& events) {
+        std::vector<std::string> expected {
+            "!element root", "!element child", "!attribute child att", "!entity greeting",
+            "!doctype root", "<root", "#Hello, ", "<child att=default", "</child", "#world!",
+            "</root", "end"
+        };
+        assert((events == expected));
+    });
+    // Well-formedness errors must still be detected when streaming.
+    RecordingHandler handler;
+    try {
+        parse("<a><b></a></b>", handler);
+        assert((false));
+    } catch (const XmlError&) {}
+    std::cout << "Handler Test " << test_number++ << " passed.\n";
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+// Tests push parsing of documents fed in chunks.
+/*
+!!!MUST!!! BE
+RUN FROM THE ROOT OF THE PROJECT.
+*/
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include <vector>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+// Records element events, to check events are passed on as soon as possible.
+class RecordingHandler : public Handler {
+    public:
+        std::vector<std::string> events;
+        void start_element(const String& name, const Attributes& attributes) override {
+            std::string event = "<" + std::string(name);
+            for (const auto& [attribute_name, value] : attributes) {
+                event += " " + std::string(attribute_name) + "=" + std::string(value);
+            }
+            events.push_back(event);
+        }
+        void end_element(const String& name) override {
+            events.push_back("</" + std::string(name));
+        }
+        void characters(const String& text) override {
+            if (!events.empty() && events.back().front() == '#') {
+                events.back() += std::string(text);
+            } else {
+                events.push_back("#" + std::string(text));
+            }
+        }
+        void end_document() override {
+            events.push_back("end");
+        }
+};
+
+
+const std::string DOCUMENT = R"(<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE menu [
+    <!ELEMENT menu (dish+)><!ELEMENT dish (#PCDATA)>
+    <!ATTLIST dish price CDATA #REQUIRED spicy (yes|no) 'no'>
+    <!ENTITY euro "&#8364;">
+]>
+<menu><dish price="&euro;4.50">Café crème 😀</dish><!-- comment -->
+<dish price='9' spicy='yes'><![CDATA[Chilli <hot>]]></dish></menu>
+)";
+
+
+unsigned test_number = 0;
+// Feeds the document in chunks of the given size, returning the document built.
+Document push(const std::string& string, std::size_t chunk_size) {
+    PushParser parser;
+    for (std::size_t i = 0; i < string.size(); i += chunk_size) {
+        parser.feed(string.data() + i, std::min(chunk_size, string.size() - i));
+    }
+    parser.finish();
+    return std::move(parser.get_document());
+}
+
+
+int main() {
+    // Chunks split anywhere - in tags, entity references and UTF-8 sequences.
+    Document expected = parse(DOCUMENT);
+    for (std::size_t chunk_size : {1, 2, 3, 7, 64, 100000}) {
+        Document document = push(DOCUMENT, chunk_size);
+        assert((document.encoding == String("utf-8")));
+        assert((document.root.children.size() == 2));
+        for (int i = 0; i < 2; ++i) {
+            assert((document.root.children.at(i).text == expected.root.children.at(i).text));
+            assert((document.root.children.at(i).tag.attributes == expected.root.children.at(i).tag.attributes));
+        }
+    }
+    std::cout << "Push Test " << test_number++ << " passed.\n";
+
+    // Events passed on as soon as the data is available.
+    RecordingHandler handler;
+    PushParser parser(handler);
+    parser.feed("<root><a x='1");
+    assert((handler.events == std::vector<std::string> {"<root"}));
+    parser.feed(std::string_view("'/>te"));
+    assert((handler.events.size() == 3 && handler.events.back() == "</a"));
+    parser.feed("xt\xC3");
+    parser.feed("\xA9</root>");
+    assert((handler.events.at(3) == "#texté" && handler.events.back() == "</root"));
+    parser.feed("<!-- trailing comment -->");
+    assert((handler.events.back() == "</root"));
+    parser.finish();
+    assert((handler.events.back() == "end"));
+    try {
+        parser.feed("more");
+        assert((false));
+    } catch (const std::logic_error&) {}
+    std::cout << "Push Test " << test_number++ << " passed.\n";
+
+    // Errors exactly as when parsing a stream - from feed once detected, otherwise finish.
+    for (const char* invalid : {
+        "<a><b></a>", "<a>\xC3\x28</a>", "<a>", "", "<!DOCTYPE a [<!ELEMENT a EMPTY>]><a>x</a>"
+    }) {
+        std::string error;
+        try {
+            std::istringstream stream(invalid);
+            Parser(stream).parse_document();
+        } catch (const XmlError& e) {
+            error = e.what();
+        }
+        assert((!error.empty()));
+        for (std::size_t chunk_size : {1, 5}) {
+            try {
+                push(invalid, chunk_size);
+                assert((false));
+            } catch (const XmlError& e) {
+                assert((e.what() == error));
+            }
+        }
+    }
+    {
+        // Error reported once detected - the rest of the input is not needed.
+        PushParser invalid;
+        try {
+            invalid.feed("<a></b>");
+            assert((false));
+        } catch (const XmlError&) {}
+        try {
+            invalid.finish();
+            assert((false));
+        } catch (const XmlError&) {}
+        // Abandoned part way through.
+        PushParser abandoned;
+        abandoned.feed("<a><b>");
+    }
+    std::cout << "Push Test " << test_number++ << " passed.\n";
+
+    // Suspended between chunks without holding anything else, so many can be in flight at once.
+    std::vector<PushParser> parsers(1000);
+    for (std::size_t i = 0; i < DOCUMENT.size(); ++i) {
+        for (PushParser& interleaved : parsers) {
+            interleaved.feed(DOCUMENT.data() + i, 1);
+        }
+    }
+    for (PushParser& interleaved : parsers) {
+        interleaved.finish();
+        assert((interleaved.get_document().root.children.at(1).text == expected.root.children.at(1).text));
+    }
+    std::cout << "Push Test " << test_number++ << " passed.\n";
+
+    // Data already parsed is discarded as it goes, with error positions unaffected.
+    std::string large = "<root>\n";
+    for (int i = 0; i < 20000; ++i) {
+        large += "<item n='" + std::to_string(i) + "'>caf\xC3\xA9</item>\n";
+    }
+    Document large_document = push(large + "</root>", 4096);
+    assert((large_document.root.children.size() == 20000));
+    assert((large_document.root.children.back().tag.attributes.at("n") == String("19999")));
+    large += "<item>x</root>";
+    std::string large_error;
+    try {
+        parse(large);
+    } catch (const XmlError& e) {
+        large_error = e.what();
+    }
+    try {
+        push(large, 4096);
+        assert((false));
+    } catch (const XmlError& e) {
+        assert((e.what() == large_error));
+    }
+    std::cout << "Push Test " << test_number++ << " passed.\n";
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+// Tests pull-based reading of documents node by node.
+#include <cassert>
+#include <functional>
+#include <string>
+#include <iostream>
+#include <vector>
+#include "../src/xml.h"
+
+
+using namespace xml;
+
+
+// Reads every node as a string for easy comparison.
+std::vector<std::string> read_all(Reader& reader) {
+    std::vector<std::string> nodes;
+    while (true) {
+        switch (reader.next()) {
+            case NodeType::start_element: {
+                std::string node = std::to_string(reader.get_depth()) + "<" + std::string(reader.get_name());
+                for (const auto& [name, value] : reader.get_attributes()) {
+                    node += " " + std::string(name) + "=" + std::string(value);
+                }
+                nodes.push_back(node);
+                break;
+            }
+            case NodeType::end_element:
+                nodes.push_back(std::to_string(reader.get_depth()) + "</" + std::string(reader.get_name()));
+                break;
+            case NodeType::text:
+                nodes.push_back("#" + std::string(reader.get_text()));
+                break;
+            case NodeType::processing_instruction:
+                nodes.push_back("?" + std::string(reader.get_processing_instruction().target));
+                break;
+            default:
+                nodes.push_back("end");
+                return nodes;
+        }
+    }
+}
+
+
+typedef std::function<void(Reader&)> TestReader;
+unsigned test_number = 0;
+void test_reader(const std::string& string, TestReader callback) {
+    Reader reader(string);
+    callback(reader);
+    std::cout << "Reader Test " << test_number++ << " passed.\n";
+}
+
+
+int main() {
+    test_reader("<a>Sanity Check</a>", [](Reader& reader) {
+        std::vector<std::string> expected {"0<a", "#Sanity Check", "0</a", "end"};
+        assert((read_all(reader) == expected));
+        assert((reader.next() == NodeType::end_document));
+    });
+    test_reader(R"(<?xml version="1.0"?><?pi first?><root id="1">
+        <item name='x'/>text<![CDATA[<raw>]]><!-- ignored -->&amp;<?pi second?><b>bold</b>
+    </root><?pi last?>)", [](Reader& reader) {
+        std::vector<std::string> expected {
+            "0<root id=1", "#\n        ", "1<item name=x", "1</item", "#text<raw>&",
+            "?pi", "1<b", "#bold", "1</b", "#\n    ", "0</root", "end"
+        };
+        assert((read_all(reader) == expected));
+        assert((reader.get_document().version == String("1.0")));
+        assert((reader.get_document().processing_instructions.size() == 2));
+    });
+    test_reader(R"(<!DOCTYPE root [
+        <!ATTLIST child att CDATA "default">
+        <!ENTITY greeting "Hello, <child/>world">
+    ]><root>&greeting;!</root>)", [](Reader& reader) {
+        std::vector<std::string> expected {
+            "0<root", "#Hello, ", "1<child att=default", "1</child", "#world!", "0</root", "end"
+        };
+        assert((read_all(reader) == expected));
+        assert((reader.get_document().doctype_declaration.root_name == String("root")));
+    });
+    test_reader("<root><header>H</header><body><x><y/></x>text</body><footer/></root>", [](Reader& reader) {
+        // Read the header, then skip over the body without reporting its contents.
+        assert((reader.next() == NodeType::start_element));
+        assert((reader.next() == NodeType::start_element && reader.get_name() == String("header")));
+        assert((reader.next() == NodeType::text && reader.get_text() == String("H")));
+        assert((reader.next() == NodeType::end_element));
+        assert((reader.next() == NodeType::start_element && reader.get_name() == String("body")));
+        reader.skip_subtree();
+        assert((reader.get_type() == NodeType::end_element && reader.get_name() == String("body")));
+        assert((reader.next() == NodeType::start_element && reader.get_name() == String("footer")));
+        reader.skip_subtree();
+        assert((reader.get_type() == NodeType::end_element && reader.get_name() == String("footer")));
+        assert((reader.next() == NodeType::end_element && reader.get_name() == String("root")));
+        assert((reader.next() == NodeType::end_document));
+    });
+    test_reader("<root><header/>Malformed <body></root>", [](Reader& reader) {
+        // Stopping early means errors later on in the document are never reached.
+        assert((reader.next() == NodeType::start_element));
+        assert((reader.next() == NodeType::start_element && reader.get_name() == String("header")));
+    });
+    // Well-formedness errors must still be detected when reading.
+    for (std::string string : {"<a><b></a></b>", "<a></a><b/>", "text", "<a>"}) {
+        Reader reader(string);
+        try {
+            while (reader.next() != NodeType::end_document);
+            assert((false));
+        } catch (const XmlError&) {}
+    }
+    std::cout << "Reader Test " << test_number++ << " passed.\n";
+}
\ No newline at end of file